@@ -6,6 +6,7 @@
 #include <math.h>
 #include <string.h>
 #include <CL/opencl.h>
+#include "cl_cache.h"
 
 #define USE_GPU				1
 #define DEBUG				0
@@ -137,11 +138,13 @@ int main(int argc, char** argv)
 		return EXIT_FAILURE;
 	}
 
-	// Create init & compute programs from source files
+	// Create and build init & compute programs, through the binary cache (cl_cache.h)
 	FILE *fp;
 	char *fileName[KCNT];
 	char *src_str;
 	size_t src_size;
+	int cache_hit, cache_hits = 0;
+	struct timespec build_start, build_end, build_spent;
 
 	for (i = 0; i < KCNT; i++) {
 		fileName[i] = (char*) malloc(100 * sizeof(char));
@@ -150,6 +153,7 @@ int main(int argc, char** argv)
 	strcpy(fileName[0], "./kernel0.cl");
 	strcpy(fileName[1], "./kernel1.cl");
 
+	clock_gettime(CLOCK_MONOTONIC, &build_start);
 	for (i = 0; i < KCNT; i++) {
 		fp = fopen(fileName[i], "r");
 		if (!fp) {
@@ -159,21 +163,7 @@ int main(int argc, char** argv)
 		src_str = (char*) malloc(MAX_SOURCE_SIZE);
 		src_size = fread(src_str, 1, MAX_SOURCE_SIZE, fp);
 
-		programs[i] = clCreateProgramWithSource(context, 1, (const char **)&src_str, (const size_t *)&src_size, &err);
-
-		if (!programs[i]) {
-			printf("Error: Failed to create program %d.\n", i);
-			return EXIT_FAILURE;
-		}
-
-		fclose(fp);
-		free(src_str);
-		free(fileName[i]);
-	}
-
-	// Build the program executables
-	for (i = 0; i < KCNT; i++) {
-		err = clBuildProgram(programs[i], 0, NULL, NULL, NULL, NULL);
+		err = clCacheBuildProgram(context, 1, &device_id, src_str, src_size, NULL, &programs[i], &cache_hit);
 
 		if (err != CL_SUCCESS) {
 			size_t len;
@@ -183,7 +173,16 @@ int main(int argc, char** argv)
 			printf("%s\n", buffer);
 			exit(1);
 		}
+		cache_hits += cache_hit;
+
+		fclose(fp);
+		free(src_str);
+		free(fileName[i]);
 	}
+	clock_gettime(CLOCK_MONOTONIC, &build_end);
+	timespec_subtract(&build_spent, &build_end, &build_start);
+	printf("Kernel build: %ld.%09ld s (%s start, %d of %d programs from cache)\n",
+			build_spent.tv_sec, build_spent.tv_nsec, cache_hits == KCNT ? "warm" : "cold", cache_hits, KCNT);
 
 	// Create init & compute kernels
 	char kernelName[100];
@@ -7,6 +7,7 @@
 #include <math.h>
 #include <string.h>
 #include "timers.h"
+#include "cl_cache.h"
 
 // Set if debug
 #define DEBUG				0
@@ -155,11 +156,12 @@ int main(int argc, char** argv)
 		return EXIT_FAILURE;
 	}
 
-	/* Create init & compute programs from source files */
+	/* Create and build init & compute programs, through the binary cache (cl_cache.h) */
 	FILE *fp;
 	char *fileName[KCNT];
 	char *src_str;
 	size_t src_size;
+	int cache_hit, cache_hits = 0;
 
 	for (i = 0; i < KCNT; i++) {
 		fileName[i] = (char*) malloc(100 * sizeof(char));
@@ -168,28 +170,6 @@ int main(int argc, char** argv)
 	strcpy(fileName[0], "./init.cl");
 	strcpy(fileName[1], "./compute.cl");
 
-	for (i = 0; i < KCNT; i++) {
-		fp = fopen(fileName[i], "r");
-		if (!fp) {
-			perror("File read failed");
-			return 1;
-		}
-		src_str = (char*) malloc(MAX_SOURCE_SIZE);
-		src_size = fread(src_str, 1, MAX_SOURCE_SIZE, fp);
-
-		programs[i] = clCreateProgramWithSource(context, 1, (const char **)&src_str, (const size_t *)&src_size, &err);
-
-		if (!programs[i]) {
-			printf("Error: Failed to create program %d.\n", i);
-			return EXIT_FAILURE;
-		}
-
-		fclose(fp);
-		free(src_str);
-		free(fileName[i]);
-	}
-
-	/* Build the program executables */
 	char define_str[10] = "-DTDIM=";
 	char tdim_str[10];
 	sprintf(tdim_str, "%d", TDIM);
@@ -200,13 +180,18 @@ int main(int argc, char** argv)
 		printf("%s\n", build_options);
 	}
 
+	timer_start(2);
 	for (i = 0; i < KCNT; i++) {
-		if (i == 0) {
-			err = clBuildProgram(programs[i], 0, NULL, NULL, NULL, NULL);
-		}
-		else {
-			err = clBuildProgram(programs[i], 0, NULL, build_options, NULL, NULL);
+		fp = fopen(fileName[i], "r");
+		if (!fp) {
+			perror("File read failed");
+			return 1;
 		}
+		src_str = (char*) malloc(MAX_SOURCE_SIZE);
+		src_size = fread(src_str, 1, MAX_SOURCE_SIZE, fp);
+
+		err = clCacheBuildProgram(context, 1, &device_id, src_str, src_size,
+				i == 0 ? NULL : build_options, &programs[i], &cache_hit);
 
 		if (err != CL_SUCCESS) {
 			size_t len;
@@ -216,7 +201,16 @@ int main(int argc, char** argv)
 			printf("%s\n", buffer);
 			exit(1);
 		}
+		cache_hits += cache_hit;
+
+		fclose(fp);
+		free(src_str);
+		free(fileName[i]);
 	}
+	timer_stop(2);
+
+	printf("Kernel build : %lf sec (%s start, %d of %d programs from cache)\n",
+			timer_read(2), cache_hits == KCNT ? "warm" : "cold", cache_hits, KCNT);
 
 	/* Create init & compute kernels */
 	char kernelName[100];
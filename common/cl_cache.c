@@ -0,0 +1,259 @@
+//cl_cache.c
+//On-disk OpenCL program binary cache (see cl_cache.h).
+//Cache file layout: "CLC1", the device count, then one (size, bytes) pair per
+//device in the order of the devices passed to clCacheBuildProgram().
+//Tuning files are one text line: "CLT1", the value count, the values.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "cl_cache.h"
+
+#define CL_CACHE_MAGIC "CLC1"
+#define CL_TUNE_MAGIC "CLT1"
+#define CL_CACHE_MAX_DEVICES 100
+
+static unsigned long long fnv1a(unsigned long long h, const void *data, size_t size)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static unsigned long long hash_device_info(unsigned long long h, cl_device_id device, cl_device_info param)
+{
+	char info[1024];
+	size_t size = 0;
+
+	if (clGetDeviceInfo(device, param, sizeof(info), info, &size) != CL_SUCCESS)
+		size = 0;
+	return fnv1a(h, info, size);
+}
+
+// returns 0 when caching is disabled
+static int cache_file(char *path, size_t path_size, unsigned long long h, const char *ext)
+{
+	const char *dir = getenv("CL_CACHE_DIR");
+
+	if (!dir)
+		dir = "./.clcache";
+	if (!*dir)
+		return 0;
+
+	mkdir(dir, 0755);
+	snprintf(path, path_size, "%s/%016llx.%s", dir, h, ext);
+	return 1;
+}
+
+static unsigned long long hash_devices(unsigned long long h, cl_uint num_devices, const cl_device_id *devices)
+{
+	cl_uint d;
+
+	for (d = 0; d < num_devices; d++) {
+		h = hash_device_info(h, devices[d], CL_DEVICE_NAME);
+		h = hash_device_info(h, devices[d], CL_DRIVER_VERSION);
+		h = hash_device_info(h, devices[d], CL_DEVICE_VERSION);
+	}
+	return h;
+}
+
+static int cache_path(char *path, size_t path_size, cl_uint num_devices, const cl_device_id *devices,
+		const char *src, size_t src_size, const char *options)
+{
+	unsigned long long h = hash_devices(0xcbf29ce484222325ULL, num_devices, devices);
+
+	if (options)
+		h = fnv1a(h, options, strlen(options) + 1);
+	h = fnv1a(h, src, src_size);
+	return cache_file(path, path_size, h, "bin");
+}
+
+static cl_program load_binary(const char *path, cl_context context, cl_uint num_devices,
+		const cl_device_id *devices)
+{
+	FILE *fp;
+	char magic[4];
+	cl_uint n, d;
+	size_t sizes[CL_CACHE_MAX_DEVICES];
+	unsigned char *bins[CL_CACHE_MAX_DEVICES];
+	cl_int status[CL_CACHE_MAX_DEVICES];
+	cl_program program = NULL;
+	cl_int err;
+	int ok = 1;
+
+	fp = fopen(path, "rb");
+	if (!fp)
+		return NULL;
+
+	if (fread(magic, 1, 4, fp) != 4 || memcmp(magic, CL_CACHE_MAGIC, 4) != 0 ||
+			fread(&n, sizeof(n), 1, fp) != 1 || n != num_devices) {
+		fclose(fp);
+		return NULL;
+	}
+	for (d = 0; d < n; d++) {
+		bins[d] = NULL;
+		if (!ok || fread(&sizes[d], sizeof(size_t), 1, fp) != 1) {
+			ok = 0;
+			continue;
+		}
+		bins[d] = (unsigned char *)malloc(sizes[d]);
+		if (fread(bins[d], 1, sizes[d], fp) != sizes[d])
+			ok = 0;
+	}
+	fclose(fp);
+
+	if (ok) {
+		program = clCreateProgramWithBinary(context, num_devices, devices, sizes,
+				(const unsigned char **)bins, status, &err);
+		if (err != CL_SUCCESS) {
+			if (program)
+				clReleaseProgram(program);
+			program = NULL;
+		}
+	}
+
+	for (d = 0; d < n; d++)
+		free(bins[d]);
+	return program;
+}
+
+static void save_binary(const char *path, cl_program program, cl_uint num_devices, const cl_device_id *devices)
+{
+	char tmp[4096 + 16];	// room for the .pid suffix
+	cl_device_id prog_devices[CL_CACHE_MAX_DEVICES];
+	size_t sizes[CL_CACHE_MAX_DEVICES];
+	unsigned char *bins[CL_CACHE_MAX_DEVICES];
+	cl_uint d, p;
+	FILE *fp;
+	int ok;
+
+	// binaries come back in the program's device order
+	if (clGetProgramInfo(program, CL_PROGRAM_DEVICES, sizeof(cl_device_id) * num_devices, prog_devices, NULL) != CL_SUCCESS ||
+			clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t) * num_devices, sizes, NULL) != CL_SUCCESS)
+		return;
+	for (p = 0; p < num_devices; p++)
+		bins[p] = (unsigned char *)malloc(sizes[p] ? sizes[p] : 1);
+	ok = clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char *) * num_devices, bins, NULL) == CL_SUCCESS;
+
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+	fp = ok ? fopen(tmp, "wb") : NULL;
+	if (fp) {
+		ok = fwrite(CL_CACHE_MAGIC, 1, 4, fp) == 4 && fwrite(&num_devices, sizeof(num_devices), 1, fp) == 1;
+		for (d = 0; d < num_devices && ok; d++) {
+			for (p = 0; p < num_devices && prog_devices[p] != devices[d]; p++)
+				;
+			ok = p < num_devices && sizes[p] > 0 &&
+				fwrite(&sizes[p], sizeof(size_t), 1, fp) == 1 &&
+				fwrite(bins[p], 1, sizes[p], fp) == sizes[p];
+		}
+		if (fclose(fp) != 0)
+			ok = 0;
+		if (!ok || rename(tmp, path) != 0)
+			unlink(tmp);
+	}
+
+	for (p = 0; p < num_devices; p++)
+		free(bins[p]);
+}
+
+cl_int clCacheBuildProgram(cl_context context, cl_uint num_devices, const cl_device_id *devices,
+		const char *src, size_t src_size, const char *options, cl_program *program, int *hit)
+{
+	char path[4096];
+	int cached;
+	cl_int err;
+
+	*hit = 0;
+	cached = num_devices <= CL_CACHE_MAX_DEVICES &&
+		cache_path(path, sizeof(path), num_devices, devices, src, src_size, options);
+
+	if (cached) {
+		*program = load_binary(path, context, num_devices, devices);
+		if (*program) {
+			// binaries still need a (cheap) build before kernels can be created
+			err = clBuildProgram(*program, num_devices, devices, options, NULL, NULL);
+			if (err == CL_SUCCESS) {
+				*hit = 1;
+				return CL_SUCCESS;
+			}
+			clReleaseProgram(*program);
+		}
+	}
+
+	*program = clCreateProgramWithSource(context, 1, &src, &src_size, &err);
+	if (err != CL_SUCCESS)
+		return err;
+	err = clBuildProgram(*program, num_devices, devices, options, NULL, NULL);
+	if (err == CL_SUCCESS && cached)
+		save_binary(path, *program, num_devices, devices);
+	return err;
+}
+
+int clCacheEnabled(void)
+{
+	const char *dir = getenv("CL_CACHE_DIR");
+
+	return !dir || *dir;
+}
+
+static int tune_path(char *path, size_t path_size, cl_device_id device, const char *key)
+{
+	unsigned long long h = hash_devices(0xcbf29ce484222325ULL, 1, &device);
+
+	h = fnv1a(h, key, strlen(key) + 1);
+	return cache_file(path, path_size, h, "tune");
+}
+
+int clCacheLoadTuning(cl_device_id device, const char *key, int *values, int n)
+{
+	char path[4096], magic[8];
+	FILE *fp;
+	int i, count, ok;
+
+	if (!tune_path(path, sizeof(path), device, key))
+		return 0;
+	fp = fopen(path, "r");
+	if (!fp)
+		return 0;
+
+	ok = fscanf(fp, "%7s %d", magic, &count) == 2 && strcmp(magic, CL_TUNE_MAGIC) == 0 && count == n;
+	for (i = 0; i < n && ok; i++)
+		ok = fscanf(fp, "%d", &values[i]) == 1;
+	fclose(fp);
+	return ok;
+}
+
+int clCacheSaveTuning(cl_device_id device, const char *key, const int *values, int n)
+{
+	char path[4096], tmp[4096 + 16];	// room for the .pid suffix
+	FILE *fp;
+	int i, ok;
+
+	if (!tune_path(path, sizeof(path), device, key))
+		return 0;
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+	fp = fopen(tmp, "w");
+	if (!fp)
+		return 0;
+
+	ok = fprintf(fp, "%s %d", CL_TUNE_MAGIC, n) > 0;
+	for (i = 0; i < n && ok; i++)
+		ok = fprintf(fp, " %d", values[i]) > 0;
+	ok = fprintf(fp, "\n") > 0 && ok;
+	if (fclose(fp) != 0)
+		ok = 0;
+	if (!ok || rename(tmp, path) != 0) {
+		unlink(tmp);
+		return 0;
+	}
+	return 1;
+}
@@ -0,0 +1,44 @@
+#ifndef __CL_CACHE__
+#define __CL_CACHE__
+
+// On-disk cache of OpenCL program binaries and tuned launch parameters.
+//
+// clCacheBuildProgram() replaces the usual clCreateProgramWithSource() +
+// clBuildProgram() pair. Binaries are keyed by a hash of the device names,
+// driver and device versions, build options and kernel source, and live in
+// $CL_CACHE_DIR (default ./.clcache). Setting CL_CACHE_DIR to an empty string
+// disables the cache.
+//
+// clCacheLoadTuning()/clCacheSaveTuning() keep a few integers per device
+// (e.g. work sizes found by a host's own calibration runs) in the same
+// directory, keyed by the device and a string naming what was tuned.
+
+#include <stddef.h>
+#include <CL/cl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Builds *program for the given devices, from a cached binary when one
+// matches (*hit = 1) and from src otherwise (*hit = 0, the binary is then
+// saved). Returns the clBuildProgram() status; on a build failure *program is
+// still valid so the caller can print the build log.
+cl_int clCacheBuildProgram(cl_context context, cl_uint num_devices, const cl_device_id *devices,
+		const char *src, size_t src_size, const char *options, cl_program *program, int *hit);
+
+// 0 if CL_CACHE_DIR disables the cache
+int clCacheEnabled(void);
+
+// Reads the n values saved for (device, key); returns 1 if they were found.
+int clCacheLoadTuning(cl_device_id device, const char *key, int *values, int n);
+
+// Saves n values for (device, key); returns 0 if the cache is disabled or
+// the file could not be written.
+int clCacheSaveTuning(cl_device_id device, const char *key, const int *values, int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__CL_CACHE__
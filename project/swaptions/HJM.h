@@ -17,11 +17,44 @@ int HJM_SimPath_Forward_Blocking_SSE(FTYPE **ppdHJMPath, int iN, int iFactors, F
 			    FTYPE **ppdFactors, long *lRndSeed, int BLOCKSIZE);
 int HJM_SimPath_Forward_Blocking(FTYPE **ppdHJMPath, int iN, int iFactors, FTYPE dYears, FTYPE *pdForward, FTYPE *pdTotalDrift,
 			    FTYPE **ppdFactors, long *lRndSeed, int BLOCKSIZE);
+int HJM_Z_Blocking(FTYPE **pdZ, FTYPE **randZ, int iN, int iFactors, long *lRndSeed, int BLOCKSIZE);
+int HJM_Z_Blocking_Rows(FTYPE **pdZ, FTYPE **randZ, int iN, int iFactors, int nRows, long *lRndSeed, int BLOCKSIZE);
+void serialB(FTYPE **pdZ, FTYPE **randZ, int BLOCKSIZE, int iN, int iFactors);
+int HJM_SimPath_Forward_Blocking_Z(FTYPE **ppdHJMPath, int iN, int iFactors, FTYPE dYears, FTYPE *pdForward, FTYPE *pdTotalDrift,
+			    FTYPE **ppdFactors, FTYPE **pdZ, int BLOCKSIZE);
+// One time step j of the path: pdRow[BLOCKSIZE*l + b], l = 0..iN-j-1, from row j-1
+void HJM_SimPath_Row(FTYPE *pdRow, const FTYPE *pdPrev, int j, int iN, int iFactors, FTYPE ddelt, FTYPE sqrt_ddelt,
+			    FTYPE *pdTotalDrift, FTYPE **ppdFactors, FTYPE **pdZ, int BLOCKSIZE);
+// Lane-parallel row evolution (HJM_SimPath_avx2.cpp, HJM_SimPath_avx512.cpp); return 0
+// when not built for the ISA, BLOCKSIZE is not a multiple of the width or there are too many factors
+int HJM_Row_Evolve_avx2(FTYPE *pdRow, const FTYPE *pdPrev, int j, int iN, int iFactors, FTYPE ddelt,
+			    FTYPE sqrt_ddelt, FTYPE *pdTotalDrift, FTYPE **ppdFactors, FTYPE **pdZ, int BLOCKSIZE);
+int HJM_Row_Evolve_avx512(FTYPE *pdRow, const FTYPE *pdPrev, int j, int iN, int iFactors, FTYPE ddelt,
+			    FTYPE sqrt_ddelt, FTYPE *pdTotalDrift, FTYPE **ppdFactors, FTYPE **pdZ, int BLOCKSIZE);
 
 
 int Discount_Factors_Blocking(FTYPE *pdDiscountFactors, int iN, FTYPE dYears, FTYPE *pdRatePath, int BLOCKSIZE);
 int Discount_Factors_Blocking_SSE(FTYPE *pdDiscountFactors, int iN, FTYPE dYears, FTYPE *pdRatePath, int BLOCKSIZE);
 
+int HJM_Swap_Payoffs(FTYPE *pdSwapPayoffs, int iSwapVectorLength, int iSwapTimePoints, int iFreqRatio,
+			    FTYPE dStrikeCont, FTYPE dPaymentInterval);
+int HJM_Swaption_Payoffs_Blocking(FTYPE *pdDiscPayoffs, FTYPE **ppdHJMPath,
+			    int iN, FTYPE dYears, FTYPE *pdSwapPayoffs, int iSwapVectorLength, int iSwapStartTimeIndex,
+			    FTYPE *pdDiscountingRatePath, FTYPE *pdPayoffDiscountFactors, FTYPE *pdSwapRatePath,
+			    FTYPE *pdSwapDiscountFactors, int BLOCKSIZE);
+// Path and payoff in one pass over a two-row window of the path, for the
+// O(iN) memory engine (HJM_Swaption_Blocking.cpp); pdRows holds 2*iN*BLOCKSIZE
+int HJM_Swaption_Payoffs_Rolling(FTYPE *pdDiscPayoffs, int iN, int iFactors, FTYPE dYears, FTYPE *pdForward,
+			    FTYPE *pdTotalDrift, FTYPE **ppdFactors, FTYPE **pdZ, FTYPE *pdSwapPayoffs, int iSwapVectorLength,
+			    int iSwapStartTimeIndex, FTYPE *pdRows, int BLOCKSIZE);
+void HJM_Swaption_Accumulate(ksum *pSumSimSwaptionPrice, ksum *pSumSquareSimSwaptionPrice,
+			    FTYPE *pdDiscPayoffs, int BLOCKSIZE);
+void HJM_Swaption_Result(FTYPE *pdSwaptionPrice, const ksum *pSum, const ksum *pSumSquare, long lTrials);
+int HJM_Swaption_Payoff_Blocking(ksum *pSumSimSwaptionPrice, ksum *pSumSquareSimSwaptionPrice, FTYPE **ppdHJMPath,
+			    int iN, FTYPE dYears, FTYPE *pdSwapPayoffs, int iSwapVectorLength, int iSwapStartTimeIndex,
+			    FTYPE *pdDiscountingRatePath, FTYPE *pdPayoffDiscountFactors, FTYPE *pdSwapRatePath,
+			    FTYPE *pdSwapDiscountFactors, int BLOCKSIZE);
+
 
 int HJM_Swaption_Blocking_SSE(FTYPE *pdSwaptionPrice, //Output vector that will store simulation results in the form:
 			                              //Swaption Price
@@ -64,9 +97,75 @@ int HJM_Swaption_Blocking(FTYPE *pdSwaptionPrice, //Output vector that will stor
 			      //Simulation Parameters
 			      long iRndSeed, 
 			      long lTrials, int blocksize, int tid);
+int HJM_Swaption_Simulate(FTYPE *pdSwaptionPrice, FTYPE dStrike, FTYPE dCompounding, FTYPE dMaturity,
+			      FTYPE dTenor, FTYPE dPaymentInterval, int iN, int iFactors, FTYPE dYears, FTYPE *pdYield,
+			      FTYPE **ppdFactors, long iRndSeed, long lTrials, int blocksize, swaption_state *pState,
+			      int bPipeline);
+int HJM_Swaption_Blocking_Resume(FTYPE *pdSwaptionPrice, FTYPE dStrike, FTYPE dCompounding, FTYPE dMaturity,
+			      FTYPE dTenor, FTYPE dPaymentInterval, int iN, int iFactors, FTYPE dYears, FTYPE *pdYield,
+			      FTYPE **ppdFactors, long iRndSeed, long lTrials, int blocksize, swaption_state *pState);
+void HJM_Publish_State(swaption_state *pState, int iDone, long lTrialsDone, long lRndSeed, const ksum *pSum,
+			    const ksum *pSumSquare);
 /*
 extern "C" FTYPE *dvector( long nl, long nh );
 extern "C" FTYPE **dmatrix( long nrl, long nrh, long ncl, long nch );
 extern "C" void free_dvector( FTYPE *v, long nl, long nh );
 extern "C" void free_dmatrix( FTYPE **m, long nrl, long nrh, long ncl, long nch );
 */
+
+// Pipelined simulation loop of HAVE_TBB builds (HJM_Swaption_Pipeline.cpp)
+int HJM_Swaption_Pipeline(ksum *pSum, ksum *pSumSquare, long *plRndSeed, long lFirstTrial, long lTrials,
+			    swaption_state *pState, int iN, int iFactors, FTYPE dYears, FTYPE *pdForward,
+			    FTYPE *pdTotalDrift, FTYPE **ppdFactors, FTYPE *pdSwapPayoffs, int iSwapVectorLength,
+			    int iSwapStartTimeIndex, int blocksize);
+
+// Scenario-batch mode (HJM_Swaption_Scenarios.cpp)
+int HJM_Read_Scenarios(const char *pszFile, scen **ppScen);
+int HJM_Ladder_Scenarios(int iN, FTYPE dShiftBp, scen **ppScen);
+int HJM_Swaption_Blocking_Scenarios(FTYPE *pdScenPrice, //Output vector of iScenarios price/stderr pairs
+			      FTYPE dStrike,
+			      FTYPE dCompounding,
+			      FTYPE dMaturity,
+			      FTYPE dTenor,
+			      FTYPE dPaymentInterval,
+			      int iN,
+			      int iFactors,
+			      FTYPE dYears,
+			      FTYPE *pdYield,
+			      FTYPE **ppdFactors,
+			      int iScenarios,
+			      scen *pScen,
+			      long iRndSeed,
+			      long lTrials, int blocksize);
+
+// Bermudan swaptions by Longstaff-Schwartz (HJM_Swaption_Bermudan.cpp), the
+// book's swaptions exercisable on every swap payment date from dMaturity on
+int HJM_Swaption_Bermudan(FTYPE *pdSwaptionPrice, FTYPE dStrike, FTYPE dCompounding, FTYPE dMaturity,
+			      FTYPE dTenor, FTYPE dPaymentInterval, int iN, int iFactors, FTYPE dYears, FTYPE *pdYield,
+			      FTYPE **ppdFactors, long iRndSeed, long lTrials, int blocksize, int nThreads);
+
+// Factor calibration to a curve history and the factor file (HJM_Calibrate.cpp)
+int HJM_Calibrate(const char *pszHistory, const char *pszFactors, int iN, FTYPE dYears, int iFactors, int nThreads);
+int HJM_Read_Factors(const char *pszFactors, int iN, FTYPE dYears, FTYPE ***pppdFactors);
+
+// Worker pinning (HJM_affinity.cpp)
+int HJM_Affinity_Init();
+int HJM_Affinity_Cpu(int tid, int iPolicy);
+int HJM_Affinity_Node(int iCpu);
+int HJM_Affinity_Parse(const char *szPolicy);
+
+// Checkpoint/restart (HJM_checkpoint.cpp)
+int HJM_Ckpt_Load(const char *pszFile, swaption_state *pStates, int nSwaptions, int iN, int iFactors,
+			      long lTrials, int blocksize);
+int HJM_Ckpt_Start(const char *pszFile, swaption_state *pStates, int nSwaptions, int iN, int iFactors,
+			      long lTrials, int blocksize, int iInterval);
+int HJM_Ckpt_Stop();
+
+// Deadline- and priority-aware pricing of a book (HJM_schedule.cpp)
+int HJM_Read_Jobs(const char *pszFile, int nSwaptions, swaption_job **ppJobs);
+int HJM_Schedule(parm *pSwaptions, int nSwaptions, const swaption_job *pJobs, swaption_state *pStates,
+			      void (*pfnInit)(int), int nThreads, long lTrials, long lSlice, long lSeed);
+
+// Pricing service mode (HJM_server.cpp)
+int HJM_Serve(const char *pszSocket, int nThreads, int iN, int iFactors, FTYPE dYears, FTYPE *pdYield,
+			      FTYPE **ppdFactors, long lTrials, int iWindowUs);
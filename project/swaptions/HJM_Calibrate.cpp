@@ -0,0 +1,390 @@
+//HJM_Calibrate.cpp
+//Calibration of the factor volatilities to a history of yield curves, and
+//the factor file that -factors prices with.
+//
+//Every curve is turned into forward rates (HJM_Yield_to_Forward) and the
+//day-to-day changes of the forwards of each time to maturity are the
+//observations. Their covariance, annualized, is split into principal
+//components with tred2/tqli: factor k at maturity l is sqrt(lambda_k) times
+//component l of the k-th eigenvector, the convention of ppdFactors.
+//
+//The covariance kernel runs on nThreads workers over CAL_CHUNKS fixed
+//ranges of observations. Each range is centered and multiplied in tiles of
+//CAL_TILE observations, so the rows of a tile are reused from cache for
+//every entry of the triangle; the ranges are merged in range order and the
+//result does not depend on the number of threads.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "nr_routines.h"
+#include "HJM_Securities.h"
+#include "HJM.h"
+#include "HJM_type.h"
+
+#define CAL_MAGIC "HJMFAC1"
+#define CAL_PER_YEAR 252	// observations per year of the history (daily closes)
+#define CAL_CHUNKS 64
+#define CAL_TILE 256
+#define CAL_MAX_THREADS 1024
+
+// Factor file: the header, then iFactors rows of iN-1 volatilities as in
+// ppdFactors, native byte order
+typedef struct
+{
+	char szMagic[8];
+	int iN;
+	int iFactors;
+	FTYPE dYears;
+	long lCurves;		//curves of the history
+	FTYPE dExplained;	//share of the variance the factors carry
+} factor_header;
+
+typedef struct
+{
+	const FTYPE *pdForward;		//lCurves x iN forward curves, row major
+	long lCurves;
+	int M;						//maturities with a factor, iN-1
+	FTYPE *pdMean;				//mean change of each maturity
+	FTYPE **ppdPartial;			//per range: M sums, or the M x M upper triangle
+	int bCross;					//pass 2: cross products instead of sums
+	int iNext;
+} cal;
+
+static long cal_range_first(const cal *p, int c)
+{
+	return (p->lCurves-1)*c/CAL_CHUNKS;
+}
+
+// Observations (changes) lFirst..lLast-1 of range c
+static void cal_range(cal *p, int c)
+{
+	long lFirst = cal_range_first(p, c), lLast = cal_range_first(p, c+1);
+	int M = p->M, iN = M+1;
+	FTYPE *pdSum = p->ppdPartial[c];
+	FTYPE *pdTile, *pdX, *pdY;
+	long t, r, nRows;
+	int i, j;
+
+	if (!p->bCross) {
+		for (i = 0; i < M; i++)
+			pdSum[i] = 0.0;
+		for (t = lFirst; t < lLast; t++)
+			for (i = 0; i < M; i++)
+				pdSum[i] += p->pdForward[(t+1)*iN + i] - p->pdForward[t*iN + i];
+		return;
+	}
+
+	for (i = 0; i < M*M; i++)
+		pdSum[i] = 0.0;
+	pdTile = (FTYPE *)malloc(sizeof(FTYPE)*CAL_TILE*M);
+	for (t = lFirst; t < lLast; t += CAL_TILE) {
+		nRows = lLast - t < CAL_TILE ? lLast - t : CAL_TILE;
+		//centered changes of the tile
+		for (r = 0; r < nRows; r++) {
+			pdX = pdTile + r*M;
+			for (i = 0; i < M; i++)
+				pdX[i] = p->pdForward[(t+r+1)*iN + i] - p->pdForward[(t+r)*iN + i] - p->pdMean[i];
+		}
+		//row i of the triangle against the whole tile
+		for (i = 0; i < M; i++) {
+			pdY = pdSum + i*M;
+			for (r = 0; r < nRows; r++) {
+				pdX = pdTile + r*M;
+				for (j = i; j < M; j++)
+					pdY[j] += pdX[i]*pdX[j];
+			}
+		}
+	}
+	free(pdTile);
+}
+
+static void *cal_worker(void *arg)
+{
+	cal *p = (cal *)arg;
+	int c;
+
+	while ((c = __atomic_fetch_add(&p->iNext, 1, __ATOMIC_RELAXED)) < CAL_CHUNKS)
+		cal_range(p, c);
+	return NULL;
+}
+
+static void cal_parallel(cal *p, int nThreads)
+{
+	pthread_t threads[CAL_MAX_THREADS];
+	int t, nStarted = 0;
+
+	p->iNext = 0;
+	for (t = 1; t < nThreads && t < CAL_MAX_THREADS; t++, nStarted++)
+		if (pthread_create(&threads[t-1], NULL, cal_worker, p) != 0)
+			break;
+	cal_worker(p);
+	for (t = 0; t < nStarted; t++)
+		pthread_join(threads[t], NULL);
+}
+
+// The forward curves of a history file: one curve per line, iN yields on the
+// -steps grid; lines starting with '#' are ignored. Returns the number of
+// curves, 0 on failure.
+static long cal_read_history(const char *pszHistory, int iN, FTYPE **ppdForward)
+{
+	FILE *fp;
+	char *pszLine = NULL, *p, *q;
+	size_t nLine = 0;
+	long lCurves = 0, lMax = 0, lLine = 0;
+	FTYPE *pdForward = NULL;
+	FTYPE *pdYield = dvector(0, iN-1);
+	int i, bBad = 0;
+
+	fp = fopen(pszHistory, "r");
+	if (!fp) {
+		fprintf(stderr, "Error: cannot open curve history %s\n", pszHistory);
+		free_dvector(pdYield, 0, iN-1);
+		return 0;
+	}
+	while (getline(&pszLine, &nLine, fp) > 0) {
+		lLine++;
+		for (p = pszLine; *p == ' ' || *p == '\t'; p++)
+			;
+		if (*p == '#' || *p == '\n' || *p == '\0')
+			continue;
+		for (i = 0; i < iN; i++, p = q) {
+			pdYield[i] = strtod(p, &q);
+			if (q == p)
+				break;
+		}
+		if (i < iN || strtod(p, &q) != 0.0 || q != p) {
+			fprintf(stderr, "Error: line %ld of %s is not a curve of %d yields\n", lLine, pszHistory, iN);
+			bBad = 1;
+			break;
+		}
+		if (lCurves == lMax) {
+			lMax = lMax ? 2*lMax : 4096;
+			pdForward = (FTYPE *)realloc(pdForward, sizeof(FTYPE)*lMax*iN);
+		}
+		HJM_Yield_to_Forward(pdForward + lCurves*iN, iN, pdYield);
+		lCurves++;
+	}
+	free(pszLine);
+	fclose(fp);
+	free_dvector(pdYield, 0, iN-1);
+
+	if (bBad || lCurves < 2) {
+		if (!bBad)
+			fprintf(stderr, "Error: %s needs at least two curves\n", pszHistory);
+		free(pdForward);
+		return 0;
+	}
+	*ppdForward = pdForward;
+	return lCurves;
+}
+
+int HJM_Calibrate(const char *pszHistory,	//Curve history, see cal_read_history
+		const char *pszFactors,				//Factor file to write
+		int iN,
+		FTYPE dYears,
+		int iFactors,						//Principal components to keep
+		int nThreads)
+{
+	//This function calibrates iFactors factor volatilities to the history
+	//and writes them to pszFactors. Returns 1 on success, 0 on failure.
+
+	cal p;
+	factor_header hdr;
+	FTYPE *pdForward;
+	FTYPE **ppdCov, **ppdVec, **ppdFactors, **ppdCorr;
+	FTYPE *pdEigen, *pdOff;
+	FTYPE dTotal = 0.0, dKept = 0.0, dErr = 0.0, dSign;
+	long lCurves;
+	int M = iN-1, c, i, j, k;
+	FILE *fp;
+
+	if (iFactors < 1 || iFactors > M) {
+		fprintf(stderr, "Error: number of factors must be between 1 and %d\n", M);
+		return 0;
+	}
+	lCurves = cal_read_history(pszHistory, iN, &pdForward);
+	if (lCurves == 0)
+		return 0;
+
+	memset(&p, 0, sizeof(p));
+	p.pdForward = pdForward;
+	p.lCurves = lCurves;
+	p.M = M;
+	p.pdMean = dvector(0, M-1);
+	p.ppdPartial = dmatrix(0, CAL_CHUNKS-1, 0, M*M-1);
+
+	//pass 1: mean change of every maturity
+	cal_parallel(&p, nThreads);
+	for (i = 0; i < M; i++) {
+		p.pdMean[i] = 0.0;
+		for (c = 0; c < CAL_CHUNKS; c++)
+			p.pdMean[i] += p.ppdPartial[c][i];
+		p.pdMean[i] /= lCurves-1;
+	}
+
+	//pass 2: covariance, annualized
+	p.bCross = 1;
+	cal_parallel(&p, nThreads);
+	ppdCov = dmatrix(1, M, 1, M);
+	for (i = 0; i < M; i++)
+		for (j = i; j < M; j++) {
+			ppdCov[i+1][j+1] = 0.0;
+			for (c = 0; c < CAL_CHUNKS; c++)
+				ppdCov[i+1][j+1] += p.ppdPartial[c][i*M + j];
+			ppdCov[i+1][j+1] *= (FTYPE)CAL_PER_YEAR/(lCurves > 2 ? lCurves-2 : 1);
+			ppdCov[j+1][i+1] = ppdCov[i+1][j+1];
+		}
+	free(pdForward);
+	free_dvector(p.pdMean, 0, M-1);
+	free_dmatrix(p.ppdPartial, 0, CAL_CHUNKS-1, 0, M*M-1);
+
+	//historical correlations, before tred2 overwrites the covariance
+	ppdCorr = dmatrix(0, M-1, 0, M-1);
+	for (i = 0; i < M; i++)
+		for (j = i; j < M; j++)
+			ppdCorr[i][j] = ppdCov[i+1][i+1] > 0 && ppdCov[j+1][j+1] > 0 ?
+				ppdCov[i+1][j+1]/sqrt(ppdCov[i+1][i+1]*ppdCov[j+1][j+1]) : 0.0;
+
+	//eigenvectors in the columns of ppdVec, which takes over ppdCov
+	pdEigen = dvector(1, M);
+	pdOff = dvector(1, M);
+	ppdVec = ppdCov;
+	tred2(ppdVec, M, pdEigen, pdOff);
+	k = tqli(pdEigen, pdOff, M, ppdVec);
+	free_dvector(pdOff, 1, M);
+	if (!k) {
+		fprintf(stderr, "Error: no eigendecomposition of the covariance of %s\n", pszHistory);
+		free_dmatrix(ppdVec, 1, M, 1, M);
+		free_dmatrix(ppdCorr, 0, M-1, 0, M-1);
+		free_dvector(pdEigen, 1, M);
+		return 0;
+	}
+	eigsrt(pdEigen, ppdVec, M);
+
+	//the leading components, signed so that each loads positively on the
+	//short end (factor 0 is then a parallel move up, as in the default table)
+	ppdFactors = dmatrix(0, iFactors-1, 0, M-1);
+	for (i = 1; i <= M; i++)
+		dTotal += pdEigen[i] > 0 ? pdEigen[i] : 0;
+	for (k = 0; k < iFactors; k++) {
+		dKept += pdEigen[k+1] > 0 ? pdEigen[k+1] : 0;
+		dSign = ppdVec[1][k+1] < 0 ? -1.0 : 1.0;
+		for (j = 0; j < M; j++)
+			ppdFactors[k][j] = pdEigen[k+1] > 0 ? dSign*sqrt(pdEigen[k+1])*ppdVec[j+1][k+1] : 0.0;
+	}
+
+	//fit: the correlations the factors imply against the historical ones
+	FTYPE **ppdModel = dmatrix(0, M-1, 0, M-1);
+	HJM_Correlations(ppdModel, iN, iFactors, ppdFactors);
+	for (i = 0; i < M; i++)
+		for (j = i; j < M; j++)
+			if (fabs(ppdModel[i][j] - ppdCorr[i][j]) > dErr)
+				dErr = fabs(ppdModel[i][j] - ppdCorr[i][j]);
+	free_dmatrix(ppdModel, 0, M-1, 0, M-1);
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.szMagic, CAL_MAGIC, sizeof(CAL_MAGIC));
+	hdr.iN = iN;
+	hdr.iFactors = iFactors;
+	hdr.dYears = dYears;
+	hdr.lCurves = lCurves;
+	hdr.dExplained = dTotal > 0 ? dKept/dTotal : 0.0;
+
+	//a row at a time, dmatrix rows are padded
+	fp = fopen(pszFactors, "wb");
+	int bOk = fp && fwrite(&hdr, sizeof(hdr), 1, fp) == 1;
+	for (k = 0; bOk && k < iFactors; k++)
+		bOk = fwrite(ppdFactors[k], sizeof(FTYPE), M, fp) == (size_t)M;
+	if (!bOk) {
+		fprintf(stderr, "Error: cannot write factor file %s\n", pszFactors);
+		if (fp)
+			fclose(fp);
+		k = 0;
+	} else {
+		k = fclose(fp) == 0;
+		if (!k)
+			fprintf(stderr, "Error: cannot write factor file %s\n", pszFactors);
+	}
+
+	if (k) {
+		printf("Calibrated %d factors on %ld curves: %.2f%% of the variance, correlations within %.4f\n",
+				iFactors, lCurves, 100.0*hdr.dExplained, dErr);
+		for (i = 0; i < iFactors; i++) {
+			printf("Factor %d:", i);
+			for (j = 0; j < M; j++)
+				printf(" %.6f", ppdFactors[i][j]);
+			printf("\n");
+		}
+	}
+
+	free_dmatrix(ppdVec, 1, M, 1, M);
+	free_dmatrix(ppdCorr, 0, M-1, 0, M-1);
+	free_dvector(pdEigen, 1, M);
+	free_dmatrix(ppdFactors, 0, iFactors-1, 0, M-1);
+	return k;
+}
+
+int HJM_Read_Factors(const char *pszFactors,	//Factor file written by HJM_Calibrate
+		int iN,
+		FTYPE dYears,
+		FTYPE ***pppdFactors)	//Output: iFactors x iN-1 factor volatilities
+{
+	//This function maps the factor file and copies its volatilities for the
+	//iN-step grid over dYears. Returns the number of factors, 0 on failure.
+
+	factor_header hdr;
+	struct stat st;
+	const char *pFile;
+	FTYPE **ppdFactors;
+	int fd, k, j;
+
+	fd = open(pszFactors, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(stderr, "Error: cannot open factor file %s\n", pszFactors);
+		if (fd >= 0)
+			close(fd);
+		return 0;
+	}
+	if ((size_t)st.st_size < sizeof(hdr)) {
+		fprintf(stderr, "Error: %s is not a factor file\n", pszFactors);
+		close(fd);
+		return 0;
+	}
+	pFile = (const char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (pFile == MAP_FAILED) {
+		fprintf(stderr, "Error: cannot map factor file %s\n", pszFactors);
+		return 0;
+	}
+
+	memcpy(&hdr, pFile, sizeof(hdr));
+	if (memcmp(hdr.szMagic, CAL_MAGIC, sizeof(CAL_MAGIC)) != 0 || hdr.iFactors < 1 || hdr.iN < 2
+			|| (size_t)st.st_size != sizeof(hdr) + sizeof(FTYPE)*hdr.iFactors*(hdr.iN-1)) {
+		fprintf(stderr, "Error: %s is not a factor file\n", pszFactors);
+		munmap((void *)pFile, st.st_size);
+		return 0;
+	}
+	if (hdr.iN != iN || hdr.dYears != dYears) {
+		fprintf(stderr, "Error: %s is calibrated for %d steps over %g years, not %d over %g (-steps)\n",
+				pszFactors, hdr.iN, hdr.dYears, iN, dYears);
+		munmap((void *)pFile, st.st_size);
+		return 0;
+	}
+
+	const FTYPE *pdVol = (const FTYPE *)(pFile + sizeof(hdr));
+	ppdFactors = dmatrix(0, hdr.iFactors-1, 0, iN-2);
+	for (k = 0; k < hdr.iFactors; k++)
+		for (j = 0; j <= iN-2; j++)
+			ppdFactors[k][j] = pdVol[k*(iN-1) + j];
+	munmap((void *)pFile, st.st_size);
+
+	*pppdFactors = ppdFactors;
+	return hdr.iFactors;
+}
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include <iostream>
 #include <sstream>
 #include <time.h>
@@ -14,16 +15,17 @@
 #include "HJM.h"
 #include "HJM_Securities.h"
 #include "HJM_type.h"
+#include "HJM_prof.h"
+#include "icdf.h"
+#include "rng.h"
+#include "HJM_engine.h"
+#include <pthread.h>	// init_book, in every version
 
 #ifdef ENABLE_THREADS
-#include <pthread.h>
 #define MAX_THREAD 1024
 
 #ifdef TBB_VERSION
-#include "tbb/task_scheduler_init.h"
-#include "tbb/blocked_range.h"
-#include "tbb/parallel_for.h"
-#include "tbb/cache_aligned_allocator.h"
+#include "HJM_tbb.h"
 tbb::cache_aligned_allocator<FTYPE> memory_ftype;
 tbb::cache_aligned_allocator<parm> memory_parm;
 #define TBB_GRAINSIZE 1
@@ -41,6 +43,8 @@ tbb::cache_aligned_allocator<parm> memory_parm;
 #include "mpi.h"
 #endif // MPI
 
+#include "cl_cache.h"
+
 #define MAX_SOURCE_SIZE 0x100000
 #define KCNT 2
 #define GLOBAL_WORK_SIZE 1024
@@ -52,6 +56,20 @@ tbb::cache_aligned_allocator<parm> memory_parm;
 #define LOCAL_WORK_SIZE1 64
 #define LOCAL_WORK_SIZE2 16
 #endif
+
+// Launch geometry of the two kernels. The macros above are the defaults; the
+// first run on a device searches it (cl_tune_geometry) and keeps the winner
+// in the OpenCL cache (cl_cache.h), -cl_tune searches again.
+struct cl_geometry
+{
+	int iGlobal;		// work-items of both kernels
+	int iLocal1;		// work-group size of swaption_RanGen
+	int iLocal2;		// work-group size of swaption_sim
+	int iBlock;			// paths per block (BLOCKSIZE of swaption_sim)
+};
+
+#define CL_TUNE_ITERS 4					// blocks per work-item in a calibration run
+#define CL_TUNE_MAX_Z (64 << 20)		// bytes of shocks a calibration run may use
 using namespace std;
 #endif // USE_CPU || USE_GPU || USE_MPI || USE_SNUCL
 
@@ -62,10 +80,75 @@ using namespace std;
 int NUM_TRIALS = DEFAULT_NUM_TRIALS;
 int nThreads = 1;
 int nSwaptions = 1;
-int iN = 11; 
+int iN = 11; 		// -steps
 FTYPE dYears = 5.5; 
 int iFactors = 3; 
 parm *swaptions;
+FTYPE **factors=NULL;
+
+// -affinity: pin workers to cores
+int iAffinity = AFFINITY_NONE;
+
+// The book is built on the threads that price it: the workers below build each
+// swaption just before pricing it (bLazyBook), so setup overlaps with pricing
+// and the swaption is first-touched on its worker's NUMA node; the engine,
+// -bermudan and OpenCL runs need the whole book up front and build it in
+// parallel slices (init_book)
+int bLazyBook = 0;
+
+// Scenario-batch mode: nScenarios > 0 prices every swaption under each scenario
+int nScenarios = 0;
+scen *scenarios;
+FTYPE dLadderBp;	// -ladder
+int bLadder = 0;
+FTYPE *pdScenPrice; // nSwaptions x nScenarios price/stderr pairs
+
+// -ckpt: progress of every swaption, saved periodically by a writer thread
+const char *pszCkpt = NULL;
+int iCkptInterval = 60;
+int bResume = 0;
+swaption_state *states = NULL;
+
+// -serve: price requests from a Unix domain socket instead of the built-in book
+const char *pszServe = NULL;
+int iBatchWindowUs = 200;
+
+// -backend: plain runs price the book through an hjm::Engine (HJM_engine.h);
+// checkpoint, scenario and pinned runs keep the workers below
+int iBackend = -1;		// -1: the make version's, see hjm::backend_default
+int bEngine = 0;
+
+// -bermudan: price the book as Bermudan swaptions by Longstaff-Schwartz; the
+// workers split the paths of one swaption at a time (HJM_Swaption_Bermudan.cpp)
+int bBermudan = 0;
+
+// -calibrate: fit -nf factor volatilities to a curve history, write them to
+// the -factors file and stop; -factors alone prices with the file's factors
+const char *pszCalibrate = NULL;
+const char *pszFactors = NULL;
+int bFactorCount = 0;	// -nf given
+
+// -progressive: price the book in rounds of 10x more trials from this many,
+// each round continuing the paths of the last, with a snapshot after each
+long lFirstRound = 0;
+
+// -jobs: price the book by priority and deadline (HJM_schedule.cpp), -slice
+// trials of a swaption at a time
+const char *pszJobs = NULL;
+swaption_job *jobs = NULL;
+long lSlice = 64*BLOCK_SIZE;
+int bSlice = 0;		// -slice given
+
+// -cl_tune: search the OpenCL launch geometry even if one is cached
+int bClTune = 0;
+
+// -maxmem: MB the OpenCL versions may spend on shocks; the paths are then
+// simulated in chunks that fit (0: one chunk)
+long lMaxMemMb = 0;
+
+// -icdf/-isa: inverse-normal algorithm and instruction set (icdf.h)
+int iIcdfAlg = ICDF_MORO;
+int iIcdfIsa = ICDF_SCALAR;
 
 // =================================================
 FTYPE *dSumSimSwaptionPrice_global_ptr;
@@ -74,25 +157,124 @@ int chunksize;
 
 int timespec_subtract(struct timespec*, struct timespec*, struct timespec*);
 
+// The curve rises 1% a year: .005 a step on the default grid, exactly
+static FTYPE yield_step()
+{
+	return .01*(dYears/iN);
+}
+
+void init_swaption(int i){
+	int j, k;
+
+	swaptions[i].Id = i;
+	swaptions[i].iN = iN;
+	swaptions[i].iFactors = iFactors;
+	swaptions[i].dYears = dYears;
+
+	swaptions[i].dStrike =  (double)i / (double)nSwaptions; 
+	swaptions[i].dCompounding =  0;
+	swaptions[i].dMaturity =  1;
+	swaptions[i].dTenor =  2.0;
+	swaptions[i].dPaymentInterval =  1.0;
+
+	swaptions[i].pdYield = dvector(0,iN-1);;
+	swaptions[i].pdYield[0] = .1;
+	for(j=1;j<=swaptions[i].iN-1;++j)
+		swaptions[i].pdYield[j] = swaptions[i].pdYield[j-1]+yield_step();
+
+	swaptions[i].ppdFactors = dmatrix(0, swaptions[i].iFactors-1, 0, swaptions[i].iN-2);
+	for(k=0;k<=swaptions[i].iFactors-1;++k)
+		memcpy(swaptions[i].ppdFactors[k], factors[k], sizeof(FTYPE)*(swaptions[i].iN-1));
+}
+
+static void *init_slice(void *arg){
+	long t = (long)arg;
+	int beg = (int)((long)nSwaptions*t/nThreads);
+	int end = (int)((long)nSwaptions*(t+1)/nThreads);
+
+	for (int i = beg; i < end; i++)
+		init_swaption(i);
+	return NULL;
+}
+
+// Builds the whole book on nThreads threads, a contiguous slice each; a slice
+// whose thread cannot be started is built by the caller
+void init_book(){
+	pthread_t *pThreads;
+	int *pbStarted;
+	long t;
+
+	if (nThreads <= 1 || nSwaptions < 2*nThreads) {
+		for (int i = 0; i < nSwaptions; i++)
+			init_swaption(i);
+		return;
+	}
+	pThreads = (pthread_t *)malloc(sizeof(pthread_t)*nThreads);
+	pbStarted = (int *)calloc(nThreads, sizeof(int));
+	for (t = 1; t < nThreads; t++)
+		pbStarted[t] = pthread_create(&pThreads[t], NULL, init_slice, (void *)t) == 0;
+	for (t = 0; t < nThreads; t++)
+		if (!pbStarted[t])
+			init_slice((void *)t);
+	for (t = 1; t < nThreads; t++)
+		if (pbStarted[t])
+			pthread_join(pThreads[t], NULL);
+	free(pbStarted);
+	free(pThreads);
+}
+
+void price_swaption(int i){
+	FTYPE pdSwaptionPrice[2];
+	int iSuccess;
+
+	if (states == NULL)
+		iSuccess = HJM_Swaption_Blocking(pdSwaptionPrice,  swaptions[i].dStrike, 
+				swaptions[i].dCompounding, swaptions[i].dMaturity, 
+				swaptions[i].dTenor, swaptions[i].dPaymentInterval,
+				swaptions[i].iN, swaptions[i].iFactors, swaptions[i].dYears, 
+				swaptions[i].pdYield, swaptions[i].ppdFactors,
+				rng_stream(RANDSEEDVAL, i), NUM_TRIALS, BLOCK_SIZE, 0);
+	else // continues from states[i]; a finished swaption only recomputes its result
+		iSuccess = HJM_Swaption_Blocking_Resume(pdSwaptionPrice,  swaptions[i].dStrike, 
+				swaptions[i].dCompounding, swaptions[i].dMaturity, 
+				swaptions[i].dTenor, swaptions[i].dPaymentInterval,
+				swaptions[i].iN, swaptions[i].iFactors, swaptions[i].dYears, 
+				swaptions[i].pdYield, swaptions[i].ppdFactors,
+				rng_stream(RANDSEEDVAL, i), NUM_TRIALS, BLOCK_SIZE, &states[i]);
+	assert(iSuccess == 1);
+	swaptions[i].dSimSwaptionMeanPrice = pdSwaptionPrice[0];
+	swaptions[i].dSimSwaptionStdError = pdSwaptionPrice[1];
+}
+
+void price_scenarios(int i){
+	int iSuccess = HJM_Swaption_Blocking_Scenarios(pdScenPrice + 2*nScenarios*i, swaptions[i].dStrike,
+			swaptions[i].dCompounding, swaptions[i].dMaturity,
+			swaptions[i].dTenor, swaptions[i].dPaymentInterval,
+			swaptions[i].iN, swaptions[i].iFactors, swaptions[i].dYears,
+			swaptions[i].pdYield, swaptions[i].ppdFactors,
+			nScenarios, scenarios,
+			rng_stream(RANDSEEDVAL, i), NUM_TRIALS, BLOCK_SIZE);
+	assert(iSuccess == 1);
+	swaptions[i].dSimSwaptionMeanPrice = pdScenPrice[2*nScenarios*i];
+	swaptions[i].dSimSwaptionStdError = pdScenPrice[2*nScenarios*i + 1];
+}
+
 
 #ifdef TBB_VERSION
 struct Worker {
 	Worker(){}
 	void operator()(const tbb::blocked_range<int> &range) const {
-		FTYPE pdSwaptionPrice[2];
 		int begin = range.begin();
 		int end   = range.end();
 
 		for(int i=begin; i!=end; i++) {
-			int iSuccess = HJM_Swaption_Blocking(pdSwaptionPrice,  swaptions[i].dStrike, 
-					swaptions[i].dCompounding, swaptions[i].dMaturity, 
-					swaptions[i].dTenor, swaptions[i].dPaymentInterval,
-					swaptions[i].iN, swaptions[i].iFactors, swaptions[i].dYears, 
-					swaptions[i].pdYield, swaptions[i].ppdFactors,
-					100, NUM_TRIALS, BLOCK_SIZE, 0);
-			assert(iSuccess == 1);
-			swaptions[i].dSimSwaptionMeanPrice = pdSwaptionPrice[0];
-			swaptions[i].dSimSwaptionStdError = pdSwaptionPrice[1];
+			if (bLazyBook)
+				init_swaption(i);
+			if (nScenarios > 0) {
+				price_scenarios(i);
+				continue;
+			}
+			price_swaption(i);
 
 		}
 
@@ -106,7 +288,6 @@ struct Worker {
 
 void * worker(void *arg){
 	int tid = *((int *)arg);
-	FTYPE pdSwaptionPrice[2];
 
 	int chunksize = nSwaptions/nThreads;
 	int beg = tid*chunksize;
@@ -115,15 +296,13 @@ void * worker(void *arg){
 		end = nSwaptions;
 
 	for(int i=beg; i < end; i++) {
-		int iSuccess = HJM_Swaption_Blocking(pdSwaptionPrice,  swaptions[i].dStrike, 
-				swaptions[i].dCompounding, swaptions[i].dMaturity, 
-				swaptions[i].dTenor, swaptions[i].dPaymentInterval,
-				swaptions[i].iN, swaptions[i].iFactors, swaptions[i].dYears, 
-				swaptions[i].pdYield, swaptions[i].ppdFactors,
-				100, NUM_TRIALS, BLOCK_SIZE, 0);
-		assert(iSuccess == 1);
-		swaptions[i].dSimSwaptionMeanPrice = pdSwaptionPrice[0];
-		swaptions[i].dSimSwaptionStdError = pdSwaptionPrice[1];
+		if (bLazyBook)
+			init_swaption(i);
+		if (nScenarios > 0) {
+			price_scenarios(i);
+			continue;
+		}
+		price_swaption(i);
 	}
 
 	return NULL;    
@@ -131,11 +310,307 @@ void * worker(void *arg){
 
 
 
+hjm::Options engine_options(){
+	hjm::Options opt;
+
+	opt.nThreads = nThreads;
+	opt.lTrials = NUM_TRIALS;
+	opt.iRng = rng_selected();
+	opt.iIcdfAlg = iIcdfAlg;
+	opt.iIcdfIsa = iIcdfIsa;
+	return opt;
+}
+
+// -backend auto: the fastest backend on this book and machine
+void calibrate_backend(){
+	double pdRate[hjm::BACKEND_NBACKENDS];
+	int b;
+
+	iBackend = hjm::backend_calibrate(engine_options(), swaptions, nSwaptions, pdRate);
+	printf("Backend: auto ->");
+	for (b = 0; b < hjm::BACKEND_NBACKENDS; b++)
+		if (pdRate[b] > 0.0)
+			printf(" %s%s %.0f paths/s", b == iBackend ? "*" : "", hjm::backend_name[b], pdRate[b]);
+	if (pdRate[iBackend] == 0.0)
+		printf(" %s (not timed: one thread or a small book)", hjm::backend_name[iBackend]);
+	printf("\n");
+}
+
+// -progressive: sweeps the book with lFirstRound, 10x, 100x... trials up to
+// NUM_TRIALS, each round continuing the paths and the sums of the last, and
+// reports every round but the last on stderr. The last round leaves the
+// prices of a plain run in pdPrice. Returns the swaptions priced in it.
+int price_rounds(hjm::Engine *pEngine, FTYPE *pdPrice){
+	swaption_state *pStates;
+	struct timespec start, now, spent;
+	long lRound, lTrials;
+	int i, iRound, nGood;
+
+	pStates = (swaption_state *)calloc(nSwaptions, sizeof(swaption_state));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (iRound = 0, lRound = lFirstRound; ; iRound++, lRound *= 10) {
+		// rounds end on a block boundary, where a state can be continued
+		lTrials = (lRound + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+		if (lTrials > NUM_TRIALS)
+			lTrials = NUM_TRIALS;
+		nGood = pEngine->refine(swaptions, nSwaptions, pStates, lTrials, pdPrice);
+		if (lTrials == NUM_TRIALS)
+			break;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		timespec_subtract(&spent, &now, &start);
+		fprintf(stderr,"Round %d: %ld trials, %ld.%03ld s\n", iRound, lTrials, (long)spent.tv_sec,
+				spent.tv_nsec / 1000000);
+		for (i = 0; i < nSwaptions; i++)
+			fprintf(stderr,"  Swaption%d: [SwaptionPrice: %.10lf StdError: %.10lf] \n",
+					i, pdPrice[2*i], pdPrice[2*i + 1]);
+	}
+	free(pStates);
+	return nGood;
+}
+
+// Prices the whole book with one engine call; returns 0 if a swaption failed
+int price_book(){
+	hjm::Engine *pEngine;
+	FTYPE *pdPrice;
+	int i, nGood;
+
+	pEngine = hjm::Engine::create(iBackend, engine_options());
+	if (!pEngine)
+		exit(1);
+
+	pdPrice = (FTYPE *)malloc(sizeof(FTYPE)*2*nSwaptions);
+	if (lFirstRound > 0)
+		nGood = price_rounds(pEngine, pdPrice);
+	else
+		nGood = pEngine->price(swaptions, nSwaptions, pdPrice);
+	for (i = 0; i < nSwaptions; i++) {
+		swaptions[i].dSimSwaptionMeanPrice = pdPrice[2*i];
+		swaptions[i].dSimSwaptionStdError = pdPrice[2*i + 1];
+	}
+	free(pdPrice);
+	delete pEngine;
+	return nGood == nSwaptions;
+}
+
+// Prices the whole book as Bermudans, one swaption at a time on all the
+// threads; returns 0 if a swaption failed
+int price_bermudans(){
+	FTYPE pdSwaptionPrice[2];
+	int i, nGood = 0;
+
+	for (i = 0; i < nSwaptions; i++) {
+		if (HJM_Swaption_Bermudan(pdSwaptionPrice, swaptions[i].dStrike,
+				swaptions[i].dCompounding, swaptions[i].dMaturity,
+				swaptions[i].dTenor, swaptions[i].dPaymentInterval,
+				swaptions[i].iN, swaptions[i].iFactors, swaptions[i].dYears,
+				swaptions[i].pdYield, swaptions[i].ppdFactors,
+				rng_stream(RANDSEEDVAL, i), NUM_TRIALS, BLOCK_SIZE, nThreads) == 1)
+			nGood++;
+		else
+			pdSwaptionPrice[0] = pdSwaptionPrice[1] = -1.0;
+		swaptions[i].dSimSwaptionMeanPrice = pdSwaptionPrice[0];
+		swaptions[i].dSimSwaptionStdError = pdSwaptionPrice[1];
+	}
+	return nGood == nSwaptions;
+}
 
 //Please note: Whenever we type-cast to (int), we add 0.5 to ensure that the value is rounded to the correct number. 
 //For instance, if X/Y = 0.999 then (int) (X/Y) will equal 0 and not 1 (as (int) rounds down).
 //Adding 0.5 ensures that this does not happen. Therefore we use (int) (X/Y + 0.5); instead of (int) (X/Y);
 
+#if (defined(USE_CPU) || defined(USE_GPU)) || (defined(USE_MPI) || defined(USE_SNUCL))
+// What swaption_sim needs of a swaption, for the calibration runs
+struct cl_sim_args
+{
+	FTYPE ddelt, sqrt_ddelt, dSwapVectorYears;
+	int iSwapVectorLength, iSwapStartTimeIndex;
+	FTYPE *pdForward, *pdTotalDrift, *ppdFactors, *pdSwapPayoffs;
+};
+
+// nItems over nParts ranges sti[k]..edi[k], the first nItems % nParts one longer
+static void cl_split(unsigned int nItems, int nParts, unsigned int *sti, unsigned int *edi)
+{
+	unsigned int stIndex = 0;
+
+	for (int k = 0; k < nParts; k++) {
+		sti[k] = stIndex;
+		stIndex += nItems / nParts + ((unsigned int)k < nItems % nParts ? 1 : 0);
+		edi[k] = stIndex - 1;
+	}
+}
+
+static cl_mem cl_tune_buffer(cl_context context, cl_command_queue queue, size_t size, const void *host, int *err)
+{
+	cl_int e;
+	cl_mem buf = clCreateBuffer(context, CL_MEM_READ_WRITE, size, NULL, &e);
+
+	if (e == CL_SUCCESS && host)
+		e = clEnqueueWriteBuffer(queue, buf, CL_TRUE, 0, size, host, 0, NULL, NULL);
+	*err |= e;
+	return e == CL_SUCCESS ? buf : NULL;
+}
+
+// One swaption_RanGen + swaption_sim run of swaption 0 with geometry *g.
+// Returns the seconds for *plPaths paths, -1 if the device rejects the
+// geometry or the shocks would not fit in CL_TUNE_MAX_Z.
+static double cl_tune_run(cl_context context, cl_command_queue queue, cl_kernel *kernels, const cl_geometry *g,
+		const cl_sim_args *a, long *plPaths)
+{
+	size_t globalWorkSize = g->iGlobal;
+	size_t localWorkSize1 = g->iLocal1;
+	size_t localWorkSize2 = g->iLocal2;
+	size_t zPerBlock = sizeof(FTYPE) * iFactors * (iN-1) * g->iBlock;
+	int iIters = CL_TUNE_MAX_Z / (zPerBlock * g->iGlobal);
+	int k, err = CL_SUCCESS, dev_i = 0, iGlobal = g->iGlobal;
+	long lRndSeed = 100, lZBase = 0;
+	struct timespec t0, t1, spent;
+
+	if (iIters < 1)
+		return -1;
+	if (iIters > CL_TUNE_ITERS)
+		iIters = CL_TUNE_ITERS;
+	unsigned int nBlocks = g->iGlobal * iIters;
+	unsigned int nRan = iFactors * (iN-1) * g->iBlock * nBlocks;
+	*plPaths = (long)nBlocks * g->iBlock;
+
+	unsigned int *wi = (unsigned int*) malloc(sizeof(unsigned int) * 4 * g->iGlobal);
+	cl_split(nRan, g->iGlobal, wi, wi + g->iGlobal);
+	cl_split(nBlocks, g->iGlobal, wi + 2*g->iGlobal, wi + 3*g->iGlobal);
+
+	cl_mem cl_pdZ = cl_tune_buffer(context, queue, zPerBlock * nBlocks, NULL, &err);
+	cl_mem cl_sti = cl_tune_buffer(context, queue, sizeof(unsigned int) * g->iGlobal, wi, &err);
+	cl_mem cl_edi = cl_tune_buffer(context, queue, sizeof(unsigned int) * g->iGlobal, wi + g->iGlobal, &err);
+	cl_mem cl_iter_wi_sti = cl_tune_buffer(context, queue, sizeof(unsigned int) * g->iGlobal, wi + 2*g->iGlobal, &err);
+	cl_mem cl_iter_wi_edi = cl_tune_buffer(context, queue, sizeof(unsigned int) * g->iGlobal, wi + 3*g->iGlobal, &err);
+	cl_mem cl_pdRows = cl_tune_buffer(context, queue, sizeof(FTYPE) * 2 * iN * g->iGlobal, NULL, &err);
+	cl_mem cl_pdForward = cl_tune_buffer(context, queue, sizeof(FTYPE) * iN, a->pdForward, &err);
+	cl_mem cl_pdTotalDrift = cl_tune_buffer(context, queue, sizeof(FTYPE) * (iN-1), a->pdTotalDrift, &err);
+	cl_mem cl_ppdFactors = cl_tune_buffer(context, queue, sizeof(FTYPE) * iFactors * (iN-1), a->ppdFactors, &err);
+	cl_mem cl_pdSwapPayoffs = cl_tune_buffer(context, queue, sizeof(FTYPE) * a->iSwapVectorLength, a->pdSwapPayoffs, &err);
+	cl_mem cl_dSum = cl_tune_buffer(context, queue, sizeof(FTYPE) * g->iGlobal, NULL, &err);
+	cl_mem cl_dSumSquare = cl_tune_buffer(context, queue, sizeof(FTYPE) * g->iGlobal, NULL, &err);
+	cl_mem mems[] = { cl_pdZ, cl_sti, cl_edi, cl_iter_wi_sti, cl_iter_wi_edi, cl_pdRows, cl_pdForward,
+		cl_pdTotalDrift, cl_ppdFactors, cl_pdSwapPayoffs, cl_dSum, cl_dSumSquare };
+
+	if (err == CL_SUCCESS) {
+		err = clSetKernelArg(kernels[0], 0, sizeof(int), (void*) &iGlobal);
+		err |= clSetKernelArg(kernels[0], 1, sizeof(int), (void*) &dev_i);
+		err |= clSetKernelArg(kernels[0], 2, sizeof(long), (void*) &lRndSeed);
+		err |= clSetKernelArg(kernels[0], 3, sizeof(cl_mem), (void*) &cl_pdZ);
+		err |= clSetKernelArg(kernels[0], 4, sizeof(cl_mem), (void*) &cl_sti);
+		err |= clSetKernelArg(kernels[0], 5, sizeof(cl_mem), (void*) &cl_edi);
+		err |= clSetKernelArg(kernels[0], 6, sizeof(long), (void*) &lZBase);
+		err |= clSetKernelArg(kernels[0], 7, sizeof(int), (void*) &iN);
+		err |= clSetKernelArg(kernels[0], 8, sizeof(int), (void*) &iFactors);
+
+		err |= clSetKernelArg(kernels[1], 0, sizeof(cl_mem), (void*) &cl_pdRows);
+		err |= clSetKernelArg(kernels[1], 1, sizeof(int), (void*) &iN);
+		err |= clSetKernelArg(kernels[1], 2, sizeof(int), (void*) &iFactors);
+		err |= clSetKernelArg(kernels[1], 3, sizeof(FTYPE), (void*) &dYears);
+		err |= clSetKernelArg(kernels[1], 4, sizeof(int), (void*) &g->iBlock);
+		err |= clSetKernelArg(kernels[1], 5, sizeof(FTYPE), (void*) &a->ddelt);
+		err |= clSetKernelArg(kernels[1], 6, sizeof(FTYPE), (void*) &a->sqrt_ddelt);
+		err |= clSetKernelArg(kernels[1], 7, sizeof(int), (void*) &a->iSwapVectorLength);
+		err |= clSetKernelArg(kernels[1], 8, sizeof(int), (void*) &a->iSwapStartTimeIndex);
+		err |= clSetKernelArg(kernels[1], 9, sizeof(FTYPE), (void*) &a->dSwapVectorYears);
+		err |= clSetKernelArg(kernels[1], 10, sizeof(cl_mem), (void*) &cl_pdForward);
+		err |= clSetKernelArg(kernels[1], 11, sizeof(cl_mem), (void*) &cl_pdTotalDrift);
+		err |= clSetKernelArg(kernels[1], 12, sizeof(cl_mem), (void*) &cl_ppdFactors);
+		err |= clSetKernelArg(kernels[1], 13, sizeof(cl_mem), (void*) &cl_pdZ);
+		err |= clSetKernelArg(kernels[1], 14, sizeof(cl_mem), (void*) &cl_pdSwapPayoffs);
+		err |= clSetKernelArg(kernels[1], 15, sizeof(cl_mem), (void*) &cl_dSum);
+		err |= clSetKernelArg(kernels[1], 16, sizeof(cl_mem), (void*) &cl_dSumSquare);
+		err |= clSetKernelArg(kernels[1], 17, sizeof(cl_mem), (void*) &cl_iter_wi_sti);
+		err |= clSetKernelArg(kernels[1], 18, sizeof(cl_mem), (void*) &cl_iter_wi_edi);
+	}
+	if (err == CL_SUCCESS) {
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		err = clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL, &globalWorkSize, &localWorkSize1, 0, NULL, NULL);
+		if (err == CL_SUCCESS)
+			err = clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL, &globalWorkSize, &localWorkSize2, 0, NULL, NULL);
+		err |= clFinish(queue);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+	}
+
+	for (k = 0; k < (int)(sizeof(mems) / sizeof(mems[0])); k++)
+		if (mems[k])
+			clReleaseMemObject(mems[k]);
+	free(wi);
+
+	if (err != CL_SUCCESS)
+		return -1;
+	timespec_subtract(&spent, &t1, &t0);
+	return spent.tv_sec + spent.tv_nsec * 1e-9;
+}
+
+static void cl_tune_try(cl_context context, cl_command_queue queue, cl_kernel *kernels, const cl_sim_args *a,
+		const cl_geometry *g, cl_geometry *pBest, double *pdBest)
+{
+	long lPaths;
+	double dTime = cl_tune_run(context, queue, kernels, g, a, &lPaths);
+
+	if (dTime > 0 && lPaths / dTime > *pdBest) {
+		*pdBest = lPaths / dTime;
+		*pBest = *g;
+	}
+}
+
+// Searches the launch geometry on one device with short calibration runs:
+// global and swaption_sim work-group sizes together, then the
+// swaption_RanGen work-group size, then the block size. *pGeom comes in
+// with the defaults and leaves with the fastest geometry; returns its
+// paths/s, 0 if no run succeeded.
+static double cl_tune_geometry(cl_context context, cl_device_id device, cl_command_queue queue, cl_kernel *kernels,
+		const cl_sim_args *a, cl_geometry *pGeom)
+{
+	static const int pGlobal[] = { 256, 512, 1024, 2048, 4096, 8192 };
+	static const int pLocal[] = { 8, 16, 32, 64, 128, 256 };
+	static const int pBlock[] = { 4, 8, 16, 32, 64 };
+	const int nGlobal = sizeof(pGlobal) / sizeof(int);
+	const int nLocal = sizeof(pLocal) / sizeof(int);
+	const int nBlock = sizeof(pBlock) / sizeof(int);
+	size_t maxLocal[KCNT];
+	cl_geometry g, best = *pGeom;
+	double dBest = 0;
+	long lPaths;
+	int k, l;
+
+	for (k = 0; k < KCNT; k++)
+		if (clGetKernelWorkGroupInfo(kernels[k], device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t),
+					&maxLocal[k], NULL) != CL_SUCCESS)
+			maxLocal[k] = k == 0 ? pGeom->iLocal1 : pGeom->iLocal2;
+
+	// the first launch pays for allocations and code upload
+	cl_tune_run(context, queue, kernels, pGeom, a, &lPaths);
+	cl_tune_try(context, queue, kernels, a, pGeom, &best, &dBest);
+
+	g = *pGeom;
+	for (k = 0; k < nGlobal; k++)
+		for (l = 0; l < nLocal && pLocal[l] <= (int)maxLocal[1] && pLocal[l] <= pGlobal[k]; l++) {
+			g.iGlobal = pGlobal[k];
+			g.iLocal1 = pGeom->iLocal1 <= pGlobal[k] && pGeom->iLocal1 <= (int)maxLocal[0] ? pGeom->iLocal1 : pLocal[0];
+			g.iLocal2 = pLocal[l];
+			cl_tune_try(context, queue, kernels, a, &g, &best, &dBest);
+		}
+
+	g = best;
+	for (l = 0; l < nLocal && pLocal[l] <= (int)maxLocal[0] && pLocal[l] <= g.iGlobal; l++) {
+		g.iLocal1 = pLocal[l];
+		cl_tune_try(context, queue, kernels, a, &g, &best, &dBest);
+	}
+
+	g = best;
+	for (k = 0; k < nBlock; k++) {
+		g.iBlock = pBlock[k];
+		cl_tune_try(context, queue, kernels, a, &g, &best, &dBest);
+	}
+
+	*pGeom = best;
+	return dBest;
+}
+#endif // OpenCL
+
 int main(int argc, char *argv[])
 {
 	int iSuccess = 0;
@@ -143,8 +618,6 @@ int main(int argc, char *argv[])
 
 	struct timespec start, end, spent;
 
-	FTYPE **factors=NULL;
-
 #ifdef PARSEC_VERSION
 #define __PARSEC_STRING(x) #x
 #define __PARSEC_XSTRING(x) __PARSEC_STRING(x)
@@ -160,7 +633,7 @@ int main(int argc, char *argv[])
 
 	if(argc == 1)
 	{
-		fprintf(stderr," usage: \n\t-ns [number of swaptions (should be > number of threads]\n\t-sm [number of simulations]\n\t-nt [number of threads]\n"); 
+		fprintf(stderr," usage: \n\t-ns [number of swaptions (should be > number of threads]\n\t-sm [number of simulations]\n\t-nt [number of threads]\n\t-scen [scenario file]\n\t-ladder [bump size in bp]\n\t-affinity [none|compact|scatter]\n\t-ckpt [checkpoint file]\n\t-ckpt_interval [seconds between checkpoints]\n\t-resume [continue from the -ckpt file]\n\t-serve [unix socket path]\n\t-batch_us [request batching window in us]\n\t-icdf [moro|acklam|as241]\n\t-isa [scalar|avx2|avx512|auto]\n\t-rng [parkmiller|philox]\n\t-backend [serial|pthreads|tbb|auto]\n\t-steps [time steps of the HJM grid]\n\t-cl_tune [search the OpenCL launch geometry again]\n\t-bermudan [exercisable on every swap payment date]\n\t-calibrate [curve history, writes the -factors file]\n\t-factors [factor file]\n\t-nf [number of factors to calibrate]\n\t-progressive [trials of the first round]\n\t-hugepages [small|thp|hugetlb]\n\t-maxmem [MB of shocks, OpenCL]\n\t-jobs [job file: swaption, priority, deadline in ms, release in ms]\n\t-slice [trials of a job between preemption points]\n"); 
 		exit(1);
 	}
 
@@ -168,21 +641,208 @@ int main(int argc, char *argv[])
 		if (!strcmp("-sm", argv[j])) {NUM_TRIALS = atoi(argv[++j]);}
 		else if (!strcmp("-nt", argv[j])) {nThreads = atoi(argv[++j]);} 
 		else if (!strcmp("-ns", argv[j])) {nSwaptions = atoi(argv[++j]);} 
+		else if (!strcmp("-scen", argv[j])) {
+			if (nScenarios > 0) free(scenarios);
+			nScenarios = HJM_Read_Scenarios(argv[++j], &scenarios);
+			if (nScenarios == 0) exit(1);
+		}
+		else if (!strcmp("-ladder", argv[j])) {dLadderBp = atof(argv[++j]); bLadder = 1;}
+		else if (!strcmp("-steps", argv[j])) {iN = atoi(argv[++j]);}
+		else if (!strcmp("-cl_tune", argv[j])) {bClTune = 1;}
+		else if (!strcmp("-maxmem", argv[j])) {lMaxMemMb = atol(argv[++j]);}
+		else if (!strcmp("-bermudan", argv[j])) {bBermudan = 1;}
+		else if (!strcmp("-progressive", argv[j])) {lFirstRound = atol(argv[++j]);}
+		else if (!strcmp("-jobs", argv[j])) {pszJobs = argv[++j];}
+		else if (!strcmp("-slice", argv[j])) {lSlice = atol(argv[++j]); bSlice = 1;}
+		else if (!strcmp("-calibrate", argv[j])) {pszCalibrate = argv[++j];}
+		else if (!strcmp("-factors", argv[j])) {pszFactors = argv[++j];}
+		else if (!strcmp("-nf", argv[j])) {iFactors = atoi(argv[++j]); bFactorCount = 1;}
+		else if (!strcmp("-affinity", argv[j])) {
+			iAffinity = HJM_Affinity_Parse(argv[++j]);
+			if (iAffinity < 0) {
+				fprintf(stderr,"Unknown affinity policy %s (none, compact or scatter)\n", argv[j]);
+				exit(1);
+			}
+		}
+		else if (!strcmp("-ckpt", argv[j])) {pszCkpt = argv[++j];}
+		else if (!strcmp("-ckpt_interval", argv[j])) {iCkptInterval = atoi(argv[++j]);}
+		else if (!strcmp("-resume", argv[j])) {bResume = 1;}
+		else if (!strcmp("-serve", argv[j])) {pszServe = argv[++j];}
+		else if (!strcmp("-batch_us", argv[j])) {iBatchWindowUs = atoi(argv[++j]);}
+		else if (!strcmp("-icdf", argv[j])) {
+			iIcdfAlg = icdf_parse_alg(argv[++j]);
+			if (iIcdfAlg < 0) {
+				fprintf(stderr,"Unknown inverse-normal algorithm %s (moro, acklam or as241)\n", argv[j]);
+				exit(1);
+			}
+		}
+		else if (!strcmp("-rng", argv[j])) {
+			int iRng = rng_parse(argv[++j]);
+			if (iRng < 0) {
+				fprintf(stderr,"Unknown random number generator %s (parkmiller or philox)\n", argv[j]);
+				exit(1);
+			}
+			rng_select(iRng);
+		}
+		else if (!strcmp("-backend", argv[j])) {
+			iBackend = hjm::backend_parse(argv[++j]);
+			if (iBackend == -1) {
+				fprintf(stderr,"Unknown backend %s (serial, pthreads, tbb or auto)\n", argv[j]);
+				exit(1);
+			}
+		}
+		else if (!strcmp("-hugepages", argv[j])) {
+			int iPages = nr_parse_pages(argv[++j]);
+			if (iPages < 0) {
+				fprintf(stderr,"Unknown page kind %s (small, thp or hugetlb)\n", argv[j]);
+				exit(1);
+			}
+			nr_select_pages(iPages);
+		}
+		else if (!strcmp("-isa", argv[j])) {
+			iIcdfIsa = icdf_parse_isa(argv[++j]);
+			if (iIcdfIsa < ICDF_AUTO) {
+				fprintf(stderr,"Unknown instruction set %s (scalar, avx2, avx512 or auto)\n", argv[j]);
+				exit(1);
+			}
+		}
 		else {
-			fprintf(stderr," usage: \n\t-ns [number of swaptions (should be > number of threads]\n\t-sm [number of simulations]\n\t-nt [number of threads]\n"); 
+			fprintf(stderr," usage: \n\t-ns [number of swaptions (should be > number of threads]\n\t-sm [number of simulations]\n\t-nt [number of threads]\n\t-scen [scenario file]\n\t-ladder [bump size in bp]\n\t-affinity [none|compact|scatter]\n\t-ckpt [checkpoint file]\n\t-ckpt_interval [seconds between checkpoints]\n\t-resume [continue from the -ckpt file]\n\t-serve [unix socket path]\n\t-batch_us [request batching window in us]\n\t-icdf [moro|acklam|as241]\n\t-isa [scalar|avx2|avx512|auto]\n\t-rng [parkmiller|philox]\n\t-backend [serial|pthreads|tbb|auto]\n\t-steps [time steps of the HJM grid]\n\t-cl_tune [search the OpenCL launch geometry again]\n\t-bermudan [exercisable on every swap payment date]\n\t-calibrate [curve history, writes the -factors file]\n\t-factors [factor file]\n\t-nf [number of factors to calibrate]\n\t-progressive [trials of the first round]\n\t-hugepages [small|thp|hugetlb]\n\t-maxmem [MB of shocks, OpenCL]\n\t-jobs [job file: swaption, priority, deadline in ms, release in ms]\n\t-slice [trials of a job between preemption points]\n"); 
+		}
+	}
+
+	if (iN < 3) {
+		fprintf(stderr,"-steps needs at least 3 time steps.\n");
+		exit(1);
+	}
+	// the book pays yearly from a 1y maturity (init_swaption)
+	if (fabs(iN/dYears - floor(iN/dYears + 0.5)) > 1e-9)
+		fprintf(stderr,"Warning: %d steps over %g years do not divide a year, swap dates are rounded to the grid.\n",
+				iN, dYears);
+	if (pszCalibrate && !pszFactors) {
+		fprintf(stderr,"-calibrate needs the -factors file to write.\n");
+		exit(1);
+	}
+	if (bFactorCount && !pszCalibrate) {
+		fprintf(stderr,"-nf only applies to -calibrate, a factor file has its own.\n");
+		exit(1);
+	}
+	// the ladder has a bucket per time step, so it waits for -steps
+	if (bLadder) {
+		if (nScenarios > 0) free(scenarios);
+		nScenarios = HJM_Ladder_Scenarios(iN, dLadderBp, &scenarios);
+	}
+	// -steps may follow -scen, so the buckets are checked against the final grid
+	for (int s = 0; s < nScenarios; s++)
+		if (scenarios[s].iBucket < -1 || scenarios[s].iBucket > iN-1) {
+			fprintf(stderr,"Scenario %s shifts bucket %d, the curve has buckets 0 to %d (-1 shifts all).\n",
+					scenarios[s].szName, scenarios[s].iBucket, iN-1);
+			exit(1);
 		}
+
+#if !(defined(USE_CPU) || defined(USE_GPU)) && !(defined(USE_MPI) || defined(USE_SNUCL))
+	bEngine = nScenarios == 0 && !pszCkpt && !pszServe && iAffinity == AFFINITY_NONE && !bBermudan && !pszJobs;
+#endif
+	if (iBackend != -1 && !bEngine) {
+		fprintf(stderr,"-backend cannot be combined with -scen, -ladder, -ckpt, -serve, -affinity, -bermudan or -jobs.\n");
+		exit(1);
 	}
+	if (iBackend == -1)
+		iBackend = hjm::backend_default();
 
-	if(nSwaptions < nThreads) {
+	// the pthreads engine splits the trials of each swaption instead, and
+	// auto may pick it; so does -bermudan
+	if(nSwaptions < nThreads && !bBermudan && !(bEngine && (iBackend == hjm::BACKEND_PTHREADS || iBackend == hjm::BACKEND_AUTO))) {
 		nSwaptions = nThreads; 
 	}
 
 	printf("Number of Simulations: %d,  Number of threads: %d Number of swaptions: %d\n", NUM_TRIALS, nThreads, nSwaptions);
+	if (rng_selected() != RNG_PARKMILLER)
+		printf("Random numbers: %s\n", rng_name[rng_selected()]);
+	if (iIcdfAlg != ICDF_MORO || iIcdfIsa != ICDF_SCALAR) {
+		int iIsa = icdf_select(iIcdfAlg, iIcdfIsa);
+		printf("Inverse normal: %s (%s)\n", icdf_alg_name[iIcdfAlg], icdf_isa_name[iIsa]);
+	}
+	if (nScenarios > 0)
+		printf("Number of scenarios: %d\n", nScenarios);
+	if (bBermudan)
+		printf("Exercise: bermudan (Longstaff-Schwartz)\n");
+	if (bEngine && iBackend != hjm::backend_default() && iBackend != hjm::BACKEND_AUTO)
+		printf("Backend: %s\n", hjm::backend_name[iBackend]);
+	if (pszJobs) {
+		int nJobs = HJM_Read_Jobs(pszJobs, nSwaptions, &jobs);
+		if (nJobs == 0)
+			exit(1);
+		printf("Jobs: %d from %s, preemptible every %ld trials\n", nJobs, pszJobs,
+				(lSlice + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE);
+	}
+
+#if (defined(USE_CPU) || defined(USE_GPU)) || (defined(USE_MPI) || defined(USE_SNUCL))
+	if (nScenarios > 0) {
+		fprintf(stderr,"Scenario mode is only supported by the serial, pthreads and tbb versions.\n");
+		exit(1);
+	}
+	if (pszCkpt) {
+		fprintf(stderr,"-ckpt is only supported by the serial, pthreads and tbb versions.\n");
+		exit(1);
+	}
+	if (pszServe) {
+		fprintf(stderr,"-serve is only supported by the serial, pthreads and tbb versions.\n");
+		exit(1);
+	}
+	if (bBermudan) {
+		fprintf(stderr,"-bermudan is only supported by the serial, pthreads and tbb versions.\n");
+		exit(1);
+	}
+	if (lFirstRound) {
+		fprintf(stderr,"-progressive is only supported by the serial, pthreads and tbb versions.\n");
+		exit(1);
+	}
+	if (pszJobs) {
+		fprintf(stderr,"-jobs is only supported by the serial, pthreads and tbb versions.\n");
+		exit(1);
+	}
+#else
+	if (bClTune) {
+		fprintf(stderr,"-cl_tune is only supported by the OpenCL versions.\n");
+		exit(1);
+	}
+	if (lMaxMemMb) {
+		fprintf(stderr,"-maxmem is only supported by the OpenCL versions, the others keep a block of shocks per worker.\n");
+		exit(1);
+	}
+#endif
+	if (pszCkpt && nScenarios > 0) {
+		fprintf(stderr,"-ckpt cannot be combined with scenario mode.\n");
+		exit(1);
+	}
+	if (bBermudan && (nScenarios > 0 || pszCkpt || pszServe || iAffinity != AFFINITY_NONE)) {
+		fprintf(stderr,"-bermudan cannot be combined with -scen, -ladder, -ckpt, -serve or -affinity.\n");
+		exit(1);
+	}
+	if (lFirstRound < 0 || (lFirstRound > 0 && !bEngine)) {
+		fprintf(stderr,"-progressive needs a positive first round and cannot be combined with -scen, -ladder, -ckpt, -serve, -affinity, -bermudan or -jobs.\n");
+		exit(1);
+	}
+	if (pszJobs && (nScenarios > 0 || pszServe || iAffinity != AFFINITY_NONE || bBermudan)) {
+		fprintf(stderr,"-jobs cannot be combined with -scen, -ladder, -serve, -affinity or -bermudan.\n");
+		exit(1);
+	}
+	if (bSlice && (!pszJobs || lSlice < 1)) {
+		fprintf(stderr,"-slice needs -jobs and at least one trial.\n");
+		exit(1);
+	}
+	if (bResume && !pszCkpt) {
+		fprintf(stderr,"-resume needs the -ckpt file to resume from.\n");
+		exit(1);
+	}
+	if (iCkptInterval < 1)
+		iCkptInterval = 1;
 
 #ifdef ENABLE_THREADS
 
 #ifdef TBB_VERSION
-	tbb::task_scheduler_init init(nThreads);
+	HJM_TBB_INIT(nThreads);
 #else
 	pthread_t      *threads;
 	pthread_attr_t  pthread_custom_attr;
@@ -195,6 +855,9 @@ int main(int argc, char *argv[])
 	threads = (pthread_t *) malloc(nThreads * sizeof(pthread_t));
 	pthread_attr_init(&pthread_custom_attr);
 
+	if (iAffinity != AFFINITY_NONE)
+		printf("Affinity: %s over %d cpus\n", iAffinity == AFFINITY_COMPACT ? "compact" : "scatter", HJM_Affinity_Init());
+
 #endif // TBB_VERSION
 
 	if ((nThreads < 1) || (nThreads > MAX_THREAD))
@@ -204,81 +867,123 @@ int main(int argc, char *argv[])
 	}
 
 #else
-	if (nThreads != 1)
+	if (nThreads != 1 && !bEngine && !bBermudan && !pszCalibrate)
 	{
 		fprintf(stderr,"Number of threads must be 1 (serial version)\n");
 		exit(1);
 	}
 #endif //ENABLE_THREADS
 
+#if !defined(ENABLE_THREADS) || defined(TBB_VERSION)
+	if (iAffinity != AFFINITY_NONE) {
+		fprintf(stderr,"-affinity is only supported by the pthreads version.\n");
+		exit(1);
+	}
+#endif
+
+	// -calibrate: the factors come from the curve history, nothing is priced
+	if (pszCalibrate)
+		return HJM_Calibrate(pszCalibrate, pszFactors, iN, dYears, iFactors, nThreads) ? 0 : 1;
+
 	// initialize input dataset
-	factors = dmatrix(0, iFactors-1, 0, iN-2);
-	//the three rows store vol data for the three factors
-	factors[0][0]= .01;
-	factors[0][1]= .01;
-	factors[0][2]= .01;
-	factors[0][3]= .01;
-	factors[0][4]= .01;
-	factors[0][5]= .01;
-	factors[0][6]= .01;
-	factors[0][7]= .01;
-	factors[0][8]= .01;
-	factors[0][9]= .01;
-
-	factors[1][0]= .009048;
-	factors[1][1]= .008187;
-	factors[1][2]= .007408;
-	factors[1][3]= .006703;
-	factors[1][4]= .006065;
-	factors[1][5]= .005488;
-	factors[1][6]= .004966;
-	factors[1][7]= .004493;
-	factors[1][8]= .004066;
-	factors[1][9]= .003679;
-
-	factors[2][0]= .001000;
-	factors[2][1]= .000750;
-	factors[2][2]= .000500;
-	factors[2][3]= .000250;
-	factors[2][4]= .000000;
-	factors[2][5]= -.000250;
-	factors[2][6]= -.000500;
-	factors[2][7]= -.000750;
-	factors[2][8]= -.001000;
-	factors[2][9]= -.001250;
+	if (pszFactors) {
+		iFactors = HJM_Read_Factors(pszFactors, iN, dYears, &factors);
+		if (iFactors == 0)
+			exit(1);
+		printf("Factors: %d from %s\n", iFactors, pszFactors);
+	} else if (iN == 11) {
+		factors = dmatrix(0, iFactors-1, 0, iN-2);
+		//the three rows store vol data for the three factors
+		factors[0][0]= .01;
+		factors[0][1]= .01;
+		factors[0][2]= .01;
+		factors[0][3]= .01;
+		factors[0][4]= .01;
+		factors[0][5]= .01;
+		factors[0][6]= .01;
+		factors[0][7]= .01;
+		factors[0][8]= .01;
+		factors[0][9]= .01;
+
+		factors[1][0]= .009048;
+		factors[1][1]= .008187;
+		factors[1][2]= .007408;
+		factors[1][3]= .006703;
+		factors[1][4]= .006065;
+		factors[1][5]= .005488;
+		factors[1][6]= .004966;
+		factors[1][7]= .004493;
+		factors[1][8]= .004066;
+		factors[1][9]= .003679;
+
+		factors[2][0]= .001000;
+		factors[2][1]= .000750;
+		factors[2][2]= .000500;
+		factors[2][3]= .000250;
+		factors[2][4]= .000000;
+		factors[2][5]= -.000250;
+		factors[2][6]= -.000500;
+		factors[2][7]= -.000750;
+		factors[2][8]= -.001000;
+		factors[2][9]= -.001250;
+	} else {
+		// -steps: the same term structures on another grid, as functions of
+		// the time to maturity of the forward (the table above rounds them)
+		factors = dmatrix(0, iFactors-1, 0, iN-2);
+		for (j = 0; j <= iN-2; ++j) {
+			FTYPE dT = j*(dYears/iN);
+			factors[0][j] = .01;
+			factors[1][j] = .01*exp(-.2*(dT + dYears/iN));
+			factors[2][j] = .001 - .0005*dT;
+		}
+	}
+
+	// service mode: the pool and the curve/factor set stay up between requests
+	if (pszServe) {
+		FTYPE *pdYield = dvector(0, iN-1);
+		pdYield[0] = .1;
+		for (j = 1; j <= iN-1; ++j)
+			pdYield[j] = pdYield[j-1]+yield_step();
+		iSuccess = HJM_Serve(pszServe, nThreads, iN, iFactors, dYears, pdYield, factors, NUM_TRIALS, iBatchWindowUs) ? 0 : 1;
+		free_dvector(pdYield, 0, iN-1);
+		free_dmatrix(factors, 0, iFactors-1, 0, iN-2);
+		return iSuccess;
+	}
 
 	// setting up multiple swaptions
 	swaptions = 
 #ifdef TBB_VERSION
-		(parm *)memory_parm.allocate(sizeof(parm)*nSwaptions, NULL);
+		(parm *)memory_parm.allocate(sizeof(parm)*nSwaptions);
 #else
 	(parm *)malloc(sizeof(parm)*nSwaptions);
 #endif
 
-	int k;
-	for (i = 0; i < nSwaptions; i++) {
-		swaptions[i].Id = i;
-		swaptions[i].iN = iN;
-		swaptions[i].iFactors = iFactors;
-		swaptions[i].dYears = dYears;
-
-		swaptions[i].dStrike =  (double)i / (double)nSwaptions; 
-		swaptions[i].dCompounding =  0;
-		swaptions[i].dMaturity =  1;
-		swaptions[i].dTenor =  2.0;
-		swaptions[i].dPaymentInterval =  1.0;
-
-		swaptions[i].pdYield = dvector(0,iN-1);;
-		swaptions[i].pdYield[0] = .1;
-		for(j=1;j<=swaptions[i].iN-1;++j)
-			swaptions[i].pdYield[j] = swaptions[i].pdYield[j-1]+.005;
-
-		swaptions[i].ppdFactors = dmatrix(0, swaptions[i].iFactors-1, 0, swaptions[i].iN-2);
-		for(k=0;k<=swaptions[i].iFactors-1;++k)
-			for(j=0;j<=swaptions[i].iN-2;++j)
-				swaptions[i].ppdFactors[k][j] = factors[k][j];
+#if !(defined(USE_CPU) || defined(USE_GPU)) && !(defined(USE_MPI) || defined(USE_SNUCL))
+	bLazyBook = !bEngine && !bBermudan;
+#endif
+	if (!bLazyBook)
+		init_book();
+
+	if (nScenarios > 0)
+		pdScenPrice = (FTYPE *)malloc(sizeof(FTYPE)*2*nScenarios*nSwaptions);
+
+	if (pszCkpt) {
+		states = (swaption_state *)calloc(nSwaptions, sizeof(swaption_state));
+		if (bResume) {
+			int nDone = HJM_Ckpt_Load(pszCkpt, states, nSwaptions, iN, iFactors, NUM_TRIALS, BLOCK_SIZE);
+			if (nDone < 0)
+				exit(1);
+			printf("Resuming from %s: %d of %d swaptions finished\n", pszCkpt, nDone, nSwaptions);
+		}
+		if (!HJM_Ckpt_Start(pszCkpt, states, nSwaptions, iN, iFactors, NUM_TRIALS, BLOCK_SIZE, iCkptInterval))
+			exit(1);
 	}
 
+	if (bEngine && iBackend == hjm::BACKEND_AUTO)
+		calibrate_backend();
+	if (bEngine && iBackend == hjm::BACKEND_PTHREADS && nSwaptions < nThreads)
+		printf("Trials of each swaption split over %d workers\n", (nThreads + nSwaptions - 1) / nSwaptions);
+
 #ifdef DEBUG
 	clock_gettime(CLOCK_MONOTONIC, &start);
 #endif
@@ -417,11 +1122,15 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	// Create programs
+	// Create and build programs, through the binary cache (cl_cache.h)
 	FILE *fp;
 	char *fileName[KCNT];
 	char *src_str;
 	size_t src_size;
+	string build_str;
+	char *build_options;
+	int cache_hit, cache_hits = 0;
+	struct timespec build_start, build_end, build_spent;
 
 	for (i = 0; i < KCNT; i++) {
 		fileName[i] = (char*)malloc(sizeof(char) * 100);
@@ -432,6 +1141,11 @@ int main(int argc, char *argv[])
 	strcpy(fileName[1], "./sim.cl");
 	//
 
+#ifdef DEBUG
+	printf("[ Kernel Build Options ]\n\n");
+#endif
+
+	clock_gettime(CLOCK_MONOTONIC, &build_start);
 	for (i = 0; i < KCNT; i++) {
 		fp = fopen(fileName[i], "r");
 		if (!fp) {
@@ -441,34 +1155,19 @@ int main(int argc, char *argv[])
 		src_str = (char*)malloc(MAX_SOURCE_SIZE);
 		src_size = fread(src_str, 1, MAX_SOURCE_SIZE, fp);
 
-		programs[i] = clCreateProgramWithSource(context, 1, (const char **)&src_str, (const size_t *)&src_size, &err);
-
-		if (err != CL_SUCCESS) {
-			printf("Error: failed to create program %d. %d\n", i, err);
-			return EXIT_FAILURE;
-		}
-
-		fclose(fp);
-		free(src_str);
-		free(fileName[i]);
-	}
-
-	// Build programs
-	string build_str;
-	char *build_options;
-
-#ifdef DEBUG
-	printf("[ Kernel Build Options ]\n\n");
-#endif
-
-	for (i = 0; i < KCNT; i++) {
 		// Set build options (KERNEL)
 		build_str = "-DFTYPE=double";
+		if (i == 0) {
+			// RanGen: inverse-normal algorithm (-icdf) and generator (-rng)
+			char szAlg[64];
+			sprintf(szAlg, " -DICDF_ALG=%d -DRNG_ALG=%d -DRNG_BLOCK=%d", iIcdfAlg, rng_selected(), BLOCK_SIZE);
+			build_str += szAlg;
+		}
 		build_options = const_cast<char*>(build_str.c_str());
 #ifdef DEBUG
 		printf("Kernel %d: %s\n", i, build_options);
 #endif
-		err = clBuildProgram(programs[i], 0, NULL, build_options, NULL, NULL);
+		err = clCacheBuildProgram(context, dev_cnt, device_ids, src_str, src_size, build_options, &programs[i], &cache_hit);
 
 		if (err != CL_SUCCESS) {
 			printf("Error: failed to build program %d. %d\n", i, err);
@@ -479,7 +1178,19 @@ int main(int argc, char *argv[])
 			printf("%s\n", log);
 			return EXIT_FAILURE;
 		}
+		cache_hits += cache_hit;
+
+		fclose(fp);
+		free(src_str);
+		free(fileName[i]);
 	}
+	clock_gettime(CLOCK_MONOTONIC, &build_end);
+	timespec_subtract(&build_spent, &build_end, &build_start);
+#ifdef USE_MPI
+	if (comm_rank == 0)
+#endif
+		printf("Kernel build: %ld.%09ld s (%s start, %d of %d programs from cache)\n",
+				build_spent.tv_sec, build_spent.tv_nsec, cache_hits == KCNT ? "warm" : "cold", cache_hits, KCNT);
 
 #ifdef DEBUG
 	printf("\n");
@@ -502,9 +1213,6 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	// Set work size
-	size_t globalWorkSize = GLOBAL_WORK_SIZE;
-
 #ifdef USE_MPI
 	// Calculate # of swaptions per node
 	int swp_node;
@@ -564,7 +1272,7 @@ int main(int argc, char *argv[])
 	FTYPE *pdForward = (FTYPE*) malloc(sizeof(FTYPE) * iN * nSwaptions);
 	FTYPE *pdTotalDrift = (FTYPE*) malloc(sizeof(FTYPE) * (iN-1) * nSwaptions);
 	FTYPE **ppdDrifts; // Temporary so can be kept a matrix
-	int l;
+	int k, l;
 	FTYPE dSumVol;
 
 #ifdef USE_MPI
@@ -618,6 +1326,45 @@ int main(int argc, char *argv[])
 	}
 #endif
 
+	// Convert ppdFactors into vectors
+	// (use swaption 0's, because they are same across all swaptions)
+	FTYPE *gppdFactors = (FTYPE*) malloc(sizeof(FTYPE) * iFactors * (iN-1));
+
+	for (i = 0; i < iFactors; i++) {
+		for (j = 0; j < iN-1; j++) {
+			gppdFactors[(iN-1) * i + j] = swaptions[0].ppdFactors[i][j];
+		}
+	}
+
+	// ***** Launch geometry *****
+
+	// cached for device 0 and used on every device; the best geometry
+	// depends on the work per path, hence the key
+	cl_geometry geom = { GLOBAL_WORK_SIZE, LOCAL_WORK_SIZE1, LOCAL_WORK_SIZE2, BLOCK_SIZE };
+	const int nGeom = sizeof(geom) / sizeof(int);
+	const char *pszGeom = "default";
+	char szTuneKey[128];
+
+	snprintf(szTuneKey, sizeof(szTuneKey), "swaptions iN=%d factors=%d icdf=%d rng=%d",
+			iN, iFactors, iIcdfAlg, rng_selected());
+	if (!bClTune && clCacheLoadTuning(device_ids[0], szTuneKey, (int*)&geom, nGeom)) {
+		pszGeom = "cached";
+	} else if (bClTune || clCacheEnabled()) {
+		cl_sim_args args = { ddelt, sqrt_ddelt, dSwapVectorYears, iSwapVectorLength, iSwapStartTimeIndex,
+			pdForward, pdTotalDrift, gppdFactors, pdSwapPayoffs };
+		if (cl_tune_geometry(context, device_ids[0], commands[0], kernels, &args, &geom) > 0) {
+			pszGeom = "tuned";
+			clCacheSaveTuning(device_ids[0], szTuneKey, (int*)&geom, nGeom);
+		}
+	}
+#ifdef USE_MPI
+	if (comm_rank == 0)
+#endif
+		printf("OpenCL geometry: global %d, local %d/%d, block %d (%s)\n",
+				geom.iGlobal, geom.iLocal1, geom.iLocal2, geom.iBlock, pszGeom);
+
+	size_t globalWorkSize = geom.iGlobal;
+
 	// ***** Calculate some constants *****
 
 	// Calculate # of swaptions per device
@@ -637,95 +1384,75 @@ int main(int argc, char *argv[])
 			swp_dev[i] = tmp_cnt;
 	}
 
-	// Calculate # of simulation iterations per work item
-	unsigned int *iter_wi = (unsigned int*) malloc(sizeof(unsigned int) * GLOBAL_WORK_SIZE);
-	unsigned int iter_tot = ceil((double)NUM_TRIALS / (double)BLOCK_SIZE);
-	leftover = iter_tot % GLOBAL_WORK_SIZE;
-	tmp_cnt = floor((double)iter_tot / (double)GLOBAL_WORK_SIZE);
-
-	for (i = 0; i < GLOBAL_WORK_SIZE; i++) {
-		if (i < leftover)
-			iter_wi[i] = tmp_cnt + 1;
-		else
-			iter_wi[i] = tmp_cnt;
+	// ***** Chunks *****
+
+	// The paths are simulated in chunks of whole blocks: a chunk's shocks are
+	// generated, copied to every device and simulated for every swaption
+	// before the next chunk reuses the buffers, and the per-work-item sums
+	// of the chunks add up in acc_*. The shocks of a chunk live on the host
+	// (pdZ), in each device's swaption_RanGen output (its share) and in each
+	// device's copy for swaption_sim; -maxmem caps the three together. One
+	// chunk without it.
+	unsigned int iter_tot = ceil((double)NUM_TRIALS / (double)geom.iBlock);
+	unsigned int zPerBlock = iFactors * (iN-1) * geom.iBlock;	// shocks swaption_sim reads per block
+	unsigned int iter_chunk = iter_tot;
+
+	if (lMaxMemMb > 0) {
+		double dBlocks = lMaxMemMb * 1048576.0 / (sizeof(FTYPE) * zPerBlock * (2.0 + dev_cnt));
+		if (dBlocks < iter_tot)
+			iter_chunk = dBlocks < 1 ? 1 : (unsigned int)dBlocks;
 	}
+	unsigned int nChunks = (iter_tot + iter_chunk - 1) / iter_chunk;
+#ifdef USE_MPI
+	if (comm_rank == 0)
+#endif
+		if (lMaxMemMb > 0) {
+			printf("Memory budget: %ld MB, %u chunks of %u blocks (%.0f MB of shocks)\n", lMaxMemMb, nChunks,
+					iter_chunk, sizeof(FTYPE) * (double)zPerBlock * iter_chunk * (2.0 + dev_cnt) / 1048576.0);
+			if (iter_chunk < (unsigned int)geom.iGlobal)
+				fprintf(stderr,"Warning: %u blocks a chunk leave some of the %d work-items idle.\n",
+						iter_chunk, geom.iGlobal);
+		}
 
-	// Calculate simulation iteration indices per work item
-	unsigned int *iter_wi_sti = (unsigned int*) malloc(sizeof(unsigned int) * GLOBAL_WORK_SIZE);
-	unsigned int *iter_wi_edi = (unsigned int*) malloc(sizeof(unsigned int) * GLOBAL_WORK_SIZE);
-
-	unsigned int stIndex1 = 0;
-	for (i = 0; i < GLOBAL_WORK_SIZE; i++) {
-		iter_wi_sti[i] = stIndex1;
-		stIndex1 += iter_wi[i];
-		iter_wi_edi[i] = stIndex1 - 1;
-	}
+	// Simulation iterations (blocks) of a chunk per work item
+	unsigned int *iter_wi_sti = (unsigned int*) malloc(sizeof(unsigned int) * geom.iGlobal);
+	unsigned int *iter_wi_edi = (unsigned int*) malloc(sizeof(unsigned int) * geom.iGlobal);
 
 	// For generating random numbers
-	// (same across all swaptions)
+	// (same across all swaptions; a shock depends only on lRndSeed and its
+	// index in the whole run, so the chunking does not change it)
 	long lRndSeed = 100;
-	unsigned int ranCnt = iFactors * iN * BLOCK_SIZE * iter_tot;
-	FTYPE *pdZ = (FTYPE*) calloc(ranCnt, sizeof(FTYPE));
-	
-	// Calculate # of random numbers per device
-	unsigned int *ran_dev = (unsigned int*) malloc(sizeof(unsigned int) * dev_cnt);
-	leftover = ranCnt % dev_cnt;
-	tmp_cnt = floor((double)ranCnt / (double)dev_cnt);
-
-	for (i = 0; i < dev_cnt; i++) {
-		if (i < leftover)
-			ran_dev[i] = tmp_cnt + 1;
-		else
-			ran_dev[i] = tmp_cnt;
-	}
+	unsigned int ranCnt = zPerBlock * iter_chunk;
+	// several GB at large -sm without -maxmem: on huge pages with -hugepages (nr_routines.h)
+	FTYPE *pdZ = dvector(0, ranCnt-1);
+	memset(pdZ, 0, sizeof(FTYPE) * ranCnt);
 
-	// Calculate # of random numbers per work-item
-	unsigned int *ran_wi = (unsigned int*) malloc(sizeof(unsigned int) * GLOBAL_WORK_SIZE * dev_cnt);
-	for (i = 0; i < dev_cnt; i++) {
-		leftover = ran_dev[i] % GLOBAL_WORK_SIZE;
-		tmp_cnt = floor((double)ran_dev[i] / (double)GLOBAL_WORK_SIZE);
-
-		for (j = 0; j < GLOBAL_WORK_SIZE; j++) {
-			if (j < leftover)
-				ran_wi[GLOBAL_WORK_SIZE * i + j] = tmp_cnt + 1;
-			else
-				ran_wi[GLOBAL_WORK_SIZE * i + j] = tmp_cnt;
-		}
-	}
-
-	// Calculate start & end index of pdZ per work-item
-	unsigned int *ran_wi_sti = (unsigned int*) malloc(sizeof(unsigned int) * dev_cnt * GLOBAL_WORK_SIZE);
-	unsigned int *ran_wi_edi = (unsigned int*) malloc(sizeof(unsigned int) * dev_cnt * GLOBAL_WORK_SIZE);
+	// # of random numbers of a chunk per device, and the start of each
+	// device's share in the chunk
+	unsigned int *ran_dev = (unsigned int*) malloc(sizeof(unsigned int) * dev_cnt);
+	unsigned int *ran_dev_ofs = (unsigned int*) malloc(sizeof(unsigned int) * dev_cnt);
 
-	stIndex1 = 0;
-	unsigned int stIndex2;
-	for (i = 0; i < dev_cnt; i++) {
-		stIndex2 = stIndex1;
-		for (j = 0; j < GLOBAL_WORK_SIZE; j++) {
-			ran_wi_sti[GLOBAL_WORK_SIZE * i + j] = stIndex2;
-			stIndex2 += ran_wi[GLOBAL_WORK_SIZE * i + j];
-			ran_wi_edi[GLOBAL_WORK_SIZE * i + j] = stIndex2 - 1;
-		}
-		stIndex1 += ran_dev[i];
-	}
+	// Start & end index per work-item in its device's share
+	unsigned int *ran_wi_sti = (unsigned int*) malloc(sizeof(unsigned int) * dev_cnt * geom.iGlobal);
+	unsigned int *ran_wi_edi = (unsigned int*) malloc(sizeof(unsigned int) * dev_cnt * geom.iGlobal);
 
-	// ***** RanUnif & CumNormalInv *****
+	// ***** Device memory *****
 
-	// Prepare memory
 	cl_mem cl_pdZ[dev_cnt];
 	cl_mem cl_sti[dev_cnt];
 	cl_mem cl_edi[dev_cnt];
 
-	size_t localWorkSize1 = LOCAL_WORK_SIZE1;
+	size_t localWorkSize1 = geom.iLocal1;
+	unsigned int ranShare = ranCnt / dev_cnt + (ranCnt % dev_cnt ? 1 : 0);
 
 	for (i = 0; i < dev_cnt; i++) {
-		cl_pdZ[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * ranCnt, NULL, &err);
+		cl_pdZ[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * ranShare, NULL, &err);
 #ifdef USE_CPU
-		cl_sti[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(unsigned int) * dev_cnt * GLOBAL_WORK_SIZE, ran_wi_sti, &err);
-		cl_edi[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(unsigned int) * dev_cnt * GLOBAL_WORK_SIZE, ran_wi_edi, &err);
+		cl_sti[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(unsigned int) * dev_cnt * geom.iGlobal, ran_wi_sti, &err);
+		cl_edi[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(unsigned int) * dev_cnt * geom.iGlobal, ran_wi_edi, &err);
 #else
-		cl_sti[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(unsigned int) * dev_cnt * GLOBAL_WORK_SIZE, ran_wi_sti, &err);
-		cl_edi[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(unsigned int) * dev_cnt * GLOBAL_WORK_SIZE, ran_wi_edi, &err);
+		cl_sti[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(unsigned int) * dev_cnt * geom.iGlobal, NULL, &err);
+		cl_edi[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(unsigned int) * dev_cnt * geom.iGlobal, NULL, &err);
 #endif
 	}
 
@@ -734,70 +1461,14 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
-	// Random number generation with all OpenCL devices
-	unsigned int buf_ofs = 0; // Offset in buffer
-	unsigned int host_ofs = 0; // Offset in host memory
-	for (i = 0; i < dev_cnt; i++) {
-		// Set kernel arguments
-		err = clSetKernelArg(kernels[0], 0, sizeof(int), (void*) &globalWorkSize);
-		err |= clSetKernelArg(kernels[0], 1, sizeof(int), (void*) &i);
-		err |= clSetKernelArg(kernels[0], 2, sizeof(long), (void*) &lRndSeed);
-		err |= clSetKernelArg(kernels[0], 3, sizeof(cl_mem), (void*) &cl_pdZ[i]);
-		err |= clSetKernelArg(kernels[0], 4, sizeof(cl_mem), (void*) &cl_sti[i]);
-		err |= clSetKernelArg(kernels[0], 5, sizeof(cl_mem), (void*) &cl_edi[i]);
-
-		if (err != CL_SUCCESS) {
-			printf("Error: failed to set kernel arguments. %d\n", err);
-			return EXIT_FAILURE;
-		}
-
-		// Enqueue kernel
-		err = clEnqueueNDRangeKernel(commands[i], kernels[0], 1, NULL, &globalWorkSize, &localWorkSize1, 0, NULL, NULL);
-
-		if (err != CL_SUCCESS) {
-			printf("Error: failed to enqueue kernel. %d\n", err);
-			return EXIT_FAILURE;
-		}
-
-		// Read pdZ back to host memory
-		err = clEnqueueReadBuffer(commands[i], cl_pdZ[i], CL_FALSE, (size_t) buf_ofs, (size_t) (ran_dev[i] * sizeof(FTYPE)), pdZ + host_ofs, 0, NULL, NULL);
-
-		if (err != CL_SUCCESS) {
-			printf("Error: failed to read buffer. %d\n", err);
-			return EXIT_FAILURE;
-		}
-
-		buf_ofs += ran_dev[i] * sizeof(FTYPE);
-		host_ofs += ran_dev[i];
-	}
-
-	// Ensure kernel completion
-	for (i = 0; i < dev_cnt; i++) {
-		clFinish(commands[i]);
-	}
-
-	// ***** Simulation *****
-	
-	// Convert ppdFactors into vectors
-	// (use swaption 0's, because they are same across all swaptions)
-	FTYPE *gppdFactors = (FTYPE*) malloc(sizeof(FTYPE) * iFactors * (iN-1));
-
-	for (i = 0; i < iFactors; i++) {
-		for (j = 0; j < iN-1; j++) {
-			gppdFactors[(iN-1) * i + j] = swaptions[0].ppdFactors[i][j];
-		}
-	}
-
-	FTYPE *acc_dSumSimSwaptionPrice = (FTYPE*) calloc(GLOBAL_WORK_SIZE * nSwaptions, sizeof(FTYPE));
-	FTYPE *acc_dSumSquareSimSwaptionPrice = (FTYPE*) calloc(GLOBAL_WORK_SIZE * nSwaptions, sizeof(FTYPE));
+	FTYPE *acc_dSumSimSwaptionPrice = (FTYPE*) calloc(geom.iGlobal * nSwaptions, sizeof(FTYPE));
+	FTYPE *acc_dSumSquareSimSwaptionPrice = (FTYPE*) calloc(geom.iGlobal * nSwaptions, sizeof(FTYPE));
+	// sums of the current chunk
+	FTYPE *chk_dSumSimSwaptionPrice = (FTYPE*) calloc(geom.iGlobal * nSwaptions, sizeof(FTYPE));
+	FTYPE *chk_dSumSquareSimSwaptionPrice = (FTYPE*) calloc(geom.iGlobal * nSwaptions, sizeof(FTYPE));
 	
 	// Device memory objects
-	cl_mem cl_ppdHJMPath[nSwaptions];
-	cl_mem cl_pdDiscountingRatePath[nSwaptions];
-	cl_mem cl_pdPayoffDiscountFactors[nSwaptions];
-	cl_mem cl_pdexpRes[nSwaptions];
-	cl_mem cl_pdSwapRatePath[nSwaptions];
-	cl_mem cl_pdSwapDiscountFactors[nSwaptions];
+	cl_mem cl_pdRows[nSwaptions];
 
 	cl_mem cl_pdForward[nSwaptions];
 	cl_mem cl_pdTotalDrift[nSwaptions];
@@ -813,20 +1484,20 @@ int main(int argc, char *argv[])
 	// Create buffers (common across all swaptions)
 	for (i = 0; i < dev_cnt; i++) {
 #ifdef USE_CPU
-		cl_ppdFactors[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * iFactors * (iN-1), gppdFactors, &err);
+		cl_ppdFactors[i] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * iFactors * (iN-1), gppdFactors, &err);
 		cl_gpdZ[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * ranCnt, pdZ, &err);
-		cl_iter_wi_sti[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(unsigned int) * GLOBAL_WORK_SIZE, iter_wi_sti, &err);
-		cl_iter_wi_edi[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(unsigned int) * GLOBAL_WORK_SIZE, iter_wi_edi, &err);
+		cl_iter_wi_sti[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(unsigned int) * geom.iGlobal, iter_wi_sti, &err);
+		cl_iter_wi_edi[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(unsigned int) * geom.iGlobal, iter_wi_edi, &err);
 #elif defined(USE_SNUCL)
-		cl_ppdFactors[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * iFactors * (iN-1), NULL, &err);
+		cl_ppdFactors[i] = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(FTYPE) * iFactors * (iN-1), NULL, &err);
 		cl_gpdZ[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * ranCnt, NULL, &err);
-		cl_iter_wi_sti[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(unsigned int) * GLOBAL_WORK_SIZE, NULL, &err);
-		cl_iter_wi_edi[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(unsigned int) * GLOBAL_WORK_SIZE, NULL, &err);
+		cl_iter_wi_sti[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(unsigned int) * geom.iGlobal, NULL, &err);
+		cl_iter_wi_edi[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(unsigned int) * geom.iGlobal, NULL, &err);
 #else
-		cl_ppdFactors[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * iFactors * (iN-1), gppdFactors, &err);
-		cl_gpdZ[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * ranCnt, pdZ, &err);
-		cl_iter_wi_sti[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(unsigned int) * GLOBAL_WORK_SIZE, iter_wi_sti, &err);
-		cl_iter_wi_edi[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(unsigned int) * GLOBAL_WORK_SIZE, iter_wi_edi, &err);
+		cl_ppdFactors[i] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * iFactors * (iN-1), gppdFactors, &err);
+		cl_gpdZ[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * ranCnt, NULL, &err);
+		cl_iter_wi_sti[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(unsigned int) * geom.iGlobal, NULL, &err);
+		cl_iter_wi_edi[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(unsigned int) * geom.iGlobal, NULL, &err);
 #endif
 
 		if (err != CL_SUCCESS) {
@@ -839,9 +1510,6 @@ int main(int argc, char *argv[])
 	// Explicitly write buffers
 	for (i = 0; i < dev_cnt; i++) {
 	err = clEnqueueWriteBuffer(commands[i], cl_ppdFactors[i], CL_FALSE, 0, sizeof(FTYPE) * iFactors * (iN-1), gppdFactors, 0, NULL, NULL);
-	err |= clEnqueueWriteBuffer(commands[i], cl_gpdZ[i], CL_FALSE, 0, sizeof(FTYPE) * ranCnt, pdZ, 0, NULL, NULL);
-	err |= clEnqueueWriteBuffer(commands[i], cl_iter_wi_sti[i], CL_FALSE, 0, sizeof(unsigned int) * GLOBAL_WORK_SIZE, iter_wi_sti, 0, NULL, NULL);
-	err |= clEnqueueWriteBuffer(commands[i], cl_iter_wi_edi[i], CL_FALSE, 0, sizeof(unsigned int) * GLOBAL_WORK_SIZE, iter_wi_edi, 0, NULL, NULL);
 	
 	if (err != CL_SUCCESS) {
 		printf("Error: failed to write buffer. %d\n", err);
@@ -854,44 +1522,38 @@ int main(int argc, char *argv[])
 	}
 #endif
 
-	// Enqueue kernels for each swaption
-	int blk_size = BLOCK_SIZE;
+	// Create buffers (unique per swaption)
+	int blk_size = geom.iBlock;
 	int swp_cnt;
 #ifdef USE_MPI
 	int cur_swp = swp_node_sti;
 #else
 	int cur_swp = 0;
 #endif
-	size_t localWorkSize2 = LOCAL_WORK_SIZE2;
+	size_t localWorkSize2 = geom.iLocal2;
 
 	for (i = 0; i < dev_cnt; i++) {
 		for (swp_cnt = 0; swp_cnt < swp_dev[i]; swp_cnt++) {
 
-			// Create buffers (unique per swaption)
-			cl_ppdHJMPath[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * iN * iN * BLOCK_SIZE * GLOBAL_WORK_SIZE, NULL, &err);
-			cl_pdDiscountingRatePath[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * iN * BLOCK_SIZE * GLOBAL_WORK_SIZE, NULL, &err);
-			cl_pdPayoffDiscountFactors[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * iN * BLOCK_SIZE * GLOBAL_WORK_SIZE, NULL, &err);
-			cl_pdexpRes[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * (iN-1) * BLOCK_SIZE * GLOBAL_WORK_SIZE, NULL, &err);
-			cl_pdSwapRatePath[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * iSwapVectorLength * BLOCK_SIZE * GLOBAL_WORK_SIZE, NULL, &err);
-			cl_pdSwapDiscountFactors[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * iSwapVectorLength * BLOCK_SIZE * GLOBAL_WORK_SIZE, NULL, &err);
+			cl_pdRows[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * 2 * iN * geom.iGlobal, NULL, &err);
 #ifdef USE_CPU
-			cl_pdForward[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * iN, pdForward + iN * cur_swp, &err);
-			cl_pdTotalDrift[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * (iN-1), pdTotalDrift + (iN-1) * cur_swp, &err);
-			cl_pdSwapPayoffs[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * iSwapVectorLength, pdSwapPayoffs + iSwapVectorLength * cur_swp, &err);
-			cl_dSumSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * GLOBAL_WORK_SIZE, acc_dSumSimSwaptionPrice + GLOBAL_WORK_SIZE * cur_swp, &err);
-			cl_dSumSquareSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * GLOBAL_WORK_SIZE, acc_dSumSquareSimSwaptionPrice + GLOBAL_WORK_SIZE * cur_swp, &err);
+			cl_pdForward[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * iN, pdForward + iN * cur_swp, &err);
+			cl_pdTotalDrift[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * (iN-1), pdTotalDrift + (iN-1) * cur_swp, &err);
+			cl_pdSwapPayoffs[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * iSwapVectorLength, pdSwapPayoffs + iSwapVectorLength * cur_swp, &err);
+			cl_dSumSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * geom.iGlobal, chk_dSumSimSwaptionPrice + geom.iGlobal * cur_swp, &err);
+			cl_dSumSquareSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * geom.iGlobal, chk_dSumSquareSimSwaptionPrice + geom.iGlobal * cur_swp, &err);
 #elif defined(USE_SNUCL)
-			cl_pdForward[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * iN, NULL, &err);
-			cl_pdTotalDrift[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * (iN-1), NULL, &err);
-			cl_pdSwapPayoffs[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * iSwapVectorLength, NULL, &err);
-			cl_dSumSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * GLOBAL_WORK_SIZE, NULL, &err);
-			cl_dSumSquareSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * GLOBAL_WORK_SIZE, NULL, &err);
+			cl_pdForward[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(FTYPE) * iN, NULL, &err);
+			cl_pdTotalDrift[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(FTYPE) * (iN-1), NULL, &err);
+			cl_pdSwapPayoffs[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(FTYPE) * iSwapVectorLength, NULL, &err);
+			cl_dSumSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * geom.iGlobal, NULL, &err);
+			cl_dSumSquareSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * geom.iGlobal, NULL, &err);
 #else
-			cl_pdForward[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * iN, pdForward + iN * cur_swp, &err);
-			cl_pdTotalDrift[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * (iN-1), pdTotalDrift + (iN-1) * cur_swp, &err);
-			cl_pdSwapPayoffs[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * iSwapVectorLength, pdSwapPayoffs + iSwapVectorLength * cur_swp, &err);
-			cl_dSumSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * GLOBAL_WORK_SIZE, acc_dSumSimSwaptionPrice + GLOBAL_WORK_SIZE * cur_swp, &err);
-			cl_dSumSquareSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * GLOBAL_WORK_SIZE, acc_dSumSquareSimSwaptionPrice + GLOBAL_WORK_SIZE * cur_swp, &err);
+			cl_pdForward[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * iN, pdForward + iN * cur_swp, &err);
+			cl_pdTotalDrift[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * (iN-1), pdTotalDrift + (iN-1) * cur_swp, &err);
+			cl_pdSwapPayoffs[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * iSwapVectorLength, pdSwapPayoffs + iSwapVectorLength * cur_swp, &err);
+			cl_dSumSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * geom.iGlobal, NULL, &err);
+			cl_dSumSquareSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * geom.iGlobal, NULL, &err);
 #endif
 
 			if (err != CL_SUCCESS) {
@@ -904,8 +1566,6 @@ int main(int argc, char *argv[])
 			err = clEnqueueWriteBuffer(commands[i], cl_pdForward[cur_swp], CL_FALSE, 0, sizeof(FTYPE) * iN, pdForward + iN * cur_swp, 0, NULL, NULL);
 			err |= clEnqueueWriteBuffer(commands[i], cl_pdTotalDrift[cur_swp], CL_FALSE, 0, sizeof(FTYPE) * (iN-1), pdTotalDrift + (iN-1) * cur_swp, 0, NULL, NULL);
 			err |= clEnqueueWriteBuffer(commands[i], cl_pdSwapPayoffs[cur_swp], CL_FALSE, 0, sizeof(FTYPE) * iSwapVectorLength, pdSwapPayoffs + iSwapVectorLength * cur_swp, 0, NULL, NULL);
-			err |= clEnqueueWriteBuffer(commands[i], cl_dSumSimSwaptionPrice[cur_swp], CL_FALSE, 0, sizeof(FTYPE) * GLOBAL_WORK_SIZE, acc_dSumSimSwaptionPrice + GLOBAL_WORK_SIZE * cur_swp, 0, NULL, NULL);
-			err |= clEnqueueWriteBuffer(commands[i], cl_dSumSquareSimSwaptionPrice[cur_swp], CL_FALSE, 0, sizeof(FTYPE) * GLOBAL_WORK_SIZE, acc_dSumSquareSimSwaptionPrice, 0, NULL, NULL);
 
 			if (err != CL_SUCCESS) {
 				printf("Error: failed to write buffer. %d\n", err);
@@ -913,31 +1573,45 @@ int main(int argc, char *argv[])
 			}
 #endif
 
-			// Set kernel arguments (unique per swaption)
-			err = clSetKernelArg(kernels[1], 0, sizeof(cl_mem), (void*) &cl_ppdHJMPath[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 1, sizeof(int), (void*) &iN);
-			err |= clSetKernelArg(kernels[1], 2, sizeof(int), (void*) &iFactors);
-			err |= clSetKernelArg(kernels[1], 3, sizeof(FTYPE), (void*) &dYears);
-			err |= clSetKernelArg(kernels[1], 4, sizeof(int), (void*) &blk_size);
-			err |= clSetKernelArg(kernels[1], 5, sizeof(FTYPE), (void*) &ddelt);
-			err |= clSetKernelArg(kernels[1], 6, sizeof(FTYPE), (void*) &sqrt_ddelt);
-			err |= clSetKernelArg(kernels[1], 7, sizeof(int), (void*) &iSwapVectorLength);
-			err |= clSetKernelArg(kernels[1], 8, sizeof(int), (void*) &iSwapStartTimeIndex);
-			err |= clSetKernelArg(kernels[1], 9, sizeof(FTYPE), (void*) &dSwapVectorYears);
-			err |= clSetKernelArg(kernels[1], 10, sizeof(cl_mem), (void*) &cl_pdForward[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 11, sizeof(cl_mem), (void*) &cl_pdTotalDrift[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 12, sizeof(cl_mem), (void*) &cl_ppdFactors[i]);
-			err |= clSetKernelArg(kernels[1], 13, sizeof(cl_mem), (void*) &cl_gpdZ[i]);
-			err |= clSetKernelArg(kernels[1], 14, sizeof(cl_mem), (void*) &cl_pdDiscountingRatePath[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 15, sizeof(cl_mem), (void*) &cl_pdPayoffDiscountFactors[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 16, sizeof(cl_mem), (void*) &cl_pdexpRes[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 17, sizeof(cl_mem), (void*) &cl_pdSwapRatePath[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 18, sizeof(cl_mem), (void*) &cl_pdSwapDiscountFactors[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 19, sizeof(cl_mem), (void*) &cl_pdSwapPayoffs[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 20, sizeof(cl_mem), (void*) &cl_dSumSimSwaptionPrice[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 21, sizeof(cl_mem), (void*) &cl_dSumSquareSimSwaptionPrice[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 22, sizeof(cl_mem), (void*) &cl_iter_wi_sti[i]);
-			err |= clSetKernelArg(kernels[1], 23, sizeof(cl_mem), (void*) &cl_iter_wi_edi[i]);
+			// Next swaption
+			cur_swp++;
+		}
+	}
+
+	unsigned int chunk;
+	for (chunk = 0; chunk < nChunks; chunk++) {
+		unsigned int iter_first = chunk * iter_chunk;
+		unsigned int iter_cnt = iter_tot - iter_first < iter_chunk ? iter_tot - iter_first : iter_chunk;
+		unsigned int ran_cnt = zPerBlock * iter_cnt;
+		// index of pdZ[0] among the shocks of the whole run
+		long lZBase = (long)zPerBlock * iter_first;
+
+		// ***** RanUnif & CumNormalInv *****
+
+		// Calculate # of random numbers per device and per work-item
+		cl_split(ran_cnt, dev_cnt, ran_dev_ofs, ran_dev);
+		for (i = 0; i < dev_cnt; i++) {
+			ran_dev[i] = ran_dev[i] + 1 - ran_dev_ofs[i];
+			cl_split(ran_dev[i], geom.iGlobal, ran_wi_sti + geom.iGlobal * i, ran_wi_edi + geom.iGlobal * i);
+		}
+
+		// Random number generation with all OpenCL devices
+		for (i = 0; i < dev_cnt; i++) {
+			long lDevBase = lZBase + ran_dev_ofs[i];
+
+			err = clEnqueueWriteBuffer(commands[i], cl_sti[i], CL_FALSE, 0, sizeof(unsigned int) * dev_cnt * geom.iGlobal, ran_wi_sti, 0, NULL, NULL);
+			err |= clEnqueueWriteBuffer(commands[i], cl_edi[i], CL_FALSE, 0, sizeof(unsigned int) * dev_cnt * geom.iGlobal, ran_wi_edi, 0, NULL, NULL);
+
+			// Set kernel arguments
+			err |= clSetKernelArg(kernels[0], 0, sizeof(int), (void*) &globalWorkSize);
+			err |= clSetKernelArg(kernels[0], 1, sizeof(int), (void*) &i);
+			err |= clSetKernelArg(kernels[0], 2, sizeof(long), (void*) &lRndSeed);
+			err |= clSetKernelArg(kernels[0], 3, sizeof(cl_mem), (void*) &cl_pdZ[i]);
+			err |= clSetKernelArg(kernels[0], 4, sizeof(cl_mem), (void*) &cl_sti[i]);
+			err |= clSetKernelArg(kernels[0], 5, sizeof(cl_mem), (void*) &cl_edi[i]);
+			err |= clSetKernelArg(kernels[0], 6, sizeof(long), (void*) &lDevBase);
+			err |= clSetKernelArg(kernels[0], 7, sizeof(int), (void*) &iN);
+			err |= clSetKernelArg(kernels[0], 8, sizeof(int), (void*) &iFactors);
 
 			if (err != CL_SUCCESS) {
 				printf("Error: failed to set kernel arguments. %d\n", err);
@@ -945,30 +1619,123 @@ int main(int argc, char *argv[])
 			}
 
 			// Enqueue kernel
-			err = clEnqueueNDRangeKernel(commands[i], kernels[1], 1, NULL, &globalWorkSize, &localWorkSize2, 0, NULL, NULL);
+			err = clEnqueueNDRangeKernel(commands[i], kernels[0], 1, NULL, &globalWorkSize, &localWorkSize1, 0, NULL, NULL);
 
 			if (err != CL_SUCCESS) {
 				printf("Error: failed to enqueue kernel. %d\n", err);
 				return EXIT_FAILURE;
 			}
 
-			// Read prices back to host memory
-			err = clEnqueueReadBuffer(commands[i], cl_dSumSimSwaptionPrice[cur_swp], CL_FALSE, 0, (size_t) (sizeof(FTYPE) * GLOBAL_WORK_SIZE), acc_dSumSimSwaptionPrice + GLOBAL_WORK_SIZE * cur_swp, 0, NULL, NULL);
-			err |= clEnqueueReadBuffer(commands[i], cl_dSumSquareSimSwaptionPrice[cur_swp], CL_FALSE, 0, (size_t) (sizeof(FTYPE) * GLOBAL_WORK_SIZE), acc_dSumSquareSimSwaptionPrice + GLOBAL_WORK_SIZE * cur_swp, 0, NULL, NULL);
+			// Read this device's share of pdZ back to host memory
+			err = clEnqueueReadBuffer(commands[i], cl_pdZ[i], CL_FALSE, 0, (size_t) (ran_dev[i] * sizeof(FTYPE)), pdZ + ran_dev_ofs[i], 0, NULL, NULL);
 
 			if (err != CL_SUCCESS) {
 				printf("Error: failed to read buffer. %d\n", err);
 				return EXIT_FAILURE;
 			}
+		}
 
-			// Next swaption
-			cur_swp++;
+		// Ensure kernel completion
+		for (i = 0; i < dev_cnt; i++) {
+			clFinish(commands[i]);
+		}
+
+		// ***** Simulation *****
+
+		// the chunk's shocks and blocks to every device
+		cl_split(iter_cnt, geom.iGlobal, iter_wi_sti, iter_wi_edi);
+		for (i = 0; i < dev_cnt; i++) {
+			err = clEnqueueWriteBuffer(commands[i], cl_gpdZ[i], CL_FALSE, 0, sizeof(FTYPE) * ran_cnt, pdZ, 0, NULL, NULL);
+			err |= clEnqueueWriteBuffer(commands[i], cl_iter_wi_sti[i], CL_FALSE, 0, sizeof(unsigned int) * geom.iGlobal, iter_wi_sti, 0, NULL, NULL);
+			err |= clEnqueueWriteBuffer(commands[i], cl_iter_wi_edi[i], CL_FALSE, 0, sizeof(unsigned int) * geom.iGlobal, iter_wi_edi, 0, NULL, NULL);
+
+			if (err != CL_SUCCESS) {
+				printf("Error: failed to write buffer. %d\n", err);
+				return EXIT_FAILURE;
+			}
+		}
+
+		// Enqueue kernels for each swaption
+#ifdef USE_MPI
+		cur_swp = swp_node_sti;
+#else
+		cur_swp = 0;
+#endif
+		for (i = 0; i < dev_cnt; i++) {
+			for (swp_cnt = 0; swp_cnt < swp_dev[i]; swp_cnt++) {
+
+				// Set kernel arguments (unique per swaption)
+				err = clSetKernelArg(kernels[1], 0, sizeof(cl_mem), (void*) &cl_pdRows[cur_swp]);
+				err |= clSetKernelArg(kernels[1], 1, sizeof(int), (void*) &iN);
+				err |= clSetKernelArg(kernels[1], 2, sizeof(int), (void*) &iFactors);
+				err |= clSetKernelArg(kernels[1], 3, sizeof(FTYPE), (void*) &dYears);
+				err |= clSetKernelArg(kernels[1], 4, sizeof(int), (void*) &blk_size);
+				err |= clSetKernelArg(kernels[1], 5, sizeof(FTYPE), (void*) &ddelt);
+				err |= clSetKernelArg(kernels[1], 6, sizeof(FTYPE), (void*) &sqrt_ddelt);
+				err |= clSetKernelArg(kernels[1], 7, sizeof(int), (void*) &iSwapVectorLength);
+				err |= clSetKernelArg(kernels[1], 8, sizeof(int), (void*) &iSwapStartTimeIndex);
+				err |= clSetKernelArg(kernels[1], 9, sizeof(FTYPE), (void*) &dSwapVectorYears);
+				err |= clSetKernelArg(kernels[1], 10, sizeof(cl_mem), (void*) &cl_pdForward[cur_swp]);
+				err |= clSetKernelArg(kernels[1], 11, sizeof(cl_mem), (void*) &cl_pdTotalDrift[cur_swp]);
+				err |= clSetKernelArg(kernels[1], 12, sizeof(cl_mem), (void*) &cl_ppdFactors[i]);
+				err |= clSetKernelArg(kernels[1], 13, sizeof(cl_mem), (void*) &cl_gpdZ[i]);
+				err |= clSetKernelArg(kernels[1], 14, sizeof(cl_mem), (void*) &cl_pdSwapPayoffs[cur_swp]);
+				err |= clSetKernelArg(kernels[1], 15, sizeof(cl_mem), (void*) &cl_dSumSimSwaptionPrice[cur_swp]);
+				err |= clSetKernelArg(kernels[1], 16, sizeof(cl_mem), (void*) &cl_dSumSquareSimSwaptionPrice[cur_swp]);
+				err |= clSetKernelArg(kernels[1], 17, sizeof(cl_mem), (void*) &cl_iter_wi_sti[i]);
+				err |= clSetKernelArg(kernels[1], 18, sizeof(cl_mem), (void*) &cl_iter_wi_edi[i]);
+
+				if (err != CL_SUCCESS) {
+					printf("Error: failed to set kernel arguments. %d\n", err);
+					return EXIT_FAILURE;
+				}
+
+				// Enqueue kernel
+				err = clEnqueueNDRangeKernel(commands[i], kernels[1], 1, NULL, &globalWorkSize, &localWorkSize2, 0, NULL, NULL);
+
+				if (err != CL_SUCCESS) {
+					printf("Error: failed to enqueue kernel. %d\n", err);
+					return EXIT_FAILURE;
+				}
+
+				// Read the chunk's sums back to host memory
+				err = clEnqueueReadBuffer(commands[i], cl_dSumSimSwaptionPrice[cur_swp], CL_FALSE, 0, (size_t) (sizeof(FTYPE) * geom.iGlobal), chk_dSumSimSwaptionPrice + geom.iGlobal * cur_swp, 0, NULL, NULL);
+				err |= clEnqueueReadBuffer(commands[i], cl_dSumSquareSimSwaptionPrice[cur_swp], CL_FALSE, 0, (size_t) (sizeof(FTYPE) * geom.iGlobal), chk_dSumSquareSimSwaptionPrice + geom.iGlobal * cur_swp, 0, NULL, NULL);
+
+				if (err != CL_SUCCESS) {
+					printf("Error: failed to read buffer. %d\n", err);
+					return EXIT_FAILURE;
+				}
+
+				// Next swaption
+				cur_swp++;
+			}
+		}
+
+		// Ensure kernel completion
+		for (i = 0; i < dev_cnt; i++) {
+			clFinish(commands[i]);
+		}
+
+		// Carry the sums over to the next chunk
+#ifdef USE_MPI
+		for (j = geom.iGlobal * swp_node_sti; j < geom.iGlobal * (swp_node_edi + 1); j++) {
+#else
+		for (j = 0; j < geom.iGlobal * nSwaptions; j++) {
+#endif
+			acc_dSumSimSwaptionPrice[j] += chk_dSumSimSwaptionPrice[j];
+			acc_dSumSquareSimSwaptionPrice[j] += chk_dSumSquareSimSwaptionPrice[j];
 		}
 	}
 
-	// Ensure kernel completion
 	for (i = 0; i < dev_cnt; i++) {
-		clFinish(commands[i]);
+		clReleaseMemObject(cl_pdZ[i]);
+		clReleaseMemObject(cl_sti[i]);
+		clReleaseMemObject(cl_edi[i]);
+		clReleaseMemObject(cl_ppdFactors[i]);
+		clReleaseMemObject(cl_gpdZ[i]);
+		clReleaseMemObject(cl_iter_wi_sti[i]);
+		clReleaseMemObject(cl_iter_wi_edi[i]);
 	}
 	
 	// Reduce prices TODO: too heavy?
@@ -977,14 +1744,14 @@ int main(int argc, char *argv[])
 	FTYPE* mpi_acc_dSumSquareSimSwaptionPrice;
 
 	if (comm_rank == 0) {
-		mpi_acc_dSumSimSwaptionPrice = (FTYPE*) malloc(sizeof(FTYPE) * GLOBAL_WORK_SIZE * nSwaptions);
-		mpi_acc_dSumSquareSimSwaptionPrice = (FTYPE*) malloc(sizeof(FTYPE) * GLOBAL_WORK_SIZE * nSwaptions);
+		mpi_acc_dSumSimSwaptionPrice = (FTYPE*) malloc(sizeof(FTYPE) * geom.iGlobal * nSwaptions);
+		mpi_acc_dSumSquareSimSwaptionPrice = (FTYPE*) malloc(sizeof(FTYPE) * geom.iGlobal * nSwaptions);
 	}
 
 	// Reduction
 	// (need to change MPI_DOUBLE if FTYPE changes)
-	MPI_Reduce(acc_dSumSimSwaptionPrice, mpi_acc_dSumSimSwaptionPrice, GLOBAL_WORK_SIZE * nSwaptions, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-	MPI_Reduce(acc_dSumSquareSimSwaptionPrice, mpi_acc_dSumSquareSimSwaptionPrice, GLOBAL_WORK_SIZE * nSwaptions, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+	MPI_Reduce(acc_dSumSimSwaptionPrice, mpi_acc_dSumSimSwaptionPrice, geom.iGlobal * nSwaptions, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+	MPI_Reduce(acc_dSumSquareSimSwaptionPrice, mpi_acc_dSumSquareSimSwaptionPrice, geom.iGlobal * nSwaptions, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
 #endif
 
 #ifdef USE_MPI
@@ -992,21 +1759,23 @@ int main(int argc, char *argv[])
 #endif
 		FTYPE fin_dSumSimSwaptionPrice[nSwaptions];
 		FTYPE fin_dSumSquareSimSwaptionPrice[nSwaptions];
+		// whole blocks are simulated, NUM_TRIALS rounded up to the block size
+		FTYPE dPaths = (FTYPE)iter_tot * geom.iBlock;
 
 		for (i = 0; i < nSwaptions; i++) {
 			fin_dSumSimSwaptionPrice[i] = 0.0;
 			fin_dSumSquareSimSwaptionPrice[i] = 0.0;
-			for (j = 0; j < GLOBAL_WORK_SIZE; j++) {
+			for (j = 0; j < geom.iGlobal; j++) {
 #ifdef USE_MPI
-				fin_dSumSimSwaptionPrice[i] += mpi_acc_dSumSimSwaptionPrice[GLOBAL_WORK_SIZE * i + j];
-				fin_dSumSquareSimSwaptionPrice[i] += mpi_acc_dSumSquareSimSwaptionPrice[GLOBAL_WORK_SIZE * i + j];
+				fin_dSumSimSwaptionPrice[i] += mpi_acc_dSumSimSwaptionPrice[geom.iGlobal * i + j];
+				fin_dSumSquareSimSwaptionPrice[i] += mpi_acc_dSumSquareSimSwaptionPrice[geom.iGlobal * i + j];
 #else
-				fin_dSumSimSwaptionPrice[i] += acc_dSumSimSwaptionPrice[GLOBAL_WORK_SIZE * i + j];
-				fin_dSumSquareSimSwaptionPrice[i] += acc_dSumSquareSimSwaptionPrice[GLOBAL_WORK_SIZE * i + j];
+				fin_dSumSimSwaptionPrice[i] += acc_dSumSimSwaptionPrice[geom.iGlobal * i + j];
+				fin_dSumSquareSimSwaptionPrice[i] += acc_dSumSquareSimSwaptionPrice[geom.iGlobal * i + j];
 #endif
 			}
-			swaptions[i].dSimSwaptionMeanPrice = fin_dSumSimSwaptionPrice[i] / NUM_TRIALS;
-			swaptions[i].dSimSwaptionStdError = sqrt((fin_dSumSquareSimSwaptionPrice[i]-fin_dSumSimSwaptionPrice[i]*fin_dSumSimSwaptionPrice[i]/NUM_TRIALS)/(NUM_TRIALS-1.0))/sqrt((FTYPE)NUM_TRIALS);
+			swaptions[i].dSimSwaptionMeanPrice = fin_dSumSimSwaptionPrice[i] / dPaths;
+			swaptions[i].dSimSwaptionStdError = sqrt((fin_dSumSquareSimSwaptionPrice[i]-fin_dSumSimSwaptionPrice[i]*fin_dSumSimSwaptionPrice[i]/dPaths)/(dPaths-1.0))/sqrt(dPaths);
 		}
 #ifdef USE_MPI
 	}
@@ -1019,16 +1788,17 @@ int main(int argc, char *argv[])
 	free(gppdFactors);
 	free(dStrikeCont);
 	free(swp_dev);
-	free(iter_wi);
 	free(iter_wi_sti);
 	free(iter_wi_edi);
-	free(pdZ);
+	free_dvector(pdZ, 0, ranCnt-1);
 	free(ran_dev);
-	free(ran_wi);
+	free(ran_dev_ofs);
 	free(ran_wi_sti);
 	free(ran_wi_edi);
 	free(acc_dSumSimSwaptionPrice);
 	free(acc_dSumSquareSimSwaptionPrice);
+	free(chk_dSumSimSwaptionPrice);
+	free(chk_dSumSquareSimSwaptionPrice);
 
 #ifdef USE_MPI
 	if (comm_rank == 0) {
@@ -1047,23 +1817,63 @@ int main(int argc, char *argv[])
 	__parsec_roi_begin();
 #endif
 
+	if (bEngine || bBermudan) {
+		if (!(bBermudan ? price_bermudans() : price_book()))
+			iSuccess = 1;
+#if defined(ENABLE_THREADS) && !defined(TBB_VERSION)
+		free(threads);
+#endif
+	} else if (pszJobs) {
+		// a -ckpt run schedules the states its writer saves
+		swaption_state *pStates = states ? states : (swaption_state *)calloc(nSwaptions, sizeof(swaption_state));
+		if (HJM_Schedule(swaptions, nSwaptions, jobs, pStates, bLazyBook ? init_swaption : NULL, nThreads,
+					NUM_TRIALS, lSlice, RANDSEEDVAL) != nSwaptions)
+			iSuccess = 1;
+		if (!states)
+			free(pStates);
+		free(jobs);
+#if defined(ENABLE_THREADS) && !defined(TBB_VERSION)
+		free(threads);
+#endif
+	} else {
 #ifdef ENABLE_THREADS
 
 #ifdef TBB_VERSION
-	Worker w;
-	tbb::parallel_for(tbb::blocked_range<int>(0,nSwaptions,TBB_GRAINSIZE),w);
+		Worker w;
+		tbb::parallel_for(tbb::blocked_range<int>(0,nSwaptions,TBB_GRAINSIZE),w);
 #else
 
-	int threadIDs[nThreads];
-	for (i = 0; i < nThreads; i++) {
-		threadIDs[i] = i;
-		pthread_create(&threads[i], &pthread_custom_attr, worker, &threadIDs[i]);
-	}
-	for (i = 0; i < nThreads; i++) {
-		pthread_join(threads[i], NULL);
-	}
+		// a worker whose thread cannot be started runs on the caller, as in init_book
+		int threadIDs[nThreads], pbStarted[nThreads];
+		for (i = 0; i < nThreads; i++) {
+			threadIDs[i] = i;
+			if (iAffinity != AFFINITY_NONE) {
+				// -1: no cpus found, the thread is left unpinned
+				int cpu = HJM_Affinity_Cpu(i, iAffinity);
+				if (cpu >= 0) {
+					cpu_set_t cpuset;
+					CPU_ZERO(&cpuset);
+					CPU_SET(cpu, &cpuset);
+					pthread_attr_setaffinity_np(&pthread_custom_attr, sizeof(cpu_set_t), &cpuset);
+#ifdef DEBUG
+					printf("Thread %d -> cpu %d (node %d)\n", i, cpu, HJM_Affinity_Node(cpu));
+#endif
+				}
+			}
+			pbStarted[i] = pthread_create(&threads[i], &pthread_custom_attr, worker, &threadIDs[i]) == 0;
+		}
+		for (i = 0; i < nThreads; i++) {
+			if (!pbStarted[i]) {
+				fprintf(stderr,"Warning: cannot start thread %d, running its swaptions here\n", i);
+				worker(&threadIDs[i]);
+			}
+		}
+		for (i = 0; i < nThreads; i++) {
+			if (pbStarted[i])
+				pthread_join(threads[i], NULL);
+		}
 
-	free(threads);
+		free(threads);
 
 #endif // TBB_VERSION	
 
@@ -1073,10 +1883,11 @@ int main(int argc, char *argv[])
 #elif USE_SNUCL
 
 #else
-	int threadID=0;
-	worker(&threadID);
+		int threadID=0;
+		worker(&threadID);
 
 #endif //ENABLE_THREADS
+	}
 
 #ifdef DEBUG
 	clock_gettime(CLOCK_MONOTONIC, &end);
@@ -1091,6 +1902,13 @@ int main(int argc, char *argv[])
 	__parsec_roi_end();
 #endif
 
+	if (pszCkpt) {
+		HJM_Ckpt_Stop();
+		free(states);
+	}
+
+	HJM_Prof_Report();
+
 #ifdef USE_MPI
 	if (comm_rank == 0)
 #endif
@@ -1100,6 +1918,22 @@ int main(int argc, char *argv[])
 
 		}
 
+	// Scenario x swaption price matrix
+	if (nScenarios > 0) {
+		fprintf(stderr,"%-16s", "Scenario");
+		for (i = 0; i < nSwaptions; i++)
+			fprintf(stderr," Swaption%-7d", i);
+		fprintf(stderr,"\n");
+		for (j = 0; j < nScenarios; j++) {
+			fprintf(stderr,"%-16s", scenarios[j].szName);
+			for (i = 0; i < nSwaptions; i++)
+				fprintf(stderr," %15.10lf", pdScenPrice[2*nScenarios*i + 2*j]);
+			fprintf(stderr,"\n");
+		}
+		free(pdScenPrice);
+		free(scenarios);
+	}
+
 	for (i = 0; i < nSwaptions; i++) {
 		free_dvector(swaptions[i].pdYield, 0, swaptions[i].iN-1);
 		free_dmatrix(swaptions[i].ppdFactors, 0, swaptions[i].iFactors-1, 0, swaptions[i].iN-2);
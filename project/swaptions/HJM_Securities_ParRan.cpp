@@ -826,12 +826,7 @@ int main(int argc, char *argv[])
 	FTYPE *acc_dSumSquareSimSwaptionPrice = (FTYPE*) calloc(GLOBAL_WORK_SIZE * nSwaptions, sizeof(FTYPE));
 	
 	// Device memory objects
-	cl_mem cl_ppdHJMPath[nSwaptions];
-	cl_mem cl_pdDiscountingRatePath[nSwaptions];
-	cl_mem cl_pdPayoffDiscountFactors[nSwaptions];
-	cl_mem cl_pdexpRes[nSwaptions];
-	cl_mem cl_pdSwapRatePath[nSwaptions];
-	cl_mem cl_pdSwapDiscountFactors[nSwaptions];
+	cl_mem cl_pdRows[nSwaptions];
 
 	cl_mem cl_pdForward[nSwaptions];
 	cl_mem cl_pdTotalDrift[nSwaptions];
@@ -846,12 +841,12 @@ int main(int argc, char *argv[])
 
 	// Create buffers (common across all swaptions)
 #ifdef USE_CPU
-	cl_ppdFactors = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * iFactors * (iN-1), gppdFactors, &err);
+	cl_ppdFactors = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * iFactors * (iN-1), gppdFactors, &err);
 	cl_gpdZ = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * ranCnt, pdZ, &err);
 	cl_iter_wi_sti = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(unsigned int) * GLOBAL_WORK_SIZE, iter_wi_sti, &err);
 	cl_iter_wi_edi = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(unsigned int) * GLOBAL_WORK_SIZE, iter_wi_edi, &err);
 #else
-	cl_ppdFactors = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * iFactors * (iN-1), gppdFactors, &err);
+	cl_ppdFactors = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * iFactors * (iN-1), gppdFactors, &err);
 	cl_gpdZ = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * ranCnt, pdZ, &err);
 	cl_iter_wi_sti = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(unsigned int) * GLOBAL_WORK_SIZE, iter_wi_sti, &err);
 	cl_iter_wi_edi = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(unsigned int) * GLOBAL_WORK_SIZE, iter_wi_edi, &err);
@@ -875,23 +870,18 @@ int main(int argc, char *argv[])
 		for (swp_cnt = 0; swp_cnt < swp_dev[i]; swp_cnt++) {
 
 			// Create buffers (unique per swaption)
-			cl_ppdHJMPath[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * iN * iN * BLOCK_SIZE * GLOBAL_WORK_SIZE, NULL, &err);
-			cl_pdDiscountingRatePath[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * iN * BLOCK_SIZE * GLOBAL_WORK_SIZE, NULL, &err);
-			cl_pdPayoffDiscountFactors[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * iN * BLOCK_SIZE * GLOBAL_WORK_SIZE, NULL, &err);
-			cl_pdexpRes[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * (iN-1) * BLOCK_SIZE * GLOBAL_WORK_SIZE, NULL, &err);
-			cl_pdSwapRatePath[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * iSwapVectorLength * BLOCK_SIZE * GLOBAL_WORK_SIZE, NULL, &err);
-			cl_pdSwapDiscountFactors[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * iSwapVectorLength * BLOCK_SIZE * GLOBAL_WORK_SIZE, NULL, &err);
+			cl_pdRows[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(FTYPE) * 2 * iN * GLOBAL_WORK_SIZE, NULL, &err);
 
 #ifdef USE_CPU
-			cl_pdForward[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * iN, pdForward + iN * cur_swp, &err);
-			cl_pdTotalDrift[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * (iN-1), pdTotalDrift + (iN-1) * cur_swp, &err);
-			cl_pdSwapPayoffs[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * iSwapVectorLength, pdSwapPayoffs + iSwapVectorLength * cur_swp, &err);
+			cl_pdForward[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * iN, pdForward + iN * cur_swp, &err);
+			cl_pdTotalDrift[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * (iN-1), pdTotalDrift + (iN-1) * cur_swp, &err);
+			cl_pdSwapPayoffs[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * iSwapVectorLength, pdSwapPayoffs + iSwapVectorLength * cur_swp, &err);
 			cl_dSumSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * GLOBAL_WORK_SIZE, acc_dSumSimSwaptionPrice + GLOBAL_WORK_SIZE * cur_swp, &err);
 			cl_dSumSquareSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(FTYPE) * GLOBAL_WORK_SIZE, acc_dSumSquareSimSwaptionPrice + GLOBAL_WORK_SIZE * cur_swp, &err);
 #else
-			cl_pdForward[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * iN, pdForward + iN * cur_swp, &err);
-			cl_pdTotalDrift[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * (iN-1), pdTotalDrift + (iN-1) * cur_swp, &err);
-			cl_pdSwapPayoffs[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * iSwapVectorLength, pdSwapPayoffs + iSwapVectorLength * cur_swp, &err);
+			cl_pdForward[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * iN, pdForward + iN * cur_swp, &err);
+			cl_pdTotalDrift[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * (iN-1), pdTotalDrift + (iN-1) * cur_swp, &err);
+			cl_pdSwapPayoffs[cur_swp] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * iSwapVectorLength, pdSwapPayoffs + iSwapVectorLength * cur_swp, &err);
 			cl_dSumSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * GLOBAL_WORK_SIZE, acc_dSumSimSwaptionPrice + GLOBAL_WORK_SIZE * cur_swp, &err);
 			cl_dSumSquareSimSwaptionPrice[cur_swp] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(FTYPE) * GLOBAL_WORK_SIZE, acc_dSumSquareSimSwaptionPrice + GLOBAL_WORK_SIZE * cur_swp, &err);
 #endif
@@ -902,7 +892,7 @@ int main(int argc, char *argv[])
 			}
 
 			// Set kernel arguments (unique per swaption)
-			err = clSetKernelArg(kernels[1], 0, sizeof(cl_mem), (void*) &cl_ppdHJMPath[cur_swp]);
+			err = clSetKernelArg(kernels[1], 0, sizeof(cl_mem), (void*) &cl_pdRows[cur_swp]);
 			err |= clSetKernelArg(kernels[1], 1, sizeof(int), (void*) &iN);
 			err |= clSetKernelArg(kernels[1], 2, sizeof(int), (void*) &iFactors);
 			err |= clSetKernelArg(kernels[1], 3, sizeof(FTYPE), (void*) &dYears);
@@ -916,16 +906,11 @@ int main(int argc, char *argv[])
 			err |= clSetKernelArg(kernels[1], 11, sizeof(cl_mem), (void*) &cl_pdTotalDrift[cur_swp]);
 			err |= clSetKernelArg(kernels[1], 12, sizeof(cl_mem), (void*) &cl_ppdFactors);
 			err |= clSetKernelArg(kernels[1], 13, sizeof(cl_mem), (void*) &cl_gpdZ);
-			err |= clSetKernelArg(kernels[1], 14, sizeof(cl_mem), (void*) &cl_pdDiscountingRatePath[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 15, sizeof(cl_mem), (void*) &cl_pdPayoffDiscountFactors[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 16, sizeof(cl_mem), (void*) &cl_pdexpRes[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 17, sizeof(cl_mem), (void*) &cl_pdSwapRatePath[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 18, sizeof(cl_mem), (void*) &cl_pdSwapDiscountFactors[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 19, sizeof(cl_mem), (void*) &cl_pdSwapPayoffs[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 20, sizeof(cl_mem), (void*) &cl_dSumSimSwaptionPrice[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 21, sizeof(cl_mem), (void*) &cl_dSumSquareSimSwaptionPrice[cur_swp]);
-			err |= clSetKernelArg(kernels[1], 22, sizeof(cl_mem), (void*) &cl_iter_wi_sti);
-			err |= clSetKernelArg(kernels[1], 23, sizeof(cl_mem), (void*) &cl_iter_wi_edi);
+			err |= clSetKernelArg(kernels[1], 14, sizeof(cl_mem), (void*) &cl_pdSwapPayoffs[cur_swp]);
+			err |= clSetKernelArg(kernels[1], 15, sizeof(cl_mem), (void*) &cl_dSumSimSwaptionPrice[cur_swp]);
+			err |= clSetKernelArg(kernels[1], 16, sizeof(cl_mem), (void*) &cl_dSumSquareSimSwaptionPrice[cur_swp]);
+			err |= clSetKernelArg(kernels[1], 17, sizeof(cl_mem), (void*) &cl_iter_wi_sti);
+			err |= clSetKernelArg(kernels[1], 18, sizeof(cl_mem), (void*) &cl_iter_wi_edi);
 
 			if (err != CL_SUCCESS) {
 				printf("Error: failed to set kernel arguments. %d\n", err);
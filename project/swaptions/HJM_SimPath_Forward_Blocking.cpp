@@ -4,97 +4,87 @@
 #include "HJM_type.h"
 #include "HJM.h"
 #include "nr_routines.h"
+#include "HJM_prof.h"
+#include "icdf.h"
+#include "rng.h"
 
-#ifdef TBB_VERSION
-#include <pthread.h>
-#include "tbb/task_scheduler_init.h"
-#include "tbb/blocked_range.h"
-#include "tbb/parallel_for.h"
-#include "tbb/cache_aligned_allocator.h"
 
+void serialB(FTYPE **pdZ, FTYPE **randZ, int BLOCKSIZE, int iN, int iFactors)
+{
+	// rows 1..iN-1 of each factor are contiguous, so one batched call per factor;
+	// a smaller iN transforms only the leading rows
+	for(int l=0;l<=iFactors-1;++l){
+		icdf(BLOCKSIZE*(iN-1), randZ[l] + BLOCKSIZE, pdZ[l] + BLOCKSIZE);  /* 18% of the total executition time */
+	}
+}
 
-#define PARALLEL_B_GRAINSIZE 8
+int HJM_Z_Blocking(FTYPE **pdZ,		//Matrix that stores the random normals (Output)
+		FTYPE **randZ,			//Scratch matrix for the uniform draws
+		int iN,					//Number of time-steps
+		int iFactors,			//Number of factors in the HJM framework
+		long *lRndSeed,			//Random number seed
+		int BLOCKSIZE)
+{
+	//This function draws the shocks for one block of BLOCKSIZE paths.
+	//Kept apart from the path evolution so that the same shocks can be
+	//reused by several paths (e.g. common random numbers across scenarios).
+	return HJM_Z_Blocking_Rows(pdZ, randZ, iN, iFactors, iN-1, lRndSeed, BLOCKSIZE);
+}
 
+int HJM_Z_Blocking_Rows(FTYPE **pdZ,	//Matrix that stores the random normals (Output)
+		FTYPE **randZ,			//Scratch matrix for the uniform draws
+		int iN,					//Number of time-steps
+		int iFactors,			//Number of factors in the HJM framework
+		int nRows,				//Time steps 1..nRows get normals, the others only uniforms
+		long *lRndSeed,			//Random number seed
+		int BLOCKSIZE)
+{
+	//As HJM_Z_Blocking for a path that is only evolved up to time step
+	//nRows: every draw is still made, so the seed advances as usual, but
+	//the inverse normal skips the rows nobody reads.
 
-struct ParallelB {
-	__volatile__ int l;
-	FTYPE **pdZ;
-	FTYPE **randZ;
-	int BLOCKSIZE;
-	int iN;
+	int iSuccess = 0;
 
-	ParallelB(FTYPE **pdZ_, FTYPE **randZ_, int BLOCKSIZE_, int iN_)//:
-		//    pdZ(pdZ_), randZ(randZ_), BLOCKSIZE(BLOCKSIZE_), iN(iN_)
+	// =====================================================
+	// uniform draws, in the selected generator's order (rng.h)
 	{
-		pdZ = pdZ_;
-		randZ = randZ_;
-		BLOCKSIZE = BLOCKSIZE_;
-		iN = iN_; 
-		/*fprintf(stderr,"(Construction object) pdZ=0x%08x, randZ=0x%08x\n",
-		  pdZ, randZ);*/
-
+		PROF_SCOPE(PROF_RNG);
+		rng_uniform(randZ, iN, iFactors, lRndSeed, BLOCKSIZE);  /* 10% of the total executition time */
 	}
-	void set_l(int l_){l = l_;}
-
-	void operator()(const tbb::blocked_range<int> &range) const {
-		int begin = range.begin();
-		int end   = range.end();
-		int b,j;
-		/*fprintf(stderr,"B: Thread %d from %d to %d. l=%d pdZ=0x%08x, BLOCKSIZE=%d, iN=%d\n",
-		  pthread_self(), begin, end, l,(int)pdZ,BLOCKSIZE,iN); */
-
-		for(b=begin; b!=end; b++) {
-			for (j=1;j<=iN-1;++j){
-				pdZ[l][BLOCKSIZE*j + b]= CumNormalInv(randZ[l][BLOCKSIZE*j + b]);  /* 18% of the total executition time */
-				//fprintf(stderr,"%d (%d, %d): [%d][%d]=%e\n",pthread_self(), begin, end,  l,BLOCKSIZE*j+b,pdZ[l][BLOCKSIZE*j + b]);
-			}
-		}
 
+	// =====================================================
+	// shocks to hit various factors for forward curve at t
+	{
+		PROF_SCOPE(PROF_ICDF);
+		/* 18% of the total executition time */
+		serialB(pdZ, randZ, BLOCKSIZE, nRows+1, iFactors);
 	}
 
-};
-
-
-#endif // TBB_VERSION
-
-void serialB(FTYPE **pdZ, FTYPE **randZ, int BLOCKSIZE, int iN, int iFactors)
-{
-
-
-	for(int l=0;l<=iFactors-1;++l){
-		for(int b=0; b<BLOCKSIZE; b++){
-			for (int j=1;j<=iN-1;++j){
-				pdZ[l][BLOCKSIZE*j + b]= CumNormalInv(randZ[l][BLOCKSIZE*j + b]);  /* 18% of the total executition time */
-			}
-		}
-	}
+	iSuccess = 1;
+	return iSuccess;
 }
 
-int HJM_SimPath_Forward_Blocking(FTYPE **ppdHJMPath,	//Matrix that stores generated HJM path (Output)
+int HJM_SimPath_Forward_Blocking_Z(FTYPE **ppdHJMPath,	//Matrix that stores generated HJM path (Output)
 		int iN,					//Number of time-steps
 		int iFactors,			//Number of factors in the HJM framework
 		FTYPE dYears,			//Number of years
 		FTYPE *pdForward,		//t=0 Forward curve
 		FTYPE *pdTotalDrift,	//Vector containing total drift corrections for different maturities
 		FTYPE **ppdFactors,	//Factor volatilities
-		long *lRndSeed,			//Random number seed
+		FTYPE **pdZ,			//Random normals drawn by HJM_Z_Blocking
 		int BLOCKSIZE)
-{	
-	//This function computes and stores an HJM Path for given inputs
+{
+	//This function computes and stores an HJM Path from already drawn shocks
 
 	int iSuccess = 0;
-	int i,j,l; //looping variables
-	FTYPE **pdZ; //vector to store random normals
-	FTYPE **randZ; //vector to store random normals
-	FTYPE dTotalShock; //total shock by which the forward curve is hit at (t, T-t)
-	FTYPE ddelt, sqrt_ddelt; //length of time steps	
+	int i,j; //looping variables
+	FTYPE ddelt, sqrt_ddelt; //length of time steps
+
+	PROF_SCOPE(PROF_PATH);
 
 	ddelt = (FTYPE)(dYears/iN);
 	sqrt_ddelt = sqrt(ddelt);
 
-	pdZ   = dmatrix(0, iFactors-1, 0, iN*BLOCKSIZE -1); //assigning memory
-	randZ = dmatrix(0, iFactors-1, 0, iN*BLOCKSIZE -1); //assigning memory
-
 	// =====================================================
 	// t=0 forward curve stored iN first row of ppdHJMPath
 	// At time step 0: insert expected drift 
@@ -110,59 +100,77 @@ int HJM_SimPath_Forward_Blocking(FTYPE **ppdHJMPath,	//Matrix that stores genera
 	// -----------------------------------------------------
 
 	// =====================================================
-	// sequentially generating random numbers
+	// Generation of HJM Path1
+	for (j=1;j<=iN-1;++j) // j is the timestep
+		HJM_SimPath_Row(ppdHJMPath[j], ppdHJMPath[j-1], j, iN, iFactors, ddelt, sqrt_ddelt, pdTotalDrift, ppdFactors,
+				pdZ, BLOCKSIZE);
+	// -----------------------------------------------------
 
+	iSuccess = 1;
+	return iSuccess;
+}
 
-	for(int b=0; b<BLOCKSIZE; b++){
-		for(int s=0; s<1; s++){
-			for (j=1;j<=iN-1;++j){
-				for (l=0;l<=iFactors-1;++l){
-					//compute random number in exact same sequence
-					randZ[l][BLOCKSIZE*j + b + s] = RanUnif(lRndSeed);  /* 10% of the total executition time */
-				}
-			}
-		}
-	}
+void HJM_SimPath_Row(FTYPE *pdRow,		//Time step j of the path (Output)
+		const FTYPE *pdPrev,	//Time step j-1
+		int j,
+		int iN,
+		int iFactors,
+		FTYPE ddelt,
+		FTYPE sqrt_ddelt,
+		FTYPE *pdTotalDrift,
+		FTYPE **ppdFactors,
+		FTYPE **pdZ,
+		int BLOCKSIZE)
+{
+	int b, i, l;
+	FTYPE dTotalShock; //total shock by which the forward curve is hit at (t, T-t)
 
-	// =====================================================
-	// shocks to hit various factors for forward curve at t
+	// -isa avx2/avx512: the block lanes b run in SIMD registers (HJM_SimPath_kernels.h)
+	if (icdf_selected_isa() == ICDF_AVX512 &&
+			HJM_Row_Evolve_avx512(pdRow, pdPrev, j, iN, iFactors, ddelt, sqrt_ddelt, pdTotalDrift, ppdFactors, pdZ, BLOCKSIZE))
+		return;
+	if (icdf_selected_isa() >= ICDF_AVX2 &&
+			HJM_Row_Evolve_avx2(pdRow, pdPrev, j, iN, iFactors, ddelt, sqrt_ddelt, pdTotalDrift, ppdFactors, pdZ, BLOCKSIZE))
+		return;
 
-#ifdef TBB_VERSION
-	ParallelB B(pdZ, randZ, BLOCKSIZE, iN);
-	for(l=0;l<=iFactors-1;++l){
-		B.set_l(l);
-		tbb::parallel_for(tbb::blocked_range<int>(0, BLOCKSIZE, PARALLEL_B_GRAINSIZE),B);
-	}
+	for (l=0;l<=iN-(j+1);++l){ // l is the future steps
+		for(b=0; b<BLOCKSIZE; b++){ // b is the blocks
+			dTotalShock = 0;
 
-#else
-	/* 18% of the total executition time */
-	serialB(pdZ, randZ, BLOCKSIZE, iN, iFactors);
-#endif
+			for (i=0;i<=iFactors-1;++i){// i steps through the stochastic factors
+				dTotalShock += ppdFactors[i][l]* pdZ[i][BLOCKSIZE*j + b];
+			}
 
-	// =====================================================
-	// Generation of HJM Path1
-	for(int b=0; b<BLOCKSIZE; b++){ // b is the blocks
-		for (j=1;j<=iN-1;++j) {// j is the timestep
+			pdRow[BLOCKSIZE*l+b] = pdPrev[BLOCKSIZE*(l+1)+b]+ pdTotalDrift[l]*ddelt + sqrt_ddelt*dTotalShock;
+			//as per formula
+		}
+	}
+}
 
-			for (l=0;l<=iN-(j+1);++l){ // l is the future steps
-				dTotalShock = 0;
+int HJM_SimPath_Forward_Blocking(FTYPE **ppdHJMPath,	//Matrix that stores generated HJM path (Output)
+		int iN,					//Number of time-steps
+		int iFactors,			//Number of factors in the HJM framework
+		FTYPE dYears,			//Number of years
+		FTYPE *pdForward,		//t=0 Forward curve
+		FTYPE *pdTotalDrift,	//Vector containing total drift corrections for different maturities
+		FTYPE **ppdFactors,	//Factor volatilities
+		long *lRndSeed,			//Random number seed
+		int BLOCKSIZE)
+{	
+	//This function computes and stores an HJM Path for given inputs
 
-				for (i=0;i<=iFactors-1;++i){// i steps through the stochastic factors
-					dTotalShock += ppdFactors[i][l]* pdZ[i][BLOCKSIZE*j + b];		  		
-				}	      	   
+	int iSuccess = 0;
+	FTYPE **pdZ; //vector to store random normals
+	FTYPE **randZ; //vector to store random normals
 
-				ppdHJMPath[j][BLOCKSIZE*l+b] = ppdHJMPath[j-1][BLOCKSIZE*(l+1)+b]+ pdTotalDrift[l]*ddelt + sqrt_ddelt*dTotalShock;
-				//as per formula
-			}
-		}
-	} // end Blocks
-	// -----------------------------------------------------
+	pdZ   = dmatrix(0, iFactors-1, 0, iN*BLOCKSIZE -1); //assigning memory
+	randZ = dmatrix(0, iFactors-1, 0, iN*BLOCKSIZE -1); //assigning memory
+
+	iSuccess = HJM_Z_Blocking(pdZ, randZ, iN, iFactors, lRndSeed, BLOCKSIZE);
+	if (iSuccess == 1)
+		iSuccess = HJM_SimPath_Forward_Blocking_Z(ppdHJMPath, iN, iFactors, dYears, pdForward, pdTotalDrift, ppdFactors, pdZ, BLOCKSIZE);
 
 	free_dmatrix(pdZ, 0, iFactors -1, 0, iN*BLOCKSIZE -1);
 	free_dmatrix(randZ, 0, iFactors -1, 0, iN*BLOCKSIZE -1);
-	iSuccess = 1;
 	return iSuccess;
 }
-
-
-
@@ -0,0 +1,29 @@
+//HJM_SimPath_avx2.cpp
+//AVX2 build of the lane-parallel path evolution in HJM_SimPath_kernels.h.
+//HJM_SimPath_Row() only calls it when -isa selected avx2 and
+//BLOCK_SIZE is a multiple of 4.
+
+#include "HJM_type.h"
+#include "HJM.h"
+
+#ifdef __AVX2__
+
+#include "HJM_SimPath_kernels.h"
+
+int HJM_Row_Evolve_avx2(FTYPE *pdRow, const FTYPE *pdPrev, int j, int iN, int iFactors, FTYPE ddelt,
+		FTYPE sqrt_ddelt, FTYPE *pdTotalDrift, FTYPE **ppdFactors, FTYPE **pdZ, int BLOCKSIZE)
+{
+	if (BLOCKSIZE % 4 != 0)
+		return 0;
+	return HJM_Row_Evolve<v4df>(pdRow, pdPrev, j, iN, iFactors, ddelt, sqrt_ddelt, pdTotalDrift, ppdFactors, pdZ, BLOCKSIZE);
+}
+
+#else
+
+int HJM_Row_Evolve_avx2(FTYPE *pdRow, const FTYPE *pdPrev, int j, int iN, int iFactors, FTYPE ddelt,
+		FTYPE sqrt_ddelt, FTYPE *pdTotalDrift, FTYPE **ppdFactors, FTYPE **pdZ, int BLOCKSIZE)
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,29 @@
+//HJM_SimPath_avx512.cpp
+//AVX-512 build of the lane-parallel path evolution in HJM_SimPath_kernels.h.
+//HJM_SimPath_Row() only calls it when -isa selected avx512 and
+//BLOCK_SIZE is a multiple of 8.
+
+#include "HJM_type.h"
+#include "HJM.h"
+
+#ifdef __AVX512F__
+
+#include "HJM_SimPath_kernels.h"
+
+int HJM_Row_Evolve_avx512(FTYPE *pdRow, const FTYPE *pdPrev, int j, int iN, int iFactors, FTYPE ddelt,
+		FTYPE sqrt_ddelt, FTYPE *pdTotalDrift, FTYPE **ppdFactors, FTYPE **pdZ, int BLOCKSIZE)
+{
+	if (BLOCKSIZE % 8 != 0)
+		return 0;
+	return HJM_Row_Evolve<v8df>(pdRow, pdPrev, j, iN, iFactors, ddelt, sqrt_ddelt, pdTotalDrift, ppdFactors, pdZ, BLOCKSIZE);
+}
+
+#else
+
+int HJM_Row_Evolve_avx512(FTYPE *pdRow, const FTYPE *pdPrev, int j, int iN, int iFactors, FTYPE ddelt,
+		FTYPE sqrt_ddelt, FTYPE *pdTotalDrift, FTYPE **ppdFactors, FTYPE **pdZ, int BLOCKSIZE)
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef __HJM_SIMPATH_KERNELS__
+#define __HJM_SIMPATH_KERNELS__
+
+// HJM path evolution with the block lane b as the SIMD lane: one V holds
+// paths b..b+W-1 of row[BLOCKSIZE*l + b], which the blocked layout already
+// keeps contiguous. Included by HJM_SimPath_avx2.cpp and
+// HJM_SimPath_avx512.cpp, each compiled for its own instruction set; with
+// -mfma the shock accumulation over factors becomes one FMA per factor.
+//
+// One call evolves one time step, so the same kernel serves the full path
+// matrix and the two-row window of HJM_Swaption_Payoffs_Rolling. The shocks
+// of a lane group stay in registers while the maturities l stream through
+// the factor loadings.
+
+#include <string.h>
+#include "icdf_kernels.h"	// v4df, v8df
+
+#define ROW_MAX_FACTORS 16
+
+template <class V>
+static inline int HJM_Row_Evolve(FTYPE *pdRow, const FTYPE *pdPrev, int j, int iN, int iFactors, FTYPE ddelt,
+		FTYPE sqrt_ddelt, FTYPE *pdTotalDrift, FTYPE **ppdFactors, FTYPE **pdZ, int BLOCKSIZE)
+{
+	const int W = sizeof(V)/sizeof(FTYPE);
+	V pvZ[ROW_MAX_FACTORS];
+	V vShock, vPrev;
+	int b, i, l;
+
+	if (iFactors > ROW_MAX_FACTORS)
+		return 0;
+	for (b=0; b<BLOCKSIZE; b+=W) {
+		for (i=0;i<=iFactors-1;++i)
+			memcpy(&pvZ[i], &pdZ[i][BLOCKSIZE*j + b], sizeof(V));
+		for (l=0;l<=iN-(j+1);++l){ // l is the future steps
+			vShock = V();
+			for (i=0;i<=iFactors-1;++i)// i steps through the stochastic factors
+				vShock += ppdFactors[i][l] * pvZ[i];
+			memcpy(&vPrev, &pdPrev[BLOCKSIZE*(l+1) + b], sizeof(V));
+			vPrev = vPrev + pdTotalDrift[l]*ddelt + sqrt_ddelt*vShock;
+			memcpy(&pdRow[BLOCKSIZE*l + b], &vPrev, sizeof(V));
+		}
+	}
+	return 1;
+}
+
+#endif //__HJM_SIMPATH_KERNELS__
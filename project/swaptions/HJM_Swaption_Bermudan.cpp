@@ -0,0 +1,380 @@
+//HJM_Swaption_Bermudan.cpp
+//Bermudan swaptions by Longstaff-Schwartz regression. The holder may enter
+//the remaining swap on every payment date from dMaturity up to the last
+//coupon before the end of the swap.
+//
+//The forward pass simulates the paths as HJM_Swaption_Payoffs_Rolling does
+//and keeps, for every exercise date, the swap value, the short rate and the
+//discount factor of each path: one contiguous row per date and quantity, so
+//the backward pass streams through them. The backward pass regresses the
+//discounted cash flows of the in-the-money paths on (1, V, V^2, r) by the
+//normal equations, solved with choldc, and exercises where the swap value
+//beats the fitted continuation value. Both passes run on nThreads workers
+//over LSM_CHUNKS fixed path chunks whose sums are merged in chunk order, so
+//the price does not depend on the number of threads.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "nr_routines.h"
+#include "HJM_Securities.h"
+#include "HJM.h"
+#include "HJM_type.h"
+#include "HJM_prof.h"
+#include "HJM_accum.h"
+#include "rng.h"
+
+#define LSM_BASIS 4		// 1, V, V^2, r
+#define LSM_SUMS (LSM_BASIS*LSM_BASIS + LSM_BASIS + 1)	// X'X, X'y, number of paths
+#define LSM_CHUNKS 64
+#define LSM_MAX_THREADS 1024
+
+typedef struct
+{
+	// the swaption
+	int iN;
+	int iFactors;
+	FTYPE dYears;
+	FTYPE *pdForward;
+	FTYPE *pdTotalDrift;
+	FTYPE **ppdFactors;
+	FTYPE *pdSwapPayoffs;		//as HJM_Swap_Payoffs, over the whole swap
+	int iSwapStartTimeIndex;
+	int iSwapTimePoints;
+	int iFreqRatio;
+	int nExercise;				//exercise date k is time step iSwapStartTimeIndex + k*iFreqRatio
+	long lSeed;
+	long nBlocks;
+	int BLOCKSIZE;
+
+	// per exercise date k and path p
+	FTYPE **ppdValue;			//swap value, fixed leg - 1
+	FTYPE **ppdRate;			//short rate
+	FTYPE **ppdDiscount;		//discount factor from t=0
+	FTYPE *pdCash;				//discounted cash flow of the exercise policy from date k on
+
+	// backward pass
+	int iDate;					//date whose exercise is decided in this pass
+	int bFit;					//pdBeta fits the continuation value at iDate
+	FTYPE pdBeta[LSM_BASIS];
+	FTYPE **ppdSums;			//regression sums of date iDate-1, one row per chunk
+
+	int (*pfnChunk)(void *, int);
+	int iNext;
+	int iSuccess;
+} lsm;
+
+static inline void lsm_basis(FTYPE *pdX, FTYPE dValue, FTYPE dRate)
+{
+	pdX[0] = 1.0;
+	pdX[1] = dValue;
+	pdX[2] = dValue*dValue;
+	pdX[3] = dRate;
+}
+
+static long lsm_chunk_first(const lsm *p, int c)
+{
+	return p->nBlocks*c/LSM_CHUNKS;
+}
+
+// Forward pass over the blocks of chunk c, with the seeds the serial loop would use
+static int lsm_forward(void *arg, int c)
+{
+	lsm *p = (lsm *)arg;
+	int iN = p->iN, iFactors = p->iFactors, BLOCKSIZE = p->BLOCKSIZE;
+	int iLastIndex = p->iSwapStartTimeIndex + (p->nExercise-1)*p->iFreqRatio;
+	long lFirst = lsm_chunk_first(p, c), lLast = lsm_chunk_first(p, c+1);
+	long lSeed = rng_skip(p->lSeed, lFirst, iN, iFactors, BLOCKSIZE);
+	FTYPE ddelt = (FTYPE)(p->dYears/iN);
+	FTYPE sqrt_ddelt = sqrt(ddelt);
+	FTYPE pdDiscount[BLOCKSIZE];
+	FTYPE *pdPrev, *pdRow, *pdTmp;
+	FTYPE dSwapDiscountFactor, dFixedLegValue;
+	int b, i, j, k;
+	long l, lPath;
+
+	if (lFirst == lLast)
+		return 1;
+
+	FTYPE **pdZ = dmatrix(0, iFactors-1, 0, iN*BLOCKSIZE-1);
+	FTYPE **randZ = dmatrix(0, iFactors-1, 0, iN*BLOCKSIZE-1);
+	FTYPE *pdRows = dvector(0, 2*iN*BLOCKSIZE-1);
+
+	for (l = lFirst; l < lLast; l++) {
+		HJM_Z_Blocking_Rows(pdZ, randZ, iN, iFactors, iLastIndex, &lSeed, BLOCKSIZE);
+
+		PROF_SCOPE(PROF_PATH);
+		pdPrev = pdRows;
+		pdRow = pdRows + iN*BLOCKSIZE;
+		for (i=0;i<=iN-1;i++)
+			for (b=0;b<BLOCKSIZE;b++)
+				pdPrev[BLOCKSIZE*i + b] = p->pdForward[i];
+		for (b=0;b<BLOCKSIZE;b++)
+			pdDiscount[b] = 1.0;
+
+		for (j=1, k=0;j<=iLastIndex;++j) {
+			for (b=0;b<BLOCKSIZE;b++)
+				pdDiscount[b] *= exp(-pdPrev[b]*ddelt);
+			HJM_SimPath_Row(pdRow, pdPrev, j, iN, iFactors, ddelt, sqrt_ddelt, p->pdTotalDrift, p->ppdFactors,
+					pdZ, BLOCKSIZE);
+			pdTmp = pdPrev; pdPrev = pdRow; pdRow = pdTmp;
+			if (j != p->iSwapStartTimeIndex + k*p->iFreqRatio)
+				continue;
+
+			//the coupons after date k, discounted along the curve at date k;
+			//the coupon paid on the date itself belongs to the previous period
+			for (b=0;b<BLOCKSIZE;b++) {
+				dFixedLegValue = 0.0;
+				dSwapDiscountFactor = 1.0;
+				for (i=1;i<=p->iSwapTimePoints - k*p->iFreqRatio;++i) {
+					dSwapDiscountFactor *= exp(-pdPrev[BLOCKSIZE*(i-1) + b]*ddelt);
+					dFixedLegValue += p->pdSwapPayoffs[i + k*p->iFreqRatio]*dSwapDiscountFactor;
+				}
+				lPath = l*BLOCKSIZE + b;
+				p->ppdValue[k][lPath] = dFixedLegValue - 1.0;
+				p->ppdRate[k][lPath] = pdPrev[b];
+				p->ppdDiscount[k][lPath] = pdDiscount[b];
+			}
+			k++;
+		}
+	}
+
+	free_dmatrix(pdZ, 0, iFactors-1, 0, iN*BLOCKSIZE-1);
+	free_dmatrix(randZ, 0, iFactors-1, 0, iN*BLOCKSIZE-1);
+	free_dvector(pdRows, 0, 2*iN*BLOCKSIZE-1);
+	return 1;
+}
+
+// Backward pass over the paths of chunk c: the exercise decision of date
+// iDate, then the regression sums of date iDate-1
+static int lsm_backward(void *arg, int c)
+{
+	lsm *p = (lsm *)arg;
+	long lFirst = lsm_chunk_first(p, c)*p->BLOCKSIZE, lLast = lsm_chunk_first(p, c+1)*p->BLOCKSIZE;
+	int k = p->iDate;
+	const FTYPE *pdValue = p->ppdValue[k], *pdRate = p->ppdRate[k], *pdDiscount = p->ppdDiscount[k];
+	FTYPE *pdCash = p->pdCash;
+	FTYPE *pdSums = p->ppdSums[c];
+	FTYPE pdX[LSM_BASIS];
+	FTYPE dCont, dY;
+	int r, s;
+	long l;
+
+	PROF_SCOPE(PROF_PAYOFF);
+	if (k == p->nExercise-1) {
+		for (l = lFirst; l < lLast; l++)
+			pdCash[l] = dMax(pdValue[l], 0)*pdDiscount[l];
+	} else if (p->bFit) {
+		for (l = lFirst; l < lLast; l++) {
+			if (pdValue[l] <= 0)
+				continue;
+			lsm_basis(pdX, pdValue[l], pdRate[l]);
+			dCont = 0.0;
+			for (r = 0; r < LSM_BASIS; r++)
+				dCont += p->pdBeta[r]*pdX[r];
+			if (pdValue[l] > dCont)
+				pdCash[l] = pdValue[l]*pdDiscount[l];
+		}
+	}
+
+	if (k == 0)
+		return 1;
+
+	//the cash flows seen from date k-1, on its in-the-money paths
+	pdValue = p->ppdValue[k-1];
+	pdRate = p->ppdRate[k-1];
+	pdDiscount = p->ppdDiscount[k-1];
+	for (s = 0; s < LSM_SUMS; s++)
+		pdSums[s] = 0.0;
+	for (l = lFirst; l < lLast; l++) {
+		if (pdValue[l] <= 0)
+			continue;
+		lsm_basis(pdX, pdValue[l], pdRate[l]);
+		dY = pdCash[l]/pdDiscount[l];
+		for (r = 0; r < LSM_BASIS; r++) {
+			for (s = r; s < LSM_BASIS; s++)
+				pdSums[LSM_BASIS*r + s] += pdX[r]*pdX[s];
+			pdSums[LSM_BASIS*LSM_BASIS + r] += pdX[r]*dY;
+		}
+		pdSums[LSM_SUMS-1] += 1.0;
+	}
+	return 1;
+}
+
+static void *lsm_worker(void *arg)
+{
+	lsm *p = (lsm *)arg;
+	int c;
+
+	while ((c = __atomic_fetch_add(&p->iNext, 1, __ATOMIC_RELAXED)) < LSM_CHUNKS)
+		if (!p->pfnChunk(p, c))
+			__atomic_store_n(&p->iSuccess, 0, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+// Runs pfnChunk on every chunk, on nThreads workers including the caller
+static int lsm_parallel(lsm *p, int (*pfnChunk)(void *, int), int nThreads)
+{
+	pthread_t threads[LSM_MAX_THREADS];
+	int t, nStarted = 0;
+
+	p->pfnChunk = pfnChunk;
+	p->iNext = 0;
+	for (t = 1; t < nThreads; t++, nStarted++)
+		if (pthread_create(&threads[t-1], NULL, lsm_worker, p) != 0)
+			break;
+	lsm_worker(p);
+	for (t = 0; t < nStarted; t++)
+		pthread_join(threads[t], NULL);
+	return p->iSuccess;
+}
+
+// Least squares fit of the continuation value of date iDate-1 from the chunk
+// sums of lsm_backward; no fit (never exercise there) if the system is singular
+static void lsm_fit(lsm *p)
+{
+	FTYPE **ppdA = dmatrix(1, LSM_BASIS, 1, LSM_BASIS);
+	FTYPE pdSums[LSM_SUMS], pdY[LSM_BASIS];
+	int c, r, s;
+
+	for (s = 0; s < LSM_SUMS; s++)
+		pdSums[s] = 0.0;
+	for (c = 0; c < LSM_CHUNKS; c++)
+		for (s = 0; s < LSM_SUMS; s++)
+			pdSums[s] += p->ppdSums[c][s];
+
+	for (r = 0; r < LSM_BASIS; r++)
+		for (s = r; s < LSM_BASIS; s++)
+			ppdA[r+1][s+1] = ppdA[s+1][r+1] = pdSums[LSM_BASIS*r + s];
+
+	p->bFit = pdSums[LSM_SUMS-1] >= LSM_BASIS && choldc(ppdA, LSM_BASIS);
+	if (p->bFit) {
+		//L L' beta = X'y, L in the lower triangle of ppdA
+		for (r = 0; r < LSM_BASIS; r++) {
+			pdY[r] = pdSums[LSM_BASIS*LSM_BASIS + r];
+			for (s = 0; s < r; s++)
+				pdY[r] -= ppdA[r+1][s+1]*pdY[s];
+			pdY[r] /= ppdA[r+1][r+1];
+		}
+		for (r = LSM_BASIS-1; r >= 0; r--) {
+			p->pdBeta[r] = pdY[r];
+			for (s = r+1; s < LSM_BASIS; s++)
+				p->pdBeta[r] -= ppdA[s+1][r+1]*p->pdBeta[s];
+			p->pdBeta[r] /= ppdA[r+1][r+1];
+		}
+	}
+	free_dmatrix(ppdA, 1, LSM_BASIS, 1, LSM_BASIS);
+}
+
+int HJM_Swaption_Bermudan(FTYPE *pdSwaptionPrice, //Output vector that will store simulation results in the form:
+		//Swaption Price
+		//Swaption Standard Error
+		//Swaption Parameters (see HJM_Swaption_Blocking); dMaturity is the first exercise date
+		FTYPE dStrike,
+		FTYPE dCompounding,
+		FTYPE dMaturity,
+		FTYPE dTenor,
+		FTYPE dPaymentInterval,
+		//HJM Framework Parameters
+		int iN,
+		int iFactors,
+		FTYPE dYears,
+		FTYPE *pdYield,
+		FTYPE **ppdFactors,
+		//Simulation Parameters
+		long iRndSeed,
+		long lTrials,
+		int BLOCKSIZE,
+		int nThreads)		//Workers over the paths
+{
+	int iSuccess = 0;
+	int k;
+	long l, lPaths;
+	lsm p;
+
+	FTYPE ddelt = (FTYPE)(dYears/iN);
+	FTYPE dStrikeCont;
+	if(dCompounding==0) {
+		dStrikeCont = dStrike;
+	} else {
+		dStrikeCont = (1/dCompounding)*log(1+dStrike*dCompounding);
+	}
+
+	memset(&p, 0, sizeof(p));
+	p.iN = iN;
+	p.iFactors = iFactors;
+	p.dYears = dYears;
+	p.ppdFactors = ppdFactors;
+	p.iFreqRatio = (int)(dPaymentInterval/ddelt + 0.5);
+	p.iSwapStartTimeIndex = (int)(dMaturity/ddelt + 0.5);
+	p.iSwapTimePoints = (int)(dTenor/ddelt + 0.5);
+	p.lSeed = iRndSeed;
+	p.nBlocks = (lTrials + BLOCKSIZE - 1)/BLOCKSIZE;
+	p.BLOCKSIZE = BLOCKSIZE;
+	p.iSuccess = 1;
+
+	if (p.iFreqRatio < 1 || p.iSwapStartTimeIndex < 1 || p.iSwapTimePoints < p.iFreqRatio
+			|| p.iSwapStartTimeIndex + p.iSwapTimePoints > iN) {
+		fprintf(stderr, "Error: the swap does not fit the HJM grid\n");
+		return 0;
+	}
+	if (nThreads < 1 || nThreads > LSM_MAX_THREADS) {
+		fprintf(stderr, "Error: number of threads must be between 1 and %d\n", LSM_MAX_THREADS);
+		return 0;
+	}
+	p.nExercise = (p.iSwapTimePoints - 1)/p.iFreqRatio + 1;
+	lPaths = p.nBlocks*BLOCKSIZE;
+
+	p.pdForward = dvector(0, iN-1);
+	p.pdTotalDrift = dvector(0, iN-2);
+	FTYPE **ppdDrifts = dmatrix(0, iFactors-1, 0, iN-2);
+	p.pdSwapPayoffs = dvector(0, p.iSwapTimePoints);
+	p.ppdValue = dmatrix(0, p.nExercise-1, 0, lPaths-1);
+	p.ppdRate = dmatrix(0, p.nExercise-1, 0, lPaths-1);
+	p.ppdDiscount = dmatrix(0, p.nExercise-1, 0, lPaths-1);
+	p.pdCash = dvector(0, lPaths-1);
+	p.ppdSums = dmatrix(0, LSM_CHUNKS-1, 0, LSM_SUMS-1);
+
+	iSuccess = HJM_Swap_Payoffs(p.pdSwapPayoffs, p.iSwapTimePoints+1, p.iSwapTimePoints, p.iFreqRatio,
+			dStrikeCont, dPaymentInterval);
+	if (iSuccess == 1)
+		iSuccess = HJM_Yield_to_Forward(p.pdForward, iN, pdYield);
+	if (iSuccess == 1)
+		iSuccess = HJM_Drifts(p.pdTotalDrift, ppdDrifts, iN, iFactors, dYears, ppdFactors);
+
+	//Simulations begin: every path to its last exercise date
+	if (iSuccess == 1)
+		iSuccess = lsm_parallel(&p, lsm_forward, nThreads);
+
+	//Backward induction, from the last exercise date where the swap is always entered if in the money
+	for (k = p.nExercise-1; k >= 0 && iSuccess == 1; k--) {
+		p.iDate = k;
+		iSuccess = lsm_parallel(&p, lsm_backward, nThreads);
+		if (iSuccess == 1 && k > 0)
+			lsm_fit(&p);
+	}
+
+	// Simulation Results Stored
+	if (iSuccess == 1) {
+		ksum dSumSimSwaptionPrice, dSumSquareSimSwaptionPrice;
+		memset(&dSumSimSwaptionPrice, 0, sizeof(ksum));
+		memset(&dSumSquareSimSwaptionPrice, 0, sizeof(ksum));
+		for (l = 0; l < lPaths; l += BLOCKSIZE)
+			HJM_Swaption_Accumulate(&dSumSimSwaptionPrice, &dSumSquareSimSwaptionPrice, p.pdCash + l, BLOCKSIZE);
+		HJM_Swaption_Result(pdSwaptionPrice, &dSumSimSwaptionPrice, &dSumSquareSimSwaptionPrice, lPaths);
+	}
+
+	free_dvector(p.pdForward, 0, iN-1);
+	free_dvector(p.pdTotalDrift, 0, iN-2);
+	free_dmatrix(ppdDrifts, 0, iFactors-1, 0, iN-2);
+	free_dvector(p.pdSwapPayoffs, 0, p.iSwapTimePoints);
+	free_dmatrix(p.ppdValue, 0, p.nExercise-1, 0, lPaths-1);
+	free_dmatrix(p.ppdRate, 0, p.nExercise-1, 0, lPaths-1);
+	free_dmatrix(p.ppdDiscount, 0, p.nExercise-1, 0, lPaths-1);
+	free_dvector(p.pdCash, 0, lPaths-1);
+	free_dmatrix(p.ppdSums, 0, LSM_CHUNKS-1, 0, LSM_SUMS-1);
+
+	return iSuccess;
+}
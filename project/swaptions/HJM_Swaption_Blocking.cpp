@@ -5,13 +5,16 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include "nr_routines.h"
 #include "HJM_Securities.h"
 #include "HJM.h"
 #include "HJM_type.h"
+#include "HJM_prof.h"
+#include "HJM_accum.h"
 
-int HJM_Swaption_Blocking(FTYPE *pdSwaptionPrice, //Output vector that will store simulation results in the form:
+int HJM_Swaption_Simulate(FTYPE *pdSwaptionPrice, //Output vector that will store simulation results in the form:
 		//Swaption Price
 		//Swaption Standard Error
 		//Swaption Parameters 
@@ -31,12 +34,12 @@ int HJM_Swaption_Blocking(FTYPE *pdSwaptionPrice, //Output vector that will stor
 		//Simulation Parameters
 		long iRndSeed, 
 		long lTrials,
-		int BLOCKSIZE, int tid)
-
+		int BLOCKSIZE,
+		swaption_state *pState,	//Progress (In/Out): the simulation continues from pState and
+		//publishes every completed block back to it, see HJM_Publish_State
+		int bPipeline)		//Overlap the blocks in the TBB pipeline (HAVE_TBB builds only)
 {
 	int iSuccess = 0;
-	int i; 
-	int b; //block looping variable
 	long l; //looping variables
 
 	FTYPE ddelt = (FTYPE)(dYears/iN);				//ddelt = HJM matrix time-step width. e.g. if dYears = 5yrs and
@@ -62,76 +65,53 @@ int HJM_Swaption_Blocking(FTYPE *pdSwaptionPrice, //Output vector that will stor
 	//HJM Framework vectors and matrices
 	int iSwapVectorLength;  // Length of the HJM rate path at the time index corresponding to swaption maturity.
 
-	FTYPE **ppdHJMPath;    // **** per Trial data **** //
-
 	FTYPE *pdForward;
 	FTYPE **ppdDrifts; 
 	FTYPE *pdTotalDrift;
 
 	// *******************************
-	// ppdHJMPath = dmatrix(0,iN-1,0,iN-1);
-	ppdHJMPath = dmatrix(0,iN-1,0,iN*BLOCKSIZE-1);    // **** per Trial data **** //
 	pdForward = dvector(0, iN-1);
 	ppdDrifts = dmatrix(0, iFactors-1, 0, iN-2);
 	pdTotalDrift = dvector(0, iN-2);
 
 	//==================================
 	// **** per Trial data **** //
-	FTYPE *pdDiscountingRatePath;	  //vector to store rate path along which the swaption payoff will be discounted
-	FTYPE *pdPayoffDiscountFactors;  //vector to store discount factors for the rate path along which the swaption 
-	//payoff will be discounted
-	FTYPE *pdSwapRatePath;			  //vector to store the rate path along which the swap payments made will be discounted	
-	FTYPE *pdSwapDiscountFactors;	  //vector to store discount factors for the rate path along which the swap
-	//payments made will be discounted	
+	// O(iN) per block: the path is evolved in a two-row window (HJM_Swaption_Payoffs_Rolling)
+	FTYPE **pdZ;					  //random normals of the block
+	FTYPE **randZ;					  //uniform draws of the block
+	FTYPE *pdRows;					  //current and previous time step of the paths
+	FTYPE pdDiscPayoffs[BLOCKSIZE];
 	FTYPE *pdSwapPayoffs;			  //vector to store swap payoffs
 
 
 	int iSwapStartTimeIndex;
 	int iSwapTimePoints;
-	FTYPE dSwapVectorYears;
-
-	FTYPE dSwaptionPayoff;
-	FTYPE dDiscSwaptionPayoff;
-	FTYPE dFixedLegValue;
 
 	// Accumulators
-	FTYPE dSumSimSwaptionPrice; 
-	FTYPE dSumSquareSimSwaptionPrice;
-
-	// Final returned results
-	FTYPE dSimSwaptionMeanPrice;
-	FTYPE dSimSwaptionStdError;
+	ksum dSumSimSwaptionPrice; 
+	ksum dSumSquareSimSwaptionPrice;
 
 	// *******************************
-	pdPayoffDiscountFactors = dvector(0, iN*BLOCKSIZE-1);
-	pdDiscountingRatePath = dvector(0, iN*BLOCKSIZE-1);
+	pdZ = dmatrix(0, iFactors-1, 0, iN*BLOCKSIZE-1);
+	randZ = dmatrix(0, iFactors-1, 0, iN*BLOCKSIZE-1);
+	pdRows = dvector(0, 2*iN*BLOCKSIZE-1);
 	// *******************************
 
 	iSwapVectorLength = (int) (iN - dMaturity/ddelt + 0.5);	//This is the length of the HJM rate path at the time index
 	//corresponding to swaption maturity.
 	// *******************************
-	pdSwapRatePath = dvector(0, iSwapVectorLength*BLOCKSIZE - 1);
-	pdSwapDiscountFactors  = dvector(0, iSwapVectorLength*BLOCKSIZE - 1);
-	// *******************************
 	pdSwapPayoffs = dvector(0, iSwapVectorLength - 1);
 
 
 	iSwapStartTimeIndex = (int) (dMaturity/ddelt + 0.5);	//Swap starts at swaption maturity
 	iSwapTimePoints = (int) (dTenor/ddelt + 0.5);			//Total HJM time points corresponding to the swap's tenor
-	dSwapVectorYears = (FTYPE) (iSwapVectorLength*ddelt);
 
 
 
 	//now we store the swap payoffs in the swap payoff vector
-	for (i=0;i<=iSwapVectorLength-1;++i)
-		pdSwapPayoffs[i] = 0.0; //initializing to zero
-	for (i=iFreqRatio;i<=iSwapTimePoints;i+=iFreqRatio)
-	{
-		if(i != iSwapTimePoints)
-			pdSwapPayoffs[i] = exp(dStrikeCont*dPaymentInterval) - 1; //the bond pays coupon equal to this amount
-		if(i == iSwapTimePoints)
-			pdSwapPayoffs[i] = exp(dStrikeCont*dPaymentInterval); //at terminal time point, bond pays coupon plus par amount
-	}
+	iSuccess = HJM_Swap_Payoffs(pdSwapPayoffs, iSwapVectorLength, iSwapTimePoints, iFreqRatio, dStrikeCont, dPaymentInterval);
+	if (iSuccess!=1)
+		return iSuccess;
 
 	//generating forward curve at t=0 from supplied yield curve
 	iSuccess = HJM_Yield_to_Forward(pdForward, iN, pdYield);
@@ -143,15 +123,107 @@ int HJM_Swaption_Blocking(FTYPE *pdSwaptionPrice, //Output vector that will stor
 	if (iSuccess!=1)
 		return iSuccess;
 
-	dSumSimSwaptionPrice = 0.0;
-	dSumSquareSimSwaptionPrice = 0.0;
+	//a fresh state starts from iRndSeed, a restored one where it left off
+	dSumSimSwaptionPrice = pState->sum;
+	dSumSquareSimSwaptionPrice = pState->sumSquare;
+	if (pState->lTrialsDone > 0)
+		iRndSeed = pState->lRndSeed;
 
 	//Simulations begin:
-	for (l=0;l<=lTrials-1;l+=BLOCKSIZE) {
-		//For each trial a new HJM Path is generated
-		iSuccess = HJM_SimPath_Forward_Blocking(ppdHJMPath, iN, iFactors, dYears, pdForward, pdTotalDrift,ppdFactors, &iRndSeed, BLOCKSIZE); /* GC: 51% of the time goes here */
+#ifdef HAVE_TBB
+	//the blocks overlap in a pipeline of the stages below (HJM_Swaption_Pipeline.cpp)
+	if (bPipeline) {
+		iSuccess = HJM_Swaption_Pipeline(&dSumSimSwaptionPrice, &dSumSquareSimSwaptionPrice, &iRndSeed,
+				pState->lTrialsDone, lTrials, pState, iN, iFactors, dYears, pdForward, pdTotalDrift, ppdFactors,
+				pdSwapPayoffs, iSwapVectorLength, iSwapStartTimeIndex, BLOCKSIZE);
 		if (iSuccess!=1)
 			return iSuccess;
+	} else
+#else
+	(void)bPipeline;
+#endif
+	for (l=pState->lTrialsDone;l<=lTrials-1;l+=BLOCKSIZE) {
+		//For each trial a new HJM Path is generated, up to swaption maturity
+		iSuccess = HJM_Z_Blocking_Rows(pdZ, randZ, iN, iFactors, iSwapStartTimeIndex, &iRndSeed, BLOCKSIZE);
+		if (iSuccess!=1)
+			return iSuccess;
+
+		//and discounted while it is generated
+		iSuccess = HJM_Swaption_Payoffs_Rolling(pdDiscPayoffs, iN, iFactors, dYears, pdForward, pdTotalDrift,
+				ppdFactors, pdZ, pdSwapPayoffs, iSwapVectorLength, iSwapStartTimeIndex, pdRows, BLOCKSIZE); /* GC: 51% of the time goes here */
+		if (iSuccess!=1)
+			return iSuccess;
+
+		HJM_Swaption_Accumulate(&dSumSimSwaptionPrice, &dSumSquareSimSwaptionPrice, pdDiscPayoffs, BLOCKSIZE);
+		HJM_Publish_State(pState, 0, l + BLOCKSIZE, iRndSeed, &dSumSimSwaptionPrice, &dSumSquareSimSwaptionPrice);
+	}
+	HJM_Publish_State(pState, 1, lTrials, iRndSeed, &dSumSimSwaptionPrice, &dSumSquareSimSwaptionPrice);
+
+	// Simulation Results Stored
+	HJM_Swaption_Result(pdSwaptionPrice, &dSumSimSwaptionPrice, &dSumSquareSimSwaptionPrice, lTrials);
+
+	free_dvector(pdForward, 0, iN-1);
+	free_dmatrix(ppdDrifts, 0, iFactors-1, 0, iN-2);
+	free_dvector(pdTotalDrift, 0, iN-2);
+	free_dmatrix(pdZ, 0, iFactors-1, 0, iN*BLOCKSIZE-1);
+	free_dmatrix(randZ, 0, iFactors-1, 0, iN*BLOCKSIZE-1);
+	free_dvector(pdRows, 0, 2*iN*BLOCKSIZE-1);
+	free_dvector(pdSwapPayoffs, 0, iSwapVectorLength - 1);
+
+	iSuccess = 1;
+	return iSuccess;
+}
+
+int HJM_Swap_Payoffs(FTYPE *pdSwapPayoffs,	//Output vector of swap payments along the swap path
+		int iSwapVectorLength,		//Length of the HJM rate path at swaption maturity
+		int iSwapTimePoints,		//Total HJM time points corresponding to the swap's tenor
+		int iFreqRatio,				//HJM time steps between two swap payments
+		FTYPE dStrikeCont,			//Strike in continuous compounding convention
+		FTYPE dPaymentInterval)		//Time between two swap payments
+{
+	int i;
+
+	for (i=0;i<=iSwapVectorLength-1;++i)
+		pdSwapPayoffs[i] = 0.0; //initializing to zero
+	for (i=iFreqRatio;i<=iSwapTimePoints;i+=iFreqRatio)
+	{
+		if(i != iSwapTimePoints)
+			pdSwapPayoffs[i] = exp(dStrikeCont*dPaymentInterval) - 1; //the bond pays coupon equal to this amount
+		if(i == iSwapTimePoints)
+			pdSwapPayoffs[i] = exp(dStrikeCont*dPaymentInterval); //at terminal time point, bond pays coupon plus par amount
+	}
+
+	return 1;
+}
+
+int HJM_Swaption_Payoffs_Blocking(FTYPE *pdDiscPayoffs,	//Output: discounted swaption payoff of each path of the block
+		FTYPE **ppdHJMPath,			//HJM paths of one block, as generated by HJM_SimPath_Forward_Blocking
+		int iN,
+		FTYPE dYears,
+		FTYPE *pdSwapPayoffs,		//Swap payments, as generated by HJM_Swap_Payoffs
+		int iSwapVectorLength,
+		int iSwapStartTimeIndex,
+		//per Trial scratch vectors
+		FTYPE *pdDiscountingRatePath,
+		FTYPE *pdPayoffDiscountFactors,
+		FTYPE *pdSwapRatePath,
+		FTYPE *pdSwapDiscountFactors,
+		int BLOCKSIZE)
+{
+	//This function discounts the swaption payoffs of one block of paths
+
+	int iSuccess = 0;
+	int i;
+	int b; //block looping variable
+
+	FTYPE ddelt = (FTYPE)(dYears/iN);
+	FTYPE dSwapVectorYears = (FTYPE) (iSwapVectorLength*ddelt);
+
+	FTYPE dSwaptionPayoff;
+	FTYPE dFixedLegValue;
+
+	{
+		PROF_SCOPE(PROF_DISCOUNT);
 
 		//now we compute the discount factor vector
 
@@ -175,37 +247,182 @@ int HJM_Swaption_Blocking(FTYPE *pdSwaptionPrice, //Output vector that will stor
 		iSuccess = Discount_Factors_Blocking(pdSwapDiscountFactors, iSwapVectorLength, dSwapVectorYears, pdSwapRatePath, BLOCKSIZE);
 		if (iSuccess!=1)
 			return iSuccess;
+	}
 
 
-		// ========================
-		// Simulation
-		for (b=0;b<BLOCKSIZE;b++){
-			dFixedLegValue = 0.0;
-			for (i=0;i<=iSwapVectorLength-1;++i){
-				dFixedLegValue += pdSwapPayoffs[i]*pdSwapDiscountFactors[i*BLOCKSIZE + b];
-			}
-			dSwaptionPayoff = dMax(dFixedLegValue - 1.0, 0);
+	// ========================
+	// Simulation
+	PROF_SCOPE(PROF_PAYOFF);
+	for (b=0;b<BLOCKSIZE;b++){
+		dFixedLegValue = 0.0;
+		for (i=0;i<=iSwapVectorLength-1;++i){
+			dFixedLegValue += pdSwapPayoffs[i]*pdSwapDiscountFactors[i*BLOCKSIZE + b];
+		}
+		dSwaptionPayoff = dMax(dFixedLegValue - 1.0, 0);
 
-			dDiscSwaptionPayoff = dSwaptionPayoff*pdPayoffDiscountFactors[iSwapStartTimeIndex*BLOCKSIZE + b];
+		pdDiscPayoffs[b] = dSwaptionPayoff*pdPayoffDiscountFactors[iSwapStartTimeIndex*BLOCKSIZE + b];
+	} // END BLOCK simulation
 
-			// ========= end simulation ======================================
+	iSuccess = 1;
+	return iSuccess;
+}
+
+int HJM_Swaption_Payoffs_Rolling(FTYPE *pdDiscPayoffs,	//Output: discounted swaption payoff of each path of the block
+		int iN,
+		int iFactors,
+		FTYPE dYears,
+		FTYPE *pdForward,			//t=0 Forward curve
+		FTYPE *pdTotalDrift,		//Drift corrections, as from HJM_Drifts
+		FTYPE **ppdFactors,			//Factor volatilities
+		FTYPE **pdZ,				//Random normals of time steps 1..iSwapStartTimeIndex (HJM_Z_Blocking_Rows)
+		FTYPE *pdSwapPayoffs,		//Swap payments, as generated by HJM_Swap_Payoffs
+		int iSwapVectorLength,
+		int iSwapStartTimeIndex,
+		FTYPE *pdRows,				//Scratch: two time steps of the paths, 2*iN*BLOCKSIZE
+		int BLOCKSIZE)
+{
+	//This function computes the same discounted payoffs as HJM_SimPath_Forward_Blocking_Z
+	//followed by HJM_Swaption_Payoffs_Blocking, bit for bit, without storing the path:
+	//time step j is evolved from j-1 only up to swaption maturity, the short rate of
+	//every step is folded into the payoff discount factor as the step goes by, and
+	//the swap is discounted along the last step. Memory is O(iN) instead of O(iN^2)
+	//and the work stops at maturity.
+
+	FTYPE ddelt = (FTYPE)(dYears/iN);
+	FTYPE sqrt_ddelt = sqrt(ddelt);
+	FTYPE dSwapVectorYears = (FTYPE) (iSwapVectorLength*ddelt);
+	FTYPE dSwapDelt = (FTYPE) (dSwapVectorYears/iSwapVectorLength);	//as Discount_Factors_Blocking
+	FTYPE *pdPrev = pdRows, *pdRow = pdRows + iN*BLOCKSIZE, *pdTmp;
+	FTYPE pdPayoffDiscountFactor[BLOCKSIZE];
+	FTYPE dSwapDiscountFactor, dFixedLegValue;
+	int b, i, j;
+
+	if (iSwapStartTimeIndex < 0 || iSwapStartTimeIndex > iN-1)
+		return 0;
+
+	{
+		PROF_SCOPE(PROF_PATH);
 
-			// accumulate into the aggregating variables =====================
-			dSumSimSwaptionPrice += dDiscSwaptionPayoff;
-			dSumSquareSimSwaptionPrice += dDiscSwaptionPayoff*dDiscSwaptionPayoff;
-		} // END BLOCK simulation
+		// t=0 forward curve
+		for (i=0;i<=iN-1;i++)
+			for (b=0;b<BLOCKSIZE;b++)
+				pdPrev[BLOCKSIZE*i + b] = pdForward[i];
+	}
+	for (b=0;b<BLOCKSIZE;b++)
+		pdPayoffDiscountFactor[b] = 1.0;
+
+	for (j=1;j<=iSwapStartTimeIndex;++j) {
+		{
+			PROF_SCOPE(PROF_DISCOUNT);
+			//short rate of step j-1 before its row is reused
+			for (b=0;b<BLOCKSIZE;b++)
+				pdPayoffDiscountFactor[b] *= exp(-pdPrev[b]*ddelt);
+		}
+		PROF_SCOPE(PROF_PATH);
+		HJM_SimPath_Row(pdRow, pdPrev, j, iN, iFactors, ddelt, sqrt_ddelt, pdTotalDrift, ppdFactors, pdZ, BLOCKSIZE);
+		pdTmp = pdPrev; pdPrev = pdRow; pdRow = pdTmp;
 	}
 
-	// Simulation Results Stored
-	dSimSwaptionMeanPrice = dSumSimSwaptionPrice/lTrials;
-	dSimSwaptionStdError = sqrt((dSumSquareSimSwaptionPrice-dSumSimSwaptionPrice*dSumSimSwaptionPrice/lTrials)/
-			(lTrials-1.0))/sqrt((FTYPE)lTrials);
+	// pdPrev is the forward curve at swaption maturity
+	PROF_SCOPE(PROF_PAYOFF);
+	for (b=0;b<BLOCKSIZE;b++){
+		dFixedLegValue = 0.0;
+		dSwapDiscountFactor = 1.0;
+		for (i=0;i<=iSwapVectorLength-1;++i){
+			dFixedLegValue += pdSwapPayoffs[i]*dSwapDiscountFactor;
+			dSwapDiscountFactor *= exp(-pdPrev[BLOCKSIZE*i + b]*dSwapDelt);
+		}
+		pdDiscPayoffs[b] = dMax(dFixedLegValue - 1.0, 0)*pdPayoffDiscountFactor[b];
+	}
+	return 1;
+}
 
-	//results returned
-	pdSwaptionPrice[0] = dSimSwaptionMeanPrice;
-	pdSwaptionPrice[1] = dSimSwaptionStdError;
+int HJM_Swaption_Payoff_Blocking(ksum *pSumSimSwaptionPrice,	//Accumulator of discounted payoffs (In/Out)
+		ksum *pSumSquareSimSwaptionPrice,	//Accumulator of squared discounted payoffs (In/Out)
+		FTYPE **ppdHJMPath,			//HJM paths of one block, as generated by HJM_SimPath_Forward_Blocking
+		int iN,
+		FTYPE dYears,
+		FTYPE *pdSwapPayoffs,		//Swap payments, as generated by HJM_Swap_Payoffs
+		int iSwapVectorLength,
+		int iSwapStartTimeIndex,
+		//per Trial scratch vectors
+		FTYPE *pdDiscountingRatePath,
+		FTYPE *pdPayoffDiscountFactors,
+		FTYPE *pdSwapRatePath,
+		FTYPE *pdSwapDiscountFactors,
+		int BLOCKSIZE)
+{
+	//This function discounts the swaption payoffs of one block of paths and
+	//accumulates them into the aggregating variables
 
-	iSuccess = 1;
-	return iSuccess;
+	FTYPE pdDiscPayoffs[BLOCKSIZE];
+	int iSuccess = HJM_Swaption_Payoffs_Blocking(pdDiscPayoffs, ppdHJMPath, iN, dYears, pdSwapPayoffs,
+			iSwapVectorLength, iSwapStartTimeIndex, pdDiscountingRatePath, pdPayoffDiscountFactors,
+			pdSwapRatePath, pdSwapDiscountFactors, BLOCKSIZE);
+	if (iSuccess!=1)
+		return iSuccess;
+
+	// accumulate into the aggregating variables =====================
+	HJM_Swaption_Accumulate(pSumSimSwaptionPrice, pSumSquareSimSwaptionPrice, pdDiscPayoffs, BLOCKSIZE);
+	return 1;
+}
+
+void HJM_Swaption_Accumulate(ksum *pSumSimSwaptionPrice, ksum *pSumSquareSimSwaptionPrice,
+		FTYPE *pdDiscPayoffs, int BLOCKSIZE)
+{
+	//Path order, so every schedule of the blocks gives the same sums
+	for (int b=0;b<BLOCKSIZE;b++){
+		ksum_add(pSumSimSwaptionPrice, pdDiscPayoffs[b]);
+		ksum_add(pSumSquareSimSwaptionPrice, pdDiscPayoffs[b]*pdDiscPayoffs[b]);
+	}
+}
+
+void HJM_Swaption_Result(FTYPE *pdSwaptionPrice,	//Output: price and standard error
+		const ksum *pSum, const ksum *pSumSquare, long lTrials)
+{
+	FTYPE dSum = ksum_value(pSum);
+	FTYPE dSumSquare = ksum_value(pSumSquare);
+
+	pdSwaptionPrice[0] = dSum/lTrials;
+	pdSwaptionPrice[1] = sqrt((dSumSquare-dSum*dSum/lTrials)/(lTrials-1.0))/sqrt((FTYPE)lTrials);
+}
+
+int HJM_Swaption_Blocking_Resume(FTYPE *pdSwaptionPrice, FTYPE dStrike, FTYPE dCompounding, FTYPE dMaturity,
+		FTYPE dTenor, FTYPE dPaymentInterval, int iN, int iFactors, FTYPE dYears, FTYPE *pdYield,
+		FTYPE **ppdFactors, long iRndSeed, long lTrials, int BLOCKSIZE, swaption_state *pState)
+{
+	//HJM_Swaption_Simulate with the simulation loop of the make version
+#ifdef TBB_VERSION
+	int bPipeline = 1;
+#else
+	int bPipeline = 0;
+#endif
+	return HJM_Swaption_Simulate(pdSwaptionPrice, dStrike, dCompounding, dMaturity, dTenor, dPaymentInterval,
+			iN, iFactors, dYears, pdYield, ppdFactors, iRndSeed, lTrials, BLOCKSIZE, pState, bPipeline);
 }
 
+int HJM_Swaption_Blocking(FTYPE *pdSwaptionPrice, FTYPE dStrike, FTYPE dCompounding, FTYPE dMaturity, FTYPE dTenor,
+		FTYPE dPaymentInterval, int iN, int iFactors, FTYPE dYears, FTYPE *pdYield, FTYPE **ppdFactors,
+		long iRndSeed, long lTrials, int BLOCKSIZE, int tid)
+{
+	//Prices a swaption from scratch, see HJM_Swaption_Blocking_Resume
+	swaption_state state;
+
+	memset(&state, 0, sizeof(state));
+	return HJM_Swaption_Blocking_Resume(pdSwaptionPrice, dStrike, dCompounding, dMaturity, dTenor,
+			dPaymentInterval, iN, iFactors, dYears, pdYield, ppdFactors, iRndSeed, lTrials, BLOCKSIZE, &state);
+}
+
+void HJM_Publish_State(swaption_state *pState, int iDone, long lTrialsDone, long lRndSeed,
+		const ksum *pSum, const ksum *pSumSquare)
+{
+	//Seqlock write: readers retry while uSeq is odd or has moved
+	__atomic_store_n(&pState->uSeq, pState->uSeq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	pState->iDone = iDone;
+	pState->lTrialsDone = lTrialsDone;
+	pState->lRndSeed = lRndSeed;
+	pState->sum = *pSum;
+	pState->sumSquare = *pSumSquare;
+	__atomic_store_n(&pState->uSeq, pState->uSeq + 1, __ATOMIC_RELEASE);
+}
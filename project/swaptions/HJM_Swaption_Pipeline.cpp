@@ -0,0 +1,122 @@
+//HJM_Swaption_Pipeline.cpp
+//Simulation loop of HJM_Swaption_Simulate in builds with TBB (HAVE_TBB).
+//Blocks of paths flow through a tbb::parallel_pipeline:
+//
+//  uniforms -> inverse normal -> path evolution and payoff -> sums
+//  (serial)    (parallel)        (parallel)                   (serial)
+//
+//so different blocks are in different stages at the same time while each
+//block's data stays in the cache of the thread working on it. At most
+//PIPELINE_TOKENS blocks are in flight. The first and last stages run in
+//block order, so the seed sequence and the sums are exactly those of the
+//serial loop.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "nr_routines.h"
+#include "HJM.h"
+#include "HJM_type.h"
+#include "HJM_prof.h"
+#include "rng.h"
+
+#ifdef HAVE_TBB
+
+#include "HJM_tbb.h"
+
+#ifndef PIPELINE_TOKENS
+#define PIPELINE_TOKENS 4
+#endif
+
+typedef struct
+{
+	long lTrial;		// first trial of the block
+	long lRndSeed;		// seed after the block's draws
+	int iSuccess;
+	FTYPE **randZ;
+	FTYPE **pdZ;
+	FTYPE *pdRows;				// two-row path window (HJM_Swaption_Payoffs_Rolling)
+	FTYPE *pdDiscPayoffs;
+} pipeline_block;
+
+int HJM_Swaption_Pipeline(ksum *pSum,	//Accumulator of discounted payoffs (In/Out)
+		ksum *pSumSquare,			//Accumulator of squared discounted payoffs (In/Out)
+		long *plRndSeed,			//Random number seed (In/Out)
+		long lFirstTrial,			//Trials already done (resume)
+		long lTrials,
+		swaption_state *pState,		//Progress, published after every block
+		int iN,
+		int iFactors,
+		FTYPE dYears,
+		FTYPE *pdForward,
+		FTYPE *pdTotalDrift,
+		FTYPE **ppdFactors,
+		FTYPE *pdSwapPayoffs,
+		int iSwapVectorLength,
+		int iSwapStartTimeIndex,
+		int BLOCKSIZE)
+{
+	pipeline_block blocks[PIPELINE_TOKENS];
+	long lNext = lFirstTrial;
+	long lBlock = 0;
+	int iSuccess = 1;
+	int k;
+
+	for (k = 0; k < PIPELINE_TOKENS; k++) {
+		blocks[k].randZ = dmatrix(0, iFactors-1, 0, iN*BLOCKSIZE-1);
+		blocks[k].pdZ = dmatrix(0, iFactors-1, 0, iN*BLOCKSIZE-1);
+		blocks[k].pdRows = dvector(0, 2*iN*BLOCKSIZE-1);
+		blocks[k].pdDiscPayoffs = dvector(0, BLOCKSIZE-1);
+	}
+
+	// Blocks complete in order, so while block n is in the first stage block
+	// n - PIPELINE_TOKENS has left the last one: slot n % PIPELINE_TOKENS is free.
+	tbb::parallel_pipeline(PIPELINE_TOKENS,
+		tbb::make_filter<void, pipeline_block*>(HJM_TBB_SERIAL,
+			[&](tbb::flow_control &fc) -> pipeline_block* {
+				if (lNext > lTrials-1) {
+					fc.stop();
+					return NULL;
+				}
+				pipeline_block *p = &blocks[lBlock++ % PIPELINE_TOKENS];
+				PROF_SCOPE(PROF_RNG);
+				p->lTrial = lNext;
+				lNext += BLOCKSIZE;
+				rng_uniform(p->randZ, iN, iFactors, plRndSeed, BLOCKSIZE);
+				p->lRndSeed = *plRndSeed;
+				p->iSuccess = 1;
+				return p;
+			}) &
+		tbb::make_filter<pipeline_block*, pipeline_block*>(HJM_TBB_PARALLEL,
+			[&](pipeline_block *p) -> pipeline_block* {
+				PROF_SCOPE(PROF_ICDF);
+				// only the time steps up to swaption maturity are evolved
+				serialB(p->pdZ, p->randZ, BLOCKSIZE, iSwapStartTimeIndex+1, iFactors);
+				return p;
+			}) &
+		tbb::make_filter<pipeline_block*, pipeline_block*>(HJM_TBB_PARALLEL,
+			[&](pipeline_block *p) -> pipeline_block* {
+				p->iSuccess = HJM_Swaption_Payoffs_Rolling(p->pdDiscPayoffs, iN, iFactors, dYears, pdForward,
+						pdTotalDrift, ppdFactors, p->pdZ, pdSwapPayoffs, iSwapVectorLength, iSwapStartTimeIndex,
+						p->pdRows, BLOCKSIZE);
+				return p;
+			}) &
+		tbb::make_filter<pipeline_block*, void>(HJM_TBB_SERIAL,
+			[&](pipeline_block *p) {
+				if (p->iSuccess != 1 || iSuccess != 1) {
+					iSuccess = p->iSuccess == 1 ? iSuccess : p->iSuccess;
+					return;
+				}
+				HJM_Swaption_Accumulate(pSum, pSumSquare, p->pdDiscPayoffs, BLOCKSIZE);
+				HJM_Publish_State(pState, 0, p->lTrial + BLOCKSIZE, p->lRndSeed, pSum, pSumSquare);
+			}));
+
+	for (k = 0; k < PIPELINE_TOKENS; k++) {
+		free_dmatrix(blocks[k].randZ, 0, iFactors-1, 0, iN*BLOCKSIZE-1);
+		free_dmatrix(blocks[k].pdZ, 0, iFactors-1, 0, iN*BLOCKSIZE-1);
+		free_dvector(blocks[k].pdRows, 0, 2*iN*BLOCKSIZE-1);
+		free_dvector(blocks[k].pdDiscPayoffs, 0, BLOCKSIZE-1);
+	}
+	return iSuccess;
+}
+
+#endif // HAVE_TBB
@@ -0,0 +1,223 @@
+//HJM_Swaption_Scenarios.cpp
+//Bump-and-reval pricing of one swaption under a batch of curve/vol scenarios.
+//All scenarios are evaluated on the same random normals (common random numbers),
+//so the differences between scenario prices carry far less noise than
+//independent re-runs would.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "nr_routines.h"
+#include "HJM_Securities.h"
+#include "HJM.h"
+#include "HJM_type.h"
+
+#define MAX_SCENARIOS 4096
+
+int HJM_Read_Scenarios(const char *pszFile, //Scenario file, one scenario per line:
+		//  <name> <bucket> <shift in bp> <vol scale>
+		//bucket -1 shifts the whole curve, the caller checks the others against
+		//the grid; lines starting with '#' are ignored
+		scen **ppScen)
+{
+	//This function reads a scenario file and returns the number of scenarios read (0 on failure)
+
+	FILE *fp;
+	char szLine[256];
+	scen *pScen;
+	int iScen = 0;
+	FTYPE dShiftBp;
+
+	fp = fopen(pszFile, "r");
+	if (!fp) {
+		fprintf(stderr, "Error: cannot open scenario file %s\n", pszFile);
+		return 0;
+	}
+
+	pScen = (scen *)malloc(sizeof(scen) * MAX_SCENARIOS);
+	while (fgets(szLine, sizeof(szLine), fp)) {
+		if (szLine[0] == '#' || szLine[0] == '\n')
+			continue;
+		if (iScen == MAX_SCENARIOS) {
+			fprintf(stderr, "Error: more than %d scenarios in %s\n", MAX_SCENARIOS, pszFile);
+			free(pScen);
+			fclose(fp);
+			return 0;
+		}
+		if (sscanf(szLine, "%31s %d %lf %lf", pScen[iScen].szName, &pScen[iScen].iBucket,
+					&dShiftBp, &pScen[iScen].dVolScale) != 4) {
+			fprintf(stderr, "Error: malformed scenario line: %s", szLine);
+			free(pScen);
+			fclose(fp);
+			return 0;
+		}
+		if (pScen[iScen].dVolScale < 0) {
+			fprintf(stderr, "Error: negative vol scale in scenario line: %s", szLine);
+			free(pScen);
+			fclose(fp);
+			return 0;
+		}
+		pScen[iScen].dShift = dShiftBp * 0.0001;
+		iScen++;
+	}
+	fclose(fp);
+
+	if (iScen == 0) {
+		fprintf(stderr, "Error: no scenarios in %s\n", pszFile);
+		free(pScen);
+		return 0;
+	}
+	*ppScen = pScen;
+	return iScen;
+}
+
+int HJM_Ladder_Scenarios(int iN,	//Number of pdYield buckets
+		FTYPE dShiftBp,				//Size of the bump in bp
+		scen **ppScen)
+{
+	//This function builds the standard ladder: the base case, a parallel
+	//shift up and down, then an up and a down shift of every pdYield bucket.
+	//Returns the number of scenarios.
+
+	int i, iScen = 0;
+	scen *pScen = (scen *)malloc(sizeof(scen) * (2*iN + 3));
+
+	strcpy(pScen[iScen].szName, "base");
+	pScen[iScen].iBucket = -1;
+	pScen[iScen].dShift = 0.0;
+	pScen[iScen].dVolScale = 1.0;
+	iScen++;
+
+	for (i = -1; i < iN; i++) {
+		if (i < 0) snprintf(pScen[iScen].szName, sizeof(pScen[iScen].szName), "par+%gbp", dShiftBp);
+		else snprintf(pScen[iScen].szName, sizeof(pScen[iScen].szName), "y%d+%gbp", i, dShiftBp);
+		pScen[iScen].iBucket = i;
+		pScen[iScen].dShift = dShiftBp * 0.0001;
+		pScen[iScen].dVolScale = 1.0;
+		iScen++;
+
+		if (i < 0) snprintf(pScen[iScen].szName, sizeof(pScen[iScen].szName), "par-%gbp", dShiftBp);
+		else snprintf(pScen[iScen].szName, sizeof(pScen[iScen].szName), "y%d-%gbp", i, dShiftBp);
+		pScen[iScen].iBucket = i;
+		pScen[iScen].dShift = -dShiftBp * 0.0001;
+		pScen[iScen].dVolScale = 1.0;
+		iScen++;
+	}
+
+	*ppScen = pScen;
+	return iScen;
+}
+
+int HJM_Swaption_Blocking_Scenarios(FTYPE *pdScenPrice, //Output vector that will store, for each scenario s:
+		//pdScenPrice[2*s]   Swaption Price
+		//pdScenPrice[2*s+1] Swaption Standard Error
+		//Swaption Parameters (see HJM_Swaption_Blocking)
+		FTYPE dStrike,
+		FTYPE dCompounding,
+		FTYPE dMaturity,
+		FTYPE dTenor,
+		FTYPE dPaymentInterval,
+		//HJM Framework Parameters (unbumped)
+		int iN,
+		int iFactors,
+		FTYPE dYears,
+		FTYPE *pdYield,
+		FTYPE **ppdFactors,
+		//Scenarios
+		int iScenarios,
+		scen *pScen,
+		//Simulation Parameters
+		long iRndSeed,
+		long lTrials,
+		int BLOCKSIZE)
+{
+	int iSuccess = 0;
+	int i, j, k, s;
+	long l;
+
+	FTYPE ddelt = (FTYPE)(dYears/iN);
+	int iFreqRatio = (int)(dPaymentInterval/ddelt + 0.5);
+	FTYPE dStrikeCont;
+	if(dCompounding==0) {
+		dStrikeCont = dStrike;
+	} else {
+		dStrikeCont = (1/dCompounding)*log(1+dStrike*dCompounding);
+	}
+
+	int iSwapVectorLength = (int) (iN - dMaturity/ddelt + 0.5);
+	int iSwapStartTimeIndex = (int) (dMaturity/ddelt + 0.5);
+	int iSwapTimePoints = (int) (dTenor/ddelt + 0.5);
+
+	// Per scenario inputs to the path generation
+	FTYPE **ppdForward = dmatrix(0, iScenarios-1, 0, iN-1);
+	FTYPE **ppdTotalDrift = dmatrix(0, iScenarios-1, 0, iN-2);
+	FTYPE ***pppdFactors = (FTYPE ***)malloc(sizeof(FTYPE **) * iScenarios);
+	ksum *pSum = (ksum *)malloc(sizeof(ksum) * iScenarios);
+	ksum *pSumSquare = (ksum *)malloc(sizeof(ksum) * iScenarios);
+
+	FTYPE *pdBumpedYield = dvector(0, iN-1);
+	FTYPE **ppdDrifts = dmatrix(0, iFactors-1, 0, iN-2);
+
+	// Shared across scenarios
+	FTYPE **pdZ = dmatrix(0, iFactors-1, 0, iN*BLOCKSIZE-1);
+	FTYPE **randZ = dmatrix(0, iFactors-1, 0, iN*BLOCKSIZE-1);
+	FTYPE *pdRows = dvector(0, 2*iN*BLOCKSIZE-1);
+	FTYPE pdDiscPayoffs[BLOCKSIZE];
+	FTYPE *pdSwapPayoffs = dvector(0, iSwapVectorLength-1);
+
+	iSuccess = HJM_Swap_Payoffs(pdSwapPayoffs, iSwapVectorLength, iSwapTimePoints, iFreqRatio, dStrikeCont, dPaymentInterval);
+
+	//bumped forward curves and drifts, one per scenario
+	for (s = 0; s < iScenarios && iSuccess == 1; s++) {
+		for (j = 0; j <= iN-1; j++) {
+			pdBumpedYield[j] = pdYield[j];
+			if (pScen[s].iBucket < 0 || pScen[s].iBucket == j)
+				pdBumpedYield[j] += pScen[s].dShift;
+		}
+		pppdFactors[s] = dmatrix(0, iFactors-1, 0, iN-2);
+		for (k = 0; k <= iFactors-1; k++)
+			for (j = 0; j <= iN-2; j++)
+				pppdFactors[s][k][j] = ppdFactors[k][j] * pScen[s].dVolScale;
+
+		iSuccess = HJM_Yield_to_Forward(ppdForward[s], iN, pdBumpedYield);
+		if (iSuccess == 1)
+			iSuccess = HJM_Drifts(ppdTotalDrift[s], ppdDrifts, iN, iFactors, dYears, pppdFactors[s]);
+
+		memset(&pSum[s], 0, sizeof(ksum));
+		memset(&pSumSquare[s], 0, sizeof(ksum));
+	}
+
+	//Simulations begin: every block of shocks is drawn once and reused by all scenarios
+	for (l=0;l<=lTrials-1 && iSuccess == 1;l+=BLOCKSIZE) {
+		iSuccess = HJM_Z_Blocking_Rows(pdZ, randZ, iN, iFactors, iSwapStartTimeIndex, &iRndSeed, BLOCKSIZE);
+
+		for (s = 0; s < iScenarios && iSuccess == 1; s++) {
+			iSuccess = HJM_Swaption_Payoffs_Rolling(pdDiscPayoffs, iN, iFactors, dYears, ppdForward[s], ppdTotalDrift[s],
+					pppdFactors[s], pdZ, pdSwapPayoffs, iSwapVectorLength, iSwapStartTimeIndex, pdRows, BLOCKSIZE);
+			if (iSuccess == 1)
+				HJM_Swaption_Accumulate(&pSum[s], &pSumSquare[s], pdDiscPayoffs, BLOCKSIZE);
+		}
+	}
+
+	// Simulation Results Stored
+	for (s = 0; s < iScenarios && iSuccess == 1; s++) {
+		HJM_Swaption_Result(pdScenPrice + 2*s, &pSum[s], &pSumSquare[s], lTrials);
+	}
+
+	for (i = 0; i < iScenarios; i++)
+		free_dmatrix(pppdFactors[i], 0, iFactors-1, 0, iN-2);
+	free(pppdFactors);
+	free_dmatrix(ppdForward, 0, iScenarios-1, 0, iN-1);
+	free_dmatrix(ppdTotalDrift, 0, iScenarios-1, 0, iN-2);
+	free(pSum);
+	free(pSumSquare);
+	free_dvector(pdBumpedYield, 0, iN-1);
+	free_dmatrix(ppdDrifts, 0, iFactors-1, 0, iN-2);
+	free_dmatrix(pdZ, 0, iFactors-1, 0, iN*BLOCKSIZE-1);
+	free_dmatrix(randZ, 0, iFactors-1, 0, iN*BLOCKSIZE-1);
+	free_dvector(pdRows, 0, 2*iN*BLOCKSIZE-1);
+	free_dvector(pdSwapPayoffs, 0, iSwapVectorLength-1);
+
+	return iSuccess;
+}
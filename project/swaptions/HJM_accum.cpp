@@ -0,0 +1,58 @@
+//HJM_accum.cpp
+//Lock-free aggregation of per-worker partial sums (see HJM_accum.h).
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "HJM_accum.h"
+
+int accum_init(accum *pAcc, int nSlots)
+{
+	void *p;
+
+	if (posix_memalign(&p, ACCUM_LINE, sizeof(accum_slot) * nSlots) != 0)
+		return 0;
+	memset(p, 0, sizeof(accum_slot) * nSlots);
+	pAcc->nSlots = nSlots;
+	pAcc->uArrived = 0;
+	pAcc->pSlots = (accum_slot *)p;
+	return 1;
+}
+
+void accum_free(accum *pAcc)
+{
+	free(pAcc->pSlots);
+	pAcc->pSlots = NULL;
+}
+
+int accum_publish(accum *pAcc, int k, unsigned uEpoch, long lTrials, const ksum *pSum, const ksum *pSumSquare)
+{
+	accum_slot *pSlot = &pAcc->pSlots[k];
+	unsigned uArrived;
+
+	pSlot->lTrials = lTrials;
+	pSlot->sum = *pSum;
+	pSlot->sumSquare = *pSumSquare;
+	__atomic_store_n(&pSlot->uEpoch, uEpoch, __ATOMIC_RELEASE);
+
+	uArrived = __atomic_add_fetch(&pAcc->uArrived, 1, __ATOMIC_ACQ_REL);
+	return uArrived % pAcc->nSlots == 0;
+}
+
+int accum_merge(accum *pAcc, unsigned uEpoch, ksum *pSum, ksum *pSumSquare, long *plTrials)
+{
+	int k;
+
+	memset(pSum, 0, sizeof(ksum));
+	memset(pSumSquare, 0, sizeof(ksum));
+	*plTrials = 0;
+	for (k = 0; k < pAcc->nSlots; k++) {
+		accum_slot *pSlot = &pAcc->pSlots[k];
+		if (__atomic_load_n(&pSlot->uEpoch, __ATOMIC_ACQUIRE) < uEpoch)
+			return 0;
+		ksum_merge(pSum, &pSlot->sum);
+		ksum_merge(pSumSquare, &pSlot->sumSquare);
+		*plTrials += pSlot->lTrials;
+	}
+	return 1;
+}
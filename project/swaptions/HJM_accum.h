@@ -0,0 +1,67 @@
+#ifndef __HJM_ACCUM__
+#define __HJM_ACCUM__
+
+// Result aggregation for the payoff sums.
+//
+// ksum is a Neumaier-compensated sum: dComp carries the low-order bits lost
+// by dSum, so sums over 10^8 and more payoffs keep full double accuracy and
+// barely depend on the order in which partial sums are combined.
+//
+// accum collects the partial sums of one swaption whose trials are split over
+// several workers. Every worker owns one cache-line aligned slot and writes
+// it without synchronisation; finishing an epoch is a release store of the
+// slot's epoch plus one atomic increment, and the worker that completes the
+// epoch merges all slots in slot order. No locks, no shared cache lines.
+
+#include <math.h>
+#include "HJM_type.h"
+
+#define ACCUM_LINE 64
+
+static inline void ksum_add(ksum *p, FTYPE x)
+{
+	FTYPE t = p->dSum + x;
+	if (fabs(p->dSum) >= fabs(x))
+		p->dComp += (p->dSum - t) + x;
+	else
+		p->dComp += (x - t) + p->dSum;
+	p->dSum = t;
+}
+
+static inline FTYPE ksum_value(const ksum *p)
+{
+	return p->dSum + p->dComp;
+}
+
+static inline void ksum_merge(ksum *p, const ksum *q)
+{
+	ksum_add(p, q->dSum);
+	p->dComp += q->dComp;
+}
+
+typedef struct
+{
+	unsigned uEpoch;	// last epoch whose partial sums are in this slot
+	long lTrials;
+	ksum sum;
+	ksum sumSquare;
+} __attribute__((aligned(ACCUM_LINE))) accum_slot;
+
+typedef struct
+{
+	int nSlots;
+	unsigned uArrived;	// slots that finished an epoch, over all epochs
+	accum_slot *pSlots;
+} accum;
+
+int accum_init(accum *pAcc, int nSlots);
+void accum_free(accum *pAcc);
+
+// Called by the owner of slot k when its share of epoch uEpoch is done.
+// Returns 1 for the last slot of the epoch, which should then merge.
+int accum_publish(accum *pAcc, int k, unsigned uEpoch, long lTrials, const ksum *pSum, const ksum *pSumSquare);
+
+// Sums of all slots, in slot order. Returns 0 if a slot has not reached uEpoch.
+int accum_merge(accum *pAcc, unsigned uEpoch, ksum *pSum, ksum *pSumSquare, long *plTrials);
+
+#endif //__HJM_ACCUM__
@@ -0,0 +1,133 @@
+//HJM_affinity.cpp
+//Maps worker threads onto cores for the -affinity option of the pthreads version.
+//The NUMA layout is read from /sys/devices/system/node; when it is not
+//available all allowed cpus are treated as a single node.
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "HJM_type.h"
+#include "HJM.h"
+
+#define MAX_NODES 64
+#define MAX_CPUS 1024
+
+static int nNodes = 0;
+static int nCpus = 0;
+static int piNodeCpus[MAX_NODES][MAX_CPUS];
+static int piNodeCnt[MAX_NODES];
+static int piCpuOrder[2][MAX_CPUS]; // [AFFINITY_COMPACT-1 / AFFINITY_SCATTER-1][slot]
+
+// parses a sysfs cpulist such as "0-7,16-23"
+static int parse_cpulist(const char *szList, int *piCpus, cpu_set_t *pAllowed)
+{
+	int n = 0, lo, hi, c;
+	const char *pc = szList;
+
+	while (*pc && *pc != '\n') {
+		lo = (int)strtol(pc, (char **)&pc, 10);
+		hi = lo;
+		if (*pc == '-')
+			hi = (int)strtol(pc+1, (char **)&pc, 10);
+		for (c = lo; c <= hi && n < MAX_CPUS; c++)
+			if (c < CPU_SETSIZE && CPU_ISSET(c, pAllowed))
+				piCpus[n++] = c;
+		if (*pc == ',')
+			pc++;
+		else
+			break;
+	}
+	return n;
+}
+
+int HJM_Affinity_Init()
+{
+	//This function reads the node/cpu layout and builds the compact and
+	//scatter orders. Returns the number of usable cpus.
+
+	char szPath[128];
+	char szList[4096];
+	FILE *fp;
+	cpu_set_t allowed;
+	int i, k, n;
+
+	if (nCpus > 0)
+		return nCpus;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+		CPU_ZERO(&allowed);
+		for (i = 0; i < sysconf(_SC_NPROCESSORS_ONLN) && i < CPU_SETSIZE; i++)
+			CPU_SET(i, &allowed);
+	}
+
+	for (i = 0; i < MAX_NODES; i++) {
+		snprintf(szPath, sizeof(szPath), "/sys/devices/system/node/node%d/cpulist", i);
+		fp = fopen(szPath, "r");
+		if (!fp)
+			continue;
+		if (fgets(szList, sizeof(szList), fp)) {
+			n = parse_cpulist(szList, piNodeCpus[nNodes], &allowed);
+			if (n > 0)
+				piNodeCnt[nNodes++] = n;
+		}
+		fclose(fp);
+	}
+
+	if (nNodes == 0) {
+		n = 0;
+		for (i = 0; i < CPU_SETSIZE && n < MAX_CPUS; i++)
+			if (CPU_ISSET(i, &allowed))
+				piNodeCpus[0][n++] = i;
+		piNodeCnt[0] = n;
+		nNodes = 1;
+	}
+
+	// compact: fill one node before moving on to the next
+	for (k = 0; k < nNodes; k++)
+		for (i = 0; i < piNodeCnt[k] && nCpus < MAX_CPUS; i++)
+			piCpuOrder[AFFINITY_COMPACT-1][nCpus++] = piNodeCpus[k][i];
+
+	// scatter: round-robin over the nodes
+	n = 0;
+	for (i = 0; n < nCpus; i++)
+		for (k = 0; k < nNodes; k++)
+			if (i < piNodeCnt[k])
+				piCpuOrder[AFFINITY_SCATTER-1][n++] = piNodeCpus[k][i];
+
+	return nCpus;
+}
+
+int HJM_Affinity_Cpu(int tid, int iPolicy)
+{
+	//Returns the cpu worker tid is pinned to under the given policy
+	if (HJM_Affinity_Init() == 0)
+		return -1;
+	return piCpuOrder[iPolicy-1][tid % nCpus];
+}
+
+int HJM_Affinity_Node(int iCpu)
+{
+	//Returns the NUMA node iCpu belongs to
+	int i, k;
+
+	HJM_Affinity_Init();
+	for (k = 0; k < nNodes; k++)
+		for (i = 0; i < piNodeCnt[k]; i++)
+			if (piNodeCpus[k][i] == iCpu)
+				return k;
+	return 0;
+}
+
+int HJM_Affinity_Parse(const char *szPolicy)
+{
+	if (!strcmp(szPolicy, "compact")) return AFFINITY_COMPACT;
+	if (!strcmp(szPolicy, "scatter")) return AFFINITY_SCATTER;
+	if (!strcmp(szPolicy, "none")) return AFFINITY_NONE;
+	return -1;
+}
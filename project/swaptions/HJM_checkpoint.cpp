@@ -0,0 +1,207 @@
+//HJM_checkpoint.cpp
+//Checkpoint/restart for long runs (-ckpt, -resume).
+//A writer thread periodically snapshots the per-swaption progress published
+//by the pricing workers (see HJM_Publish_State) and writes it to a compact
+//binary file: a header followed by one 48-byte record per swaption. The file
+//is written to <name>.tmp and renamed, so a kill never leaves a torn checkpoint.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "HJM_type.h"
+#include "HJM.h"
+#include "rng.h"
+
+#define CKPT_MAGIC "HJMCKPT3"
+
+typedef struct
+{
+	char szMagic[8];
+	int nSwaptions;
+	int iN;
+	int iFactors;
+	int iBlockSize;
+	long lTrials;
+	int iRng;			// rng.h generator the seeds belong to
+} ckpt_header;
+
+typedef struct
+{
+	long lTrialsDone;	// >= lTrials once the swaption is finished
+	long lRndSeed;
+	ksum sum;
+	ksum sumSquare;
+} ckpt_record;
+
+static const char *pszCkptFile;
+static char szCkptTmp[4096];
+static swaption_state *pCkptStates;
+static ckpt_header ckptHeader;
+static ckpt_record *pCkptRecords;
+static int iCkptInterval;
+static int bCkptStop;
+static pthread_t ckptThread;
+static pthread_mutex_t ckptLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ckptWake = PTHREAD_COND_INITIALIZER;
+
+static void ckpt_header_init(ckpt_header *pHeader, int nSwaptions, int iN, int iFactors, long lTrials, int BLOCKSIZE)
+{
+	memset(pHeader, 0, sizeof(ckpt_header));
+	memcpy(pHeader->szMagic, CKPT_MAGIC, sizeof(pHeader->szMagic));
+	pHeader->nSwaptions = nSwaptions;
+	pHeader->iN = iN;
+	pHeader->iFactors = iFactors;
+	pHeader->iBlockSize = BLOCKSIZE;
+	pHeader->lTrials = lTrials;
+	pHeader->iRng = rng_selected();
+}
+
+// consistent copy of one state, racing only with its own worker
+static void ckpt_snapshot(swaption_state *pState, ckpt_record *pRec)
+{
+	unsigned uSeq0, uSeq1;
+
+	do {
+		uSeq0 = __atomic_load_n(&pState->uSeq, __ATOMIC_ACQUIRE);
+		pRec->lTrialsDone = pState->lTrialsDone;
+		pRec->lRndSeed = pState->lRndSeed;
+		pRec->sum = pState->sum;
+		pRec->sumSquare = pState->sumSquare;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		uSeq1 = __atomic_load_n(&pState->uSeq, __ATOMIC_RELAXED);
+	} while ((uSeq0 & 1) || uSeq0 != uSeq1);
+}
+
+static int ckpt_write()
+{
+	FILE *fp;
+	int i, iOk;
+
+	for (i = 0; i < ckptHeader.nSwaptions; i++)
+		ckpt_snapshot(&pCkptStates[i], &pCkptRecords[i]);
+
+	fp = fopen(szCkptTmp, "wb");
+	if (!fp) {
+		fprintf(stderr, "Error: cannot write checkpoint %s: %s\n", szCkptTmp, strerror(errno));
+		return 0;
+	}
+	iOk = fwrite(&ckptHeader, sizeof(ckptHeader), 1, fp) == 1 &&
+		fwrite(pCkptRecords, sizeof(ckpt_record), ckptHeader.nSwaptions, fp) == (size_t)ckptHeader.nSwaptions &&
+		fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+	if (fclose(fp) != 0)
+		iOk = 0;
+	if (!iOk || rename(szCkptTmp, pszCkptFile) != 0) {
+		fprintf(stderr, "Error: cannot write checkpoint %s: %s\n", pszCkptFile, strerror(errno));
+		return 0;
+	}
+	return 1;
+}
+
+static void *ckpt_writer(void *arg)
+{
+	struct timespec deadline;
+
+	(void)arg;
+	pthread_mutex_lock(&ckptLock);
+	while (!bCkptStop) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += iCkptInterval;
+		while (!bCkptStop && pthread_cond_timedwait(&ckptWake, &ckptLock, &deadline) != ETIMEDOUT)
+			;
+		if (bCkptStop)
+			break;
+		pthread_mutex_unlock(&ckptLock);
+		ckpt_write();
+		pthread_mutex_lock(&ckptLock);
+	}
+	pthread_mutex_unlock(&ckptLock);
+	return NULL;
+}
+
+int HJM_Ckpt_Load(const char *pszFile,	//Checkpoint written by an earlier run with the same parameters
+		swaption_state *pStates,		//Output: restored progress of every swaption
+		int nSwaptions, int iN, int iFactors, long lTrials, int BLOCKSIZE)
+{
+	//This function restores pStates from a checkpoint. Returns the number of
+	//finished swaptions, 0 if there is no checkpoint yet and -1 if the
+	//checkpoint belongs to a different run.
+
+	FILE *fp;
+	ckpt_header header, expected;
+	ckpt_record rec;
+	int i, nDone = 0;
+
+	fp = fopen(pszFile, "rb");
+	if (!fp) {
+		fprintf(stderr, "No checkpoint %s, starting from scratch\n", pszFile);
+		return 0;
+	}
+
+	ckpt_header_init(&expected, nSwaptions, iN, iFactors, lTrials, BLOCKSIZE);
+	if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(&header, &expected, sizeof(header)) != 0) {
+		fprintf(stderr, "Error: checkpoint %s does not match this run (-ns, -sm, -rng, BLOCK_SIZE)\n", pszFile);
+		fclose(fp);
+		return -1;
+	}
+
+	for (i = 0; i < nSwaptions; i++) {
+		if (fread(&rec, sizeof(rec), 1, fp) != 1) {
+			fprintf(stderr, "Error: checkpoint %s is truncated\n", pszFile);
+			fclose(fp);
+			return -1;
+		}
+		pStates[i].uSeq = 0;
+		pStates[i].iDone = rec.lTrialsDone >= lTrials;
+		pStates[i].lTrialsDone = rec.lTrialsDone;
+		pStates[i].lRndSeed = rec.lRndSeed;
+		pStates[i].sum = rec.sum;
+		pStates[i].sumSquare = rec.sumSquare;
+		nDone += pStates[i].iDone;
+	}
+	fclose(fp);
+
+	return nDone;
+}
+
+int HJM_Ckpt_Start(const char *pszFile,	//Checkpoint file, replaced atomically on every write
+		swaption_state *pStates,		//Progress published by the workers
+		int nSwaptions, int iN, int iFactors, long lTrials, int BLOCKSIZE,
+		int iInterval)					//Seconds between two checkpoints
+{
+	//This function starts the checkpoint writer thread
+	pszCkptFile = pszFile;
+	snprintf(szCkptTmp, sizeof(szCkptTmp), "%s.tmp", pszFile);
+	pCkptStates = pStates;
+	ckpt_header_init(&ckptHeader, nSwaptions, iN, iFactors, lTrials, BLOCKSIZE);
+	pCkptRecords = (ckpt_record *)malloc(sizeof(ckpt_record) * nSwaptions);
+	iCkptInterval = iInterval;
+	bCkptStop = 0;
+
+	if (pthread_create(&ckptThread, NULL, ckpt_writer, NULL) != 0) {
+		fprintf(stderr, "Error: cannot start the checkpoint writer\n");
+		free(pCkptRecords);
+		return 0;
+	}
+	return 1;
+}
+
+int HJM_Ckpt_Stop()
+{
+	//This function stops the writer and writes the final checkpoint
+	int iSuccess;
+
+	pthread_mutex_lock(&ckptLock);
+	bCkptStop = 1;
+	pthread_cond_signal(&ckptWake);
+	pthread_mutex_unlock(&ckptLock);
+	pthread_join(ckptThread, NULL);
+
+	iSuccess = ckpt_write();
+	free(pCkptRecords);
+	return iSuccess;
+}
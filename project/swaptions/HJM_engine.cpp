@@ -0,0 +1,471 @@
+//HJM_engine.cpp
+//Backends of hjm::Engine (HJM_engine.h): a serial loop, a persistent pthreads
+//pool and, in HAVE_TBB builds, a tbb::parallel_for in a task arena.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "HJM.h"
+#include "HJM_type.h"
+#include "HJM_accum.h"
+#include "HJM_engine.h"
+#include "icdf.h"
+#include "rng.h"
+
+#include "HJM_tbb.h"
+
+#define ENGINE_MAX_THREADS 1024
+#define CALIBRATE_PATHS 32768
+#define CALIBRATE_MIN_BOOK 64	// books below 64x CALIBRATE_PATHS are not timed
+
+namespace hjm {
+
+const char *backend_name[BACKEND_NBACKENDS] = { "serial", "pthreads", "tbb" };
+
+int backend_parse(const char *szBackend)
+{
+	if (!strcmp(szBackend, "auto"))
+		return BACKEND_AUTO;
+	for (int b = 0; b < BACKEND_NBACKENDS; b++)
+		if (!strcmp(szBackend, backend_name[b]))
+			return b;
+	return -1;
+}
+
+int backend_available(int iBackend)
+{
+#ifdef HAVE_TBB
+	return iBackend >= 0 && iBackend < BACKEND_NBACKENDS;
+#else
+	return iBackend == BACKEND_SERIAL || iBackend == BACKEND_PTHREADS;
+#endif
+}
+
+int backend_default()
+{
+#if defined(ALL_BACKENDS)
+	return BACKEND_AUTO;
+#elif defined(TBB_VERSION)
+	return BACKEND_TBB;
+#elif defined(ENABLE_THREADS)
+	return BACKEND_PTHREADS;
+#else
+	return BACKEND_SERIAL;
+#endif
+}
+
+Options::Options()
+	: nThreads(1), lTrials(DEFAULT_NUM_TRIALS), lSeed(RANDSEEDVAL),
+	  iRng(RNG_PARKMILLER), iIcdfAlg(ICDF_MORO), iIcdfIsa(ICDF_SCALAR)
+{
+}
+
+int Engine::price_one(const parm *p, FTYPE *pdPrice)
+{
+	swaption_state state;
+
+	memset(&state, 0, sizeof(state));
+	return price_state(p, &state, opt.lTrials, pdPrice);
+}
+
+// Continues *pState up to lTrials
+int Engine::price_state(const parm *p, swaption_state *pState, long lTrials, FTYPE *pdPrice)
+{
+	if (HJM_Swaption_Simulate(pdPrice, p->dStrike, p->dCompounding, p->dMaturity, p->dTenor,
+				p->dPaymentInterval, p->iN, p->iFactors, p->dYears, p->pdYield, p->ppdFactors,
+				rng_stream(opt.lSeed, p->Id), lTrials, BLOCK_SIZE, pState, bPipeline) != 1) {
+		pdPrice[0] = pdPrice[1] = -1.0;
+		return 0;
+	}
+	return 1;
+}
+
+// Sums of trials lFirst..lLast-1 (whole blocks), with the seeds the serial
+// loop would use for them
+int Engine::price_part(const parm *p, long lFirst, long lLast, ksum *pSum, ksum *pSumSquare)
+{
+	FTYPE pdSwaptionPrice[2];
+	swaption_state state;
+	long lSeed = rng_stream(opt.lSeed, p->Id);
+	int iSuccess = 1;
+
+	memset(&state, 0, sizeof(state));
+	if (lFirst < lLast) {
+		state.lTrialsDone = lFirst;
+		state.lRndSeed = rng_skip(lSeed, lFirst/BLOCK_SIZE, p->iN, p->iFactors, BLOCK_SIZE);
+		iSuccess = HJM_Swaption_Simulate(pdSwaptionPrice, p->dStrike, p->dCompounding, p->dMaturity,
+				p->dTenor, p->dPaymentInterval, p->iN, p->iFactors, p->dYears, p->pdYield, p->ppdFactors,
+				lSeed, lLast, BLOCK_SIZE, &state, bPipeline);
+	}
+	*pSum = state.sum;
+	*pSumSquare = state.sumSquare;
+	return iSuccess == 1;
+}
+
+class SerialEngine : public Engine
+{
+public:
+	SerialEngine(const Options &opt) : Engine(BACKEND_SERIAL, opt) {}
+
+	int price(const parm *pSwaptions, int nSwaptions, FTYPE *pdPrice)
+	{
+		int nGood = 0;
+
+		for (int i = 0; i < nSwaptions; i++)
+			nGood += price_one(&pSwaptions[i], pdPrice + 2*i);
+		return nGood;
+	}
+
+	int refine(const parm *pSwaptions, int nSwaptions, swaption_state *pStates, long lTrials, FTYPE *pdPrice)
+	{
+		int nGood = 0;
+
+		for (int i = 0; i < nSwaptions; i++)
+			nGood += price_state(&pSwaptions[i], &pStates[i], lTrials, pdPrice + 2*i);
+		return nGood;
+	}
+};
+
+// Workers wait for a batch generation and take units off a shared counter.
+// With fewer swaptions than workers the trials of each swaption are split
+// into nParts block ranges whose sums meet in an accum (HJM_accum.h), merged
+// in part order, so the prices do not depend on the pool size.
+class PthreadsEngine : public Engine
+{
+public:
+	PthreadsEngine(const Options &opt) : Engine(BACKEND_PTHREADS, opt), uGen(0), bStop(0)
+	{
+		pthread_mutex_init(&lock, NULL);
+		pthread_cond_init(&posted, NULL);
+		pthread_cond_init(&done, NULL);
+		// a batch waits for nStarted workers; create() drops a pool with none
+		pThreads = (pthread_t *)malloc(sizeof(pthread_t) * opt.nThreads);
+		nStarted = 0;
+		for (int t = 0; t < opt.nThreads; t++)
+			if (pthread_create(&pThreads[nStarted], NULL, worker, this) == 0)
+				nStarted++;
+		if (nStarted < opt.nThreads)
+			fprintf(stderr, "Warning: started %d of %d worker threads\n", nStarted, opt.nThreads);
+	}
+
+	int started() const { return nStarted; }
+
+	~PthreadsEngine()
+	{
+		pthread_mutex_lock(&lock);
+		bStop = 1;
+		pthread_cond_broadcast(&posted);
+		pthread_mutex_unlock(&lock);
+		for (int t = 0; t < nStarted; t++)
+			pthread_join(pThreads[t], NULL);
+		free(pThreads);
+		pthread_cond_destroy(&done);
+		pthread_cond_destroy(&posted);
+		pthread_mutex_destroy(&lock);
+	}
+
+	int price(const parm *pSwaptions, int nSwaptions, FTYPE *pdPrice)
+	{
+		int i;
+
+		pBatch = pSwaptions;
+		pdBatchPrice = pdPrice;
+		nBatch = nSwaptions;
+		pBatchStates = NULL;
+		nParts = 1;
+		pAccums = NULL;
+		if (nSwaptions > 0 && nSwaptions < opt.nThreads) {
+			nParts = (opt.nThreads + nSwaptions - 1) / nSwaptions;
+			pAccums = (accum *)malloc(sizeof(accum) * nSwaptions);
+			for (i = 0; i < nSwaptions; i++)
+				if (!accum_init(&pAccums[i], nParts)) {
+					fprintf(stderr, "Error: cannot allocate the partial sums\n");
+					while (--i >= 0)
+						accum_free(&pAccums[i]);
+					free(pAccums);
+					nParts = 1;
+					pAccums = NULL;
+					break;
+				}
+		}
+		post();
+
+		if (pAccums) {
+			for (i = 0; i < nSwaptions; i++)
+				accum_free(&pAccums[i]);
+			free(pAccums);
+		}
+		return nGood;
+	}
+
+	int refine(const parm *pSwaptions, int nSwaptions, swaption_state *pStates, long lTrials, FTYPE *pdPrice)
+	{
+		pBatch = pSwaptions;
+		pdBatchPrice = pdPrice;
+		nBatch = nSwaptions;
+		pBatchStates = pStates;
+		lBatchTrials = lTrials;
+		nParts = 1;
+		pAccums = NULL;
+		post();
+		return nGood;
+	}
+
+private:
+	// Hands the batch to the workers and waits for them
+	void post()
+	{
+		iNext = 0;
+		nGood = 0;
+
+		pthread_mutex_lock(&lock);
+		nLeft = nStarted;
+		uGen++;
+		pthread_cond_broadcast(&posted);
+		while (nLeft > 0)
+			pthread_cond_wait(&done, &lock);
+		pthread_mutex_unlock(&lock);
+	}
+
+	static void *worker(void *arg)
+	{
+		PthreadsEngine *e = (PthreadsEngine *)arg;
+		unsigned uSeen = 0;
+		int u;
+
+		pthread_mutex_lock(&e->lock);
+		for (;;) {
+			while (e->uGen == uSeen && !e->bStop)
+				pthread_cond_wait(&e->posted, &e->lock);
+			if (e->uGen == uSeen)
+				break;
+			uSeen = e->uGen;
+			pthread_mutex_unlock(&e->lock);
+
+			while ((u = __atomic_fetch_add(&e->iNext, 1, __ATOMIC_RELAXED)) < e->nBatch * e->nParts)
+				e->run(u / e->nParts, u % e->nParts);
+
+			pthread_mutex_lock(&e->lock);
+			if (--e->nLeft == 0)
+				pthread_cond_broadcast(&e->done);
+		}
+		pthread_mutex_unlock(&e->lock);
+		return NULL;
+	}
+
+	void run(int i, int iPart)
+	{
+		const parm *p = &pBatch[i];
+		FTYPE *pdPrice = pdBatchPrice + 2*i;
+		ksum sum, sumSquare;
+		long lTrials;
+
+		if (pBatchStates) {
+			__atomic_add_fetch(&nGood, price_state(p, &pBatchStates[i], lBatchTrials, pdPrice), __ATOMIC_RELAXED);
+			return;
+		}
+		if (nParts == 1) {
+			__atomic_add_fetch(&nGood, price_one(p, pdPrice), __ATOMIC_RELAXED);
+			return;
+		}
+
+		long nBlocks = (opt.lTrials + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		long lFirst = nBlocks*iPart/nParts*BLOCK_SIZE;
+		long lLast = nBlocks*(iPart+1)/nParts*BLOCK_SIZE;
+		if (lLast > opt.lTrials)
+			lLast = opt.lTrials;
+		if (lFirst > lLast)
+			lFirst = lLast;
+		// a failed part publishes a negative trial count
+		lTrials = price_part(p, lFirst, lLast, &sum, &sumSquare) ? lLast - lFirst : -opt.lTrials;
+
+		// the last part to finish merges
+		if (accum_publish(&pAccums[i], iPart, 1, lTrials, &sum, &sumSquare)) {
+			if (accum_merge(&pAccums[i], 1, &sum, &sumSquare, &lTrials) && lTrials == opt.lTrials) {
+				HJM_Swaption_Result(pdPrice, &sum, &sumSquare, opt.lTrials);
+				__atomic_add_fetch(&nGood, 1, __ATOMIC_RELAXED);
+			} else {
+				pdPrice[0] = pdPrice[1] = -1.0;
+			}
+		}
+	}
+
+	pthread_t *pThreads;
+	int nStarted;			// workers actually running
+	pthread_mutex_t lock;
+	pthread_cond_t posted;		// a batch was posted
+	pthread_cond_t done;		// all workers left the batch
+	unsigned uGen;
+	int bStop;
+	int nLeft;
+
+	// current batch
+	const parm *pBatch;
+	FTYPE *pdBatchPrice;
+	int nBatch;
+	swaption_state *pBatchStates;	// refine(): continue these up to lBatchTrials
+	long lBatchTrials;
+	int nParts;
+	int iNext;
+	int nGood;
+	accum *pAccums;
+};
+
+#ifdef HAVE_TBB
+// One task per swaption; inside it the simulation itself is the pipeline of
+// HJM_Swaption_Pipeline.cpp, so a small batch still uses the whole arena.
+class TbbEngine : public Engine
+{
+public:
+	TbbEngine(const Options &opt) : Engine(BACKEND_TBB, opt), arena(opt.nThreads) {}
+
+	int price(const parm *pSwaptions, int nSwaptions, FTYPE *pdPrice)
+	{
+		int nGood = 0;
+
+		arena.execute([&] {
+			tbb::parallel_for(tbb::blocked_range<int>(0, nSwaptions, 1),
+				[&](const tbb::blocked_range<int> &range) {
+					for (int i = range.begin(); i != range.end(); i++)
+						__atomic_add_fetch(&nGood, price_one(&pSwaptions[i], pdPrice + 2*i), __ATOMIC_RELAXED);
+				});
+		});
+		return nGood;
+	}
+
+	int refine(const parm *pSwaptions, int nSwaptions, swaption_state *pStates, long lTrials, FTYPE *pdPrice)
+	{
+		int nGood = 0;
+
+		arena.execute([&] {
+			tbb::parallel_for(tbb::blocked_range<int>(0, nSwaptions, 1),
+				[&](const tbb::blocked_range<int> &range) {
+					for (int i = range.begin(); i != range.end(); i++)
+						__atomic_add_fetch(&nGood, price_state(&pSwaptions[i], &pStates[i], lTrials,
+									pdPrice + 2*i), __ATOMIC_RELAXED);
+				});
+		});
+		return nGood;
+	}
+
+private:
+	tbb::task_arena arena;
+};
+#endif // HAVE_TBB
+
+Engine *Engine::create(int iBackend, const Options &opt)
+{
+	if (iBackend == BACKEND_AUTO) {
+		fprintf(stderr, "Error: pick the backend with backend_calibrate() first\n");
+		return NULL;
+	}
+	if (iBackend < 0 || iBackend >= BACKEND_NBACKENDS) {
+		fprintf(stderr, "Error: unknown backend %d\n", iBackend);
+		return NULL;
+	}
+	if (!backend_available(iBackend)) {
+		fprintf(stderr, "Error: the %s backend is not built in (make version=%s)\n",
+				backend_name[iBackend], backend_name[iBackend]);
+		return NULL;
+	}
+	if (opt.nThreads < 1 || opt.nThreads > ENGINE_MAX_THREADS) {
+		fprintf(stderr, "Error: number of threads must be between 1 and %d\n", ENGINE_MAX_THREADS);
+		return NULL;
+	}
+	if (iBackend == BACKEND_SERIAL && opt.nThreads != 1) {
+		fprintf(stderr, "Error: number of threads must be 1 (serial backend)\n");
+		return NULL;
+	}
+	if (opt.lTrials < 2) {
+		fprintf(stderr, "Error: need at least 2 simulations per swaption\n");
+		return NULL;
+	}
+	if (opt.iRng < 0 || opt.iRng >= RNG_NGENS || opt.iIcdfAlg < 0 || opt.iIcdfAlg >= ICDF_NALGS
+			|| opt.iIcdfIsa < ICDF_AUTO || opt.iIcdfIsa >= ICDF_NISAS) {
+		fprintf(stderr, "Error: unknown random number generator or inverse normal\n");
+		return NULL;
+	}
+
+	rng_select(opt.iRng);
+	icdf_select(opt.iIcdfAlg, opt.iIcdfIsa);
+
+	switch (iBackend) {
+	case BACKEND_PTHREADS: {
+		PthreadsEngine *pEngine = new PthreadsEngine(opt);
+		if (pEngine->started() == 0) {
+			fprintf(stderr, "Error: cannot start any worker thread\n");
+			delete pEngine;
+			return NULL;
+		}
+		return pEngine;
+	}
+#ifdef HAVE_TBB
+	case BACKEND_TBB:
+		return new TbbEngine(opt);
+#endif
+	default:
+		return new SerialEngine(opt);
+	}
+}
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int backend_calibrate(const Options &opt, const parm *pSwaptions, int nSwaptions, double *pdRate)
+{
+	Options cal = opt;
+	Engine *pEngine;
+	FTYPE *pdPrice;
+	double t0, dRate, dBest = 0.0;
+	int b, iBest = opt.nThreads == 1 ? BACKEND_SERIAL : BACKEND_PTHREADS;
+	int n = nSwaptions < 2*opt.nThreads ? nSwaptions : 2*opt.nThreads;
+
+	if (pdRate)
+		for (b = 0; b < BACKEND_NBACKENDS; b++)
+			pdRate[b] = 0.0;
+	// one thread is the serial backend; timing a book not well above the
+	// calibration's own ~6 batches of CALIBRATE_PATHS would cost more than
+	// it could save
+	if (n < 1 || opt.nThreads == 1 || (double)nSwaptions * opt.lTrials < (double)CALIBRATE_MIN_BOOK * CALIBRATE_PATHS)
+		return iBest;
+
+	// the same number of swaptions per worker as the book, fewer paths each
+	cal.lTrials = CALIBRATE_PATHS / n / BLOCK_SIZE * BLOCK_SIZE;
+	if (cal.lTrials < 2*BLOCK_SIZE)
+		cal.lTrials = 2*BLOCK_SIZE;
+	if (cal.lTrials > opt.lTrials)
+		cal.lTrials = opt.lTrials;
+
+	pdPrice = (FTYPE *)malloc(sizeof(FTYPE)*2*n);
+	for (b = 0; b < BACKEND_NBACKENDS; b++) {
+		if (!backend_available(b) || (b == BACKEND_SERIAL && opt.nThreads != 1))
+			continue;
+		pEngine = Engine::create(b, cal);
+		if (!pEngine)
+			continue;
+		// the first batch starts the pool and warms the caches
+		pEngine->price(pSwaptions, n, pdPrice);
+		t0 = now();
+		if (pEngine->price(pSwaptions, n, pdPrice) == n) {
+			dRate = n * cal.lTrials / (now() - t0);
+			if (pdRate)
+				pdRate[b] = dRate;
+			if (dRate > dBest) {
+				dBest = dRate;
+				iBest = b;
+			}
+		}
+		delete pEngine;
+	}
+	free(pdPrice);
+	return iBest;
+}
+
+} // namespace hjm
@@ -0,0 +1,92 @@
+#ifndef __HJM_ENGINE__
+#define __HJM_ENGINE__
+
+// In-process pricing API (libhjm.a).
+//
+//   hjm::Options opt;                 // defaults as the swaptions CLI
+//   opt.nThreads = 8;
+//   hjm::Engine *pEngine = hjm::Engine::create(hjm::BACKEND_PTHREADS, opt);
+//   pEngine->price(pSwaptions, nSwaptions, pdPrice);
+//   delete pEngine;
+//
+// A swaption is a parm: term sheet, curve (pdYield) and factor volatilities
+// (ppdFactors); its Id selects the random number stream, so a swaption prices
+// the same in every backend and batch. The results are nSwaptions
+// price/stderr pairs, -1 -1 for a swaption that failed.
+//
+// The backend is chosen at run time among those linked into the library:
+// serial and pthreads always, tbb in version=tbb and version=all builds
+// (HAVE_TBB). BACKEND_AUTO stands for the fastest of them on a given book,
+// which backend_calibrate() measures. The engine keeps its worker pool
+// between price() calls. The OpenCL and MPI versions drive their devices from
+// the CLI and are not engines.
+
+#include "HJM_type.h"
+
+namespace hjm {
+
+enum { BACKEND_SERIAL, BACKEND_PTHREADS, BACKEND_TBB, BACKEND_NBACKENDS, BACKEND_AUTO = -2 };
+
+extern const char *backend_name[BACKEND_NBACKENDS];
+
+int backend_parse(const char *szBackend);	// -1 if unknown, BACKEND_AUTO for "auto"
+int backend_available(int iBackend);
+int backend_default();						// the backend of the make version, may be BACKEND_AUTO
+
+struct Options
+{
+	int nThreads;		// worker pool (pthreads, tbb)
+	long lTrials;		// simulations per swaption
+	long lSeed;			// base seed, stream Id of each swaption on top
+	int iRng;			// rng.h; the generator and the inverse normal are
+	int iIcdfAlg;		// process wide, create() selects them
+	int iIcdfIsa;
+
+	Options();
+};
+
+class Engine
+{
+public:
+	// NULL (with a message on stderr) if the backend is not linked in, the
+	// options are invalid or no worker thread could be started
+	static Engine *create(int iBackend, const Options &opt);
+	virtual ~Engine() {}
+
+	// Prices pSwaptions[0..nSwaptions-1] into pdPrice[2*i], pdPrice[2*i+1].
+	// Returns the number of swaptions priced successfully. One engine prices
+	// one batch at a time.
+	virtual int price(const parm *pSwaptions, int nSwaptions, FTYPE *pdPrice) = 0;
+
+	// Progressive pricing: continues swaption i from pStates[i] (zeroed to
+	// start) up to lTrials paths and prices the paths simulated so far.
+	// Calls with growing lTrials refine the book without redoing a path, and
+	// the one with opt.lTrials simulates the paths of price(). lTrials should
+	// be a multiple of BLOCK_SIZE up to the last call. Swaptions are not split
+	// over workers here.
+	virtual int refine(const parm *pSwaptions, int nSwaptions, swaption_state *pStates, long lTrials,
+			FTYPE *pdPrice) = 0;
+
+	int backend() const { return iBackend; }
+	const Options &options() const { return opt; }
+
+protected:
+	Engine(int iBackend, const Options &opt) : iBackend(iBackend), opt(opt), bPipeline(iBackend == BACKEND_TBB) {}
+	int price_one(const parm *p, FTYPE *pdPrice);
+	int price_state(const parm *p, swaption_state *pState, long lTrials, FTYPE *pdPrice);
+	int price_part(const parm *p, long lFirst, long lLast, ksum *pSum, ksum *pSumSquare);
+
+	int iBackend;
+	Options opt;
+	int bPipeline;		// simulate with the TBB pipeline (HJM_Swaption_Simulate)
+};
+
+// Times every available backend on the first swaptions of the book (at most
+// 2*nThreads of them, 32768 paths in total) and returns the fastest. pdRate, if not NULL, receives paths/s per backend, 0 for those
+// not measured. One thread returns the serial backend and a book under 64x
+// those paths the pthreads one, both without timing.
+int backend_calibrate(const Options &opt, const parm *pSwaptions, int nSwaptions, double *pdRate);
+
+} // namespace hjm
+
+#endif //__HJM_ENGINE__
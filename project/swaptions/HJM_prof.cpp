@@ -0,0 +1,182 @@
+//HJM_prof.cpp
+//Per-thread phase timers and optional perf_event counters (see HJM_prof.h).
+
+#ifdef ENABLE_PROF
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef ENABLE_PERF_EVENTS
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROF_USE_TSC
+#endif
+
+#include "HJM_prof.h"
+
+#define MAX_PROF_THREADS 1024
+
+static const char *szPhaseName[PROF_NPHASES] = { "rng", "icdf", "path", "discount", "payoff" };
+#ifdef ENABLE_PERF_EVENTS
+static const char *szCounterName[PROF_NCOUNTERS] = { "cycles", "instructions", "cache-misses" };
+#endif
+
+static prof_thread *prof_threads[MAX_PROF_THREADS];
+static int nProfThreads = 0;
+static pthread_mutex_t prof_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread prof_thread *prof_self = NULL;
+
+// reference points to convert TSC ticks into seconds
+static unsigned long long ullTicks0;
+static struct timespec prof_t0;
+
+unsigned long long HJM_Prof_Ticks()
+{
+#ifdef PROF_USE_TSC
+	return __rdtsc();
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (unsigned long long)t.tv_sec * 1000000000ULL + t.tv_nsec;
+#endif
+}
+
+#ifdef ENABLE_PERF_EVENTS
+static int perf_open(unsigned long long ullConfig, int iGroupFd)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = ullConfig;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.disabled = (iGroupFd == -1);
+
+	// this thread only, any cpu
+	return syscall(__NR_perf_event_open, &attr, 0, -1, iGroupFd, 0);
+}
+#endif
+
+void HJM_Prof_Read_Counters(prof_thread *pt, unsigned long long *pullCounters)
+{
+#ifdef ENABLE_PERF_EVENTS
+	unsigned long long ullBuf[1 + PROF_NCOUNTERS];
+
+	if (pt->iPerfFd >= 0 && read(pt->iPerfFd, ullBuf, sizeof(ullBuf)) == sizeof(ullBuf)) {
+		for (int c = 0; c < PROF_NCOUNTERS; c++)
+			pullCounters[c] = ullBuf[1 + c];
+		return;
+	}
+#endif
+	for (int c = 0; c < PROF_NCOUNTERS; c++)
+		pullCounters[c] = 0;
+}
+
+prof_thread *HJM_Prof_Thread()
+{
+	prof_thread *pt = prof_self;
+
+	if (pt)
+		return pt;
+
+	pt = (prof_thread *)calloc(1, sizeof(prof_thread));
+	pt->iPerfFd = -1;
+
+#ifdef ENABLE_PERF_EVENTS
+	pt->iPerfFd = perf_open(PERF_COUNT_HW_CPU_CYCLES, -1);
+	if (pt->iPerfFd >= 0) {
+		if (perf_open(PERF_COUNT_HW_INSTRUCTIONS, pt->iPerfFd) < 0 ||
+				perf_open(PERF_COUNT_HW_CACHE_MISSES, pt->iPerfFd) < 0) {
+			close(pt->iPerfFd);
+			pt->iPerfFd = -1;
+		} else {
+			ioctl(pt->iPerfFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		}
+	}
+#endif
+
+	pthread_mutex_lock(&prof_lock);
+	if (nProfThreads == 0) {
+		clock_gettime(CLOCK_MONOTONIC, &prof_t0);
+		ullTicks0 = HJM_Prof_Ticks();
+	}
+	if (nProfThreads < MAX_PROF_THREADS)
+		prof_threads[nProfThreads++] = pt;
+	pthread_mutex_unlock(&prof_lock);
+
+	prof_self = pt;
+	return pt;
+}
+
+void HJM_Prof_Report()
+{
+	int t, p, c;
+	int bCounters = 0;
+	double dTicksPerSec;
+	double dTotal = 0.0;
+	double pdSec[PROF_NPHASES];
+	unsigned long long ullCalls[PROF_NPHASES];
+	unsigned long long ullCounters[PROF_NPHASES][PROF_NCOUNTERS];
+	struct timespec t1;
+
+	if (nProfThreads == 0)
+		return;
+
+	// ticks per second, measured over the whole run
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	dTicksPerSec = (HJM_Prof_Ticks() - ullTicks0) /
+		((t1.tv_sec - prof_t0.tv_sec) + (t1.tv_nsec - prof_t0.tv_nsec) * 1e-9);
+
+	for (t = 0; t < nProfThreads; t++)
+		if (prof_threads[t]->iPerfFd >= 0)
+			bCounters = 1;
+
+	memset(ullCalls, 0, sizeof(ullCalls));
+	memset(ullCounters, 0, sizeof(ullCounters));
+	for (p = 0; p < PROF_NPHASES; p++) {
+		pdSec[p] = 0.0;
+		for (t = 0; t < nProfThreads; t++) {
+			pdSec[p] += prof_threads[t]->ullTicks[p] / dTicksPerSec;
+			ullCalls[p] += prof_threads[t]->ullCalls[p];
+			for (c = 0; c < PROF_NCOUNTERS; c++)
+				ullCounters[p][c] += prof_threads[t]->ullCounters[p][c];
+		}
+		dTotal += pdSec[p];
+	}
+
+	// summed over threads, i.e. CPU seconds spent in each phase
+	printf("[ Phase breakdown, %d thread(s) ]\n", nProfThreads);
+#ifdef ENABLE_PERF_EVENTS
+	if (!bCounters)
+		printf("perf_event counters unavailable (check /proc/sys/kernel/perf_event_paranoid)\n");
+#endif
+	for (p = 0; p < PROF_NPHASES; p++) {
+		printf("Phase %s: %.6f (%5.1f%%, %llu calls)\n", szPhaseName[p], pdSec[p],
+				dTotal > 0 ? 100.0 * pdSec[p] / dTotal : 0.0, ullCalls[p]);
+#ifdef ENABLE_PERF_EVENTS
+		for (c = 0; c < PROF_NCOUNTERS && bCounters; c++)
+			printf("\t%s: %llu\n", szCounterName[c], ullCounters[p][c]);
+#endif
+	}
+
+	for (t = 0; t < nProfThreads; t++) {
+		printf("Thread %d:", t);
+		for (p = 0; p < PROF_NPHASES; p++)
+			printf(" %s %.4f", szPhaseName[p], prof_threads[t]->ullTicks[p] / dTicksPerSec);
+		printf("\n");
+	}
+}
+
+#endif // ENABLE_PROF
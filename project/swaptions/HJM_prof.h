@@ -0,0 +1,81 @@
+#ifndef __HJM_PROF__
+#define __HJM_PROF__
+
+// Per-phase hot-path instrumentation.
+//
+// Build with "make prof=1" (timers only) or "make prof=perf" (timers plus
+// perf_event counters for cycles, instructions and cache misses). Without
+// ENABLE_PROF every macro below expands to nothing.
+//
+// PROF_SCOPE(phase) times the rest of the enclosing block. Timings are kept
+// per thread and summed by HJM_Prof_Report(), which prints one
+// "Phase <name>: <seconds>" line per phase (the format swaptions_bench reads).
+
+enum {
+	PROF_RNG,		// RanUnif
+	PROF_ICDF,		// CumNormalInv
+	PROF_PATH,		// HJM path evolution
+	PROF_DISCOUNT,	// payoff discount factors (Discount_Factors_Blocking, or folded into
+					// the rolling path a step at a time)
+	PROF_PAYOFF,	// swap discounting, fixed leg valuation and accumulation
+	PROF_NPHASES
+};
+
+#ifdef ENABLE_PROF
+
+#define PROF_NCOUNTERS 3 // cycles, instructions, cache misses
+
+typedef struct
+{
+	unsigned long long ullTicks[PROF_NPHASES];
+	unsigned long long ullCalls[PROF_NPHASES];
+	unsigned long long ullCounters[PROF_NPHASES][PROF_NCOUNTERS];
+	int iPerfFd;	// perf_event group leader, -1 if unavailable
+} prof_thread;
+
+prof_thread *HJM_Prof_Thread();
+unsigned long long HJM_Prof_Ticks();
+void HJM_Prof_Read_Counters(prof_thread *pt, unsigned long long *pullCounters);
+void HJM_Prof_Report();
+
+class HJM_Prof_Scope
+{
+public:
+	HJM_Prof_Scope(int iPhase) : iPhase(iPhase)
+	{
+		pt = HJM_Prof_Thread();
+#ifdef ENABLE_PERF_EVENTS
+		HJM_Prof_Read_Counters(pt, ullCounters);
+#endif
+		ullStart = HJM_Prof_Ticks();
+	}
+	~HJM_Prof_Scope()
+	{
+		pt->ullTicks[iPhase] += HJM_Prof_Ticks() - ullStart;
+		pt->ullCalls[iPhase]++;
+#ifdef ENABLE_PERF_EVENTS
+		unsigned long long ullEnd[PROF_NCOUNTERS];
+		HJM_Prof_Read_Counters(pt, ullEnd);
+		for (int c = 0; c < PROF_NCOUNTERS; c++)
+			pt->ullCounters[iPhase][c] += ullEnd[c] - ullCounters[c];
+#endif
+	}
+private:
+	int iPhase;
+	prof_thread *pt;
+	unsigned long long ullStart;
+#ifdef ENABLE_PERF_EVENTS
+	unsigned long long ullCounters[PROF_NCOUNTERS];
+#endif
+};
+
+#define PROF_SCOPE(phase) HJM_Prof_Scope __prof_scope(phase)
+
+#else
+
+#define PROF_SCOPE(phase)
+#define HJM_Prof_Report()
+
+#endif // ENABLE_PROF
+
+#endif //__HJM_PROF__
@@ -0,0 +1,337 @@
+//HJM_schedule.cpp
+//Deadline- and priority-aware pricing of the book (-jobs).
+//
+//Every swaption is a job with a priority, an optional deadline and an
+//optional release time, all relative to the start of pricing. The workers
+//take jobs from one priority queue (a binary heap under a mutex): higher
+//priority first, then earlier deadline, then lower index. A job is simulated
+//-slice trials at a time through its swaption_state and goes back to the
+//queue after every slice, so a job released later with a higher priority or
+//an earlier deadline takes over the next free worker at a trial-block
+//boundary. A job continues its own paths, so the prices are those of a
+//plain run.
+//
+//Job file, one swaption per line, '#' comments:
+//  <swaption> <priority> <deadline in ms, - for none> [<release in ms>]
+//Swaptions not in the file run at priority 0 without a deadline.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "HJM_type.h"
+#include "HJM.h"
+#include "rng.h"
+
+static parm *pSchedSwaptions;
+static const swaption_job *pSchedJobs;
+static swaption_state *pSchedStates;
+static long lSchedTrials, lSchedSlice, lSchedSeed;
+static void (*pfnSchedInit)(int);
+static struct timespec schedStart;
+
+// ready jobs, a heap on job_before; jobs not yet released, by release time
+static int *piHeap, nHeap;
+static int *piPending, nPending, iNextPending;
+static int nFinished, nSwaptionsLeft, nPreemptions;
+static int *pbStarted;
+static long *plFinishUs;
+static pthread_mutex_t schedLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t schedWake = PTHREAD_COND_INITIALIZER;	// a job was queued or finished
+
+int HJM_Read_Jobs(const char *pszFile, int nSwaptions, swaption_job **ppJobs)
+{
+	FILE *fp;
+	char szLine[256], szDeadline[32];
+	swaption_job *pJobs;
+	double dDeadlineMs, dReleaseMs;
+	int i, n, iPriority, nJobs = 0;
+
+	fp = fopen(pszFile, "r");
+	if (!fp) {
+		fprintf(stderr, "Error: cannot open job file %s\n", pszFile);
+		return 0;
+	}
+
+	pJobs = (swaption_job *)calloc(nSwaptions, sizeof(swaption_job));
+	while (fgets(szLine, sizeof(szLine), fp)) {
+		if (szLine[0] == '#' || szLine[0] == '\n')
+			continue;
+		dReleaseMs = 0.0;
+		dDeadlineMs = 0.0;
+		n = sscanf(szLine, "%d %d %31s %lf", &i, &iPriority, szDeadline, &dReleaseMs);
+		if (n < 3 || i < 0 || i >= nSwaptions || dReleaseMs < 0.0 ||
+				(strcmp(szDeadline, "-") && (sscanf(szDeadline, "%lf", &dDeadlineMs) != 1 || dDeadlineMs <= 0.0))) {
+			fprintf(stderr, "Error: malformed job line (or no such swaption): %s", szLine);
+			free(pJobs);
+			fclose(fp);
+			return 0;
+		}
+		pJobs[i].iPriority = iPriority;
+		pJobs[i].lDeadlineUs = (long)(dDeadlineMs * 1000.0);
+		pJobs[i].lReleaseUs = (long)(dReleaseMs * 1000.0);
+		nJobs++;
+	}
+	fclose(fp);
+	if (nJobs == 0) {
+		fprintf(stderr, "Error: no jobs in %s\n", pszFile);
+		free(pJobs);
+		return 0;
+	}
+
+	*ppJobs = pJobs;
+	return nJobs;
+}
+
+static long sched_now_us()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - schedStart.tv_sec) * 1000000L + (now.tv_nsec - schedStart.tv_nsec) / 1000;
+}
+
+// Does job a run before job b?
+static int job_before(int a, int b)
+{
+	const swaption_job *pA = &pSchedJobs[a], *pB = &pSchedJobs[b];
+
+	if (pA->iPriority != pB->iPriority)
+		return pA->iPriority > pB->iPriority;
+	if (pA->lDeadlineUs != pB->lDeadlineUs) {
+		if (pA->lDeadlineUs == 0 || pB->lDeadlineUs == 0)
+			return pB->lDeadlineUs == 0;
+		return pA->lDeadlineUs < pB->lDeadlineUs;
+	}
+	return a < b;
+}
+
+static void heap_push(int i)
+{
+	int k = nHeap++, up;
+
+	for (; k > 0 && job_before(i, piHeap[up = (k-1)/2]); k = up)
+		piHeap[k] = piHeap[up];
+	piHeap[k] = i;
+}
+
+static int heap_pop()
+{
+	int top = piHeap[0], last = piHeap[--nHeap];
+	int k = 0, c;
+
+	while ((c = 2*k + 1) < nHeap) {
+		if (c+1 < nHeap && job_before(piHeap[c+1], piHeap[c]))
+			c++;
+		if (!job_before(piHeap[c], last))
+			break;
+		piHeap[k] = piHeap[c];
+		k = c;
+	}
+	piHeap[k] = last;
+	return top;
+}
+
+static int by_priority_desc(const void *a, const void *b)
+{
+	int ia = *(const int *)a, ib = *(const int *)b;
+
+	return ia > ib ? -1 : ia < ib;
+}
+
+static int by_release(const void *a, const void *b)
+{
+	long la = pSchedJobs[*(const int *)a].lReleaseUs, lb = pSchedJobs[*(const int *)b].lReleaseUs;
+
+	return la < lb ? -1 : la > lb;
+}
+
+// Moves the jobs released by lNow to the queue; called with schedLock held
+static void release_due(long lNow)
+{
+	while (iNextPending < nPending && pSchedJobs[piPending[iNextPending]].lReleaseUs <= lNow)
+		heap_push(piPending[iNextPending++]);
+}
+
+// Next job to run, -1 once every job is finished; called with schedLock held
+static int next_job()
+{
+	struct timespec until;
+	long lNow, lWait;
+
+	for (;;) {
+		lNow = sched_now_us();
+		release_due(lNow);
+		if (nHeap > 0)
+			return heap_pop();
+		if (nSwaptionsLeft == 0)
+			return -1;
+		if (iNextPending < nPending) {
+			// sleep until the next release, or until a job comes back
+			lWait = pSchedJobs[piPending[iNextPending]].lReleaseUs - lNow;
+			clock_gettime(CLOCK_REALTIME, &until);
+			until.tv_sec += lWait / 1000000;
+			until.tv_nsec += (lWait % 1000000) * 1000;
+			if (until.tv_nsec >= 1000000000) {
+				until.tv_sec++;
+				until.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&schedWake, &schedLock, &until);
+		} else
+			pthread_cond_wait(&schedWake, &schedLock);
+	}
+}
+
+static void *sched_worker(void *arg)
+{
+	FTYPE pdSwaptionPrice[2];
+	parm *p;
+	long lEnd;
+	int i, iLast = -1;
+
+	(void)arg;
+	pthread_mutex_lock(&schedLock);
+	while ((i = next_job()) >= 0) {
+		// the job this worker was running went back to the queue for another
+		if (iLast >= 0 && i != iLast && plFinishUs[iLast] < 0)
+			nPreemptions++;
+		pthread_mutex_unlock(&schedLock);
+
+		if (!pbStarted[i]) {
+			pbStarted[i] = 1;
+			if (pfnSchedInit)
+				pfnSchedInit(i);
+		}
+		p = &pSchedSwaptions[i];
+		lEnd = pSchedStates[i].lTrialsDone + lSchedSlice;
+		if (lEnd > lSchedTrials)
+			lEnd = lSchedTrials;
+		if (HJM_Swaption_Blocking_Resume(pdSwaptionPrice, p->dStrike, p->dCompounding, p->dMaturity,
+					p->dTenor, p->dPaymentInterval, p->iN, p->iFactors, p->dYears, p->pdYield, p->ppdFactors,
+					rng_stream(lSchedSeed, i), lEnd, BLOCK_SIZE, &pSchedStates[i]) != 1) {
+			pdSwaptionPrice[0] = pdSwaptionPrice[1] = -1.0;
+			lEnd = lSchedTrials;
+		}
+
+		pthread_mutex_lock(&schedLock);
+		if (lEnd >= lSchedTrials) {
+			p->dSimSwaptionMeanPrice = pdSwaptionPrice[0];
+			p->dSimSwaptionStdError = pdSwaptionPrice[1];
+			plFinishUs[i] = sched_now_us();
+			if (pdSwaptionPrice[0] >= 0.0)
+				nFinished++;
+			nSwaptionsLeft--;
+		} else
+			heap_push(i);
+		iLast = i;
+		pthread_cond_broadcast(&schedWake);
+	}
+	pthread_mutex_unlock(&schedLock);
+	return NULL;
+}
+
+// Deadline hits and misses, overall and per priority from the highest
+static void sched_report(int nSwaptions)
+{
+	int *piPrio = (int *)malloc(sizeof(int) * nSwaptions);
+	int i, k, nPrio = 0, nMet, nMissed, nMetAll = 0, nMissedAll = 0;
+	long lLate, lWorst = 0;
+
+	for (i = 0; i < nSwaptions; i++) {
+		if (pSchedJobs[i].lDeadlineUs == 0)
+			continue;
+		piPrio[nPrio++] = pSchedJobs[i].iPriority;
+		lLate = plFinishUs[i] - pSchedJobs[i].lDeadlineUs;
+		if (lLate > 0) {
+			nMissedAll++;
+			if (lLate > lWorst)
+				lWorst = lLate;
+		} else
+			nMetAll++;
+	}
+	printf("Jobs: %d deadlines, %d met, %d missed", nMetAll + nMissedAll, nMetAll, nMissedAll);
+	if (nMissedAll > 0)
+		printf(", worst by %ld.%03ld ms", lWorst / 1000, lWorst % 1000);
+	printf(", %d preemptions\n", nPreemptions);
+
+	qsort(piPrio, nPrio, sizeof(int), by_priority_desc);
+	for (k = 0; k < nPrio; k++) {
+		if (k > 0 && piPrio[k] == piPrio[k-1])
+			continue;
+		nMet = nMissed = 0;
+		for (i = 0; i < nSwaptions; i++)
+			if (pSchedJobs[i].lDeadlineUs && pSchedJobs[i].iPriority == piPrio[k]) {
+				if (plFinishUs[i] > pSchedJobs[i].lDeadlineUs)
+					nMissed++;
+				else
+					nMet++;
+			}
+		printf("  priority %d: %d met, %d missed\n", piPrio[k], nMet, nMissed);
+	}
+	free(piPrio);
+
+	for (i = 0; i < nSwaptions; i++)
+		if (pSchedJobs[i].lDeadlineUs && plFinishUs[i] > pSchedJobs[i].lDeadlineUs) {
+			lLate = plFinishUs[i] - pSchedJobs[i].lDeadlineUs;
+			fprintf(stderr, "Swaption%d missed its %ld.%03ld ms deadline by %ld.%03ld ms (priority %d)\n", i,
+					pSchedJobs[i].lDeadlineUs / 1000, pSchedJobs[i].lDeadlineUs % 1000,
+					lLate / 1000, lLate % 1000, pSchedJobs[i].iPriority);
+		}
+}
+
+// Prices pSwaptions on nThreads workers in job order, lSlice trials at a
+// time (rounded up to whole blocks), continuing pStates (zeroed to start).
+// pfnInit, if not NULL, builds a swaption before its first slice. Returns the
+// number of swaptions priced successfully.
+int HJM_Schedule(parm *pSwaptions, int nSwaptions, const swaption_job *pJobs, swaption_state *pStates,
+		void (*pfnInit)(int), int nThreads, long lTrials, long lSlice, long lSeed)
+{
+	pthread_t *pThreads;
+	int *pbThreadStarted;
+	int i, t;
+
+	pSchedSwaptions = pSwaptions;
+	pSchedJobs = pJobs;
+	pSchedStates = pStates;
+	pfnSchedInit = pfnInit;
+	lSchedTrials = lTrials;
+	lSchedSlice = (lSlice + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+	if (lSchedSlice < BLOCK_SIZE)
+		lSchedSlice = BLOCK_SIZE;
+	lSchedSeed = lSeed;
+
+	piHeap = (int *)malloc(sizeof(int) * nSwaptions);
+	piPending = (int *)malloc(sizeof(int) * nSwaptions);
+	pbStarted = (int *)calloc(nSwaptions, sizeof(int));
+	plFinishUs = (long *)malloc(sizeof(long) * nSwaptions);
+	nHeap = nPending = iNextPending = 0;
+	nFinished = nPreemptions = 0;
+	nSwaptionsLeft = nSwaptions;
+	for (i = 0; i < nSwaptions; i++) {
+		piPending[nPending++] = i;
+		plFinishUs[i] = -1;
+	}
+	qsort(piPending, nPending, sizeof(int), by_release);
+
+	clock_gettime(CLOCK_MONOTONIC, &schedStart);
+	pThreads = (pthread_t *)malloc(sizeof(pthread_t) * nThreads);
+	pbThreadStarted = (int *)calloc(nThreads, sizeof(int));
+	for (t = 1; t < nThreads; t++)
+		pbThreadStarted[t] = pthread_create(&pThreads[t], NULL, sched_worker, NULL) == 0;
+	sched_worker(NULL);
+	for (t = 1; t < nThreads; t++)
+		if (pbThreadStarted[t])
+			pthread_join(pThreads[t], NULL);
+
+	sched_report(nSwaptions);
+
+	free(pbThreadStarted);
+	free(pThreads);
+	free(plFinishUs);
+	free(pbStarted);
+	free(piPending);
+	free(piHeap);
+	return nFinished;
+}
@@ -0,0 +1,400 @@
+//HJM_server.cpp
+//Pricing service mode (-serve): a long-running process that keeps its worker
+//threads and the HJM curve/factor set warm and prices swaptions sent over a
+//Unix domain socket.
+//
+//Protocol (text, one connection may send any number of requests):
+//  request:  one swaption per line, "<strike> [<maturity> <tenor> <payment interval> [<compounding>]]",
+//            terminated by an empty line (or by closing the write side)
+//  response: one "<price> <stderr>" line per swaption, in request order,
+//            followed by an empty line; a malformed or overlong line, and every
+//            line after the first MAX_REQUEST_SWAPTIONS, is answered "nan nan"
+//A line "shutdown" stops the server.
+//
+//Requests that arrive while a batch is running, or within the batching
+//window, are coalesced into one batch that the worker pool prices together.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "HJM_type.h"
+#include "HJM.h"
+
+#define MAX_REQUEST_SWAPTIONS 65536
+
+typedef struct request
+{
+	int nSwaptions;
+	parm *pSwaptions;		// only the term sheet fields are used, Id -1 marks a malformed line
+	FTYPE *pdPrice;			// nSwaptions price/stderr pairs
+	int nDropped;			// lines after MAX_REQUEST_SWAPTIONS, answered "nan nan"
+	int bDone;
+	struct request *pNext;
+} request;
+
+typedef struct
+{
+	request *pReq;
+	int iSwaption;
+} job;
+
+// warm engine
+static int iSrvN, iSrvFactors, nSrvThreads;
+static FTYPE dSrvYears;
+static FTYPE *pdSrvYield;
+static FTYPE **ppdSrvFactors;
+static long lSrvTrials;
+static int iSrvWindowUs;
+
+// request queue, filled by the connection threads and drained by the batcher
+static request *pQueueHead, *pQueueTail;
+static pthread_mutex_t srvLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t srvQueued = PTHREAD_COND_INITIALIZER;	// a request was queued
+static pthread_cond_t srvDone = PTHREAD_COND_INITIALIZER;	// a batch finished
+
+// current batch, shared with the worker pool
+static job *pBatch;
+static int nBatch;
+static int iBatchNext;
+static int nBatchLeft;
+static unsigned uBatchGen;
+static pthread_cond_t srvBatch = PTHREAD_COND_INITIALIZER;	// a batch was posted
+
+// set by SIGINT/SIGTERM and by a "shutdown" request, read by every thread:
+// only through __atomic, which on an int is lock-free and so also safe in
+// the signal handler
+static int bSrvStop = 0;
+
+static int srv_stopping(void)
+{
+	return __atomic_load_n(&bSrvStop, __ATOMIC_ACQUIRE);
+}
+
+static void srv_stop(int sig)
+{
+	(void)sig;
+	__atomic_store_n(&bSrvStop, 1, __ATOMIC_RELEASE);
+}
+
+static void price_job(job *pJob)
+{
+	parm *p = &pJob->pReq->pSwaptions[pJob->iSwaption];
+	FTYPE *pdPrice = pJob->pReq->pdPrice + 2*pJob->iSwaption;
+
+	if (p->Id < 0 || HJM_Swaption_Blocking(pdPrice, p->dStrike, p->dCompounding, p->dMaturity, p->dTenor,
+				p->dPaymentInterval, iSrvN, iSrvFactors, dSrvYears, pdSrvYield, ppdSrvFactors,
+				RANDSEEDVAL, lSrvTrials, BLOCK_SIZE, 0) != 1)
+		pdPrice[0] = pdPrice[1] = -1.0;
+}
+
+static void *srv_worker(void *arg)
+{
+	unsigned uSeen = 0;
+	int i;
+
+	(void)arg;
+	pthread_mutex_lock(&srvLock);
+	for (;;) {
+		while (uBatchGen == uSeen && !srv_stopping())
+			pthread_cond_wait(&srvBatch, &srvLock);
+		// a posted batch is always finished, the batcher waits for it
+		if (uBatchGen == uSeen)
+			break;
+		uSeen = uBatchGen;
+		pthread_mutex_unlock(&srvLock);
+
+		// swaptions are handed out one at a time so that small and large
+		// requests in the same batch balance over the pool
+		while ((i = __atomic_fetch_add(&iBatchNext, 1, __ATOMIC_RELAXED)) < nBatch)
+			price_job(&pBatch[i]);
+
+		pthread_mutex_lock(&srvLock);
+		if (--nBatchLeft == 0)
+			pthread_cond_broadcast(&srvDone);
+	}
+	pthread_mutex_unlock(&srvLock);
+	return NULL;
+}
+
+static void *srv_batcher(void *arg)
+{
+	request *pReqs, *pReq;
+	struct timespec deadline;
+	int n, s;
+
+	(void)arg;
+	pBatch = NULL;
+	pthread_mutex_lock(&srvLock);
+	while (!srv_stopping()) {
+		if (!pQueueHead) {
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_nsec += 100000000;
+			if (deadline.tv_nsec >= 1000000000) { deadline.tv_sec++; deadline.tv_nsec -= 1000000000; }
+			pthread_cond_timedwait(&srvQueued, &srvLock, &deadline);
+			continue;
+		}
+
+		// give concurrent clients a short window to join this batch
+		if (iSrvWindowUs > 0) {
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_nsec += (long)iSrvWindowUs * 1000;
+			while (deadline.tv_nsec >= 1000000000) { deadline.tv_sec++; deadline.tv_nsec -= 1000000000; }
+			while (pthread_cond_timedwait(&srvQueued, &srvLock, &deadline) != ETIMEDOUT && !srv_stopping())
+				;
+		}
+
+		pReqs = pQueueHead;
+		pQueueHead = pQueueTail = NULL;
+
+		n = 0;
+		for (pReq = pReqs; pReq; pReq = pReq->pNext)
+			n += pReq->nSwaptions;
+		pBatch = (job *)realloc(pBatch, sizeof(job) * (n > 0 ? n : 1));
+		n = 0;
+		for (pReq = pReqs; pReq; pReq = pReq->pNext)
+			for (s = 0; s < pReq->nSwaptions; s++) {
+				pBatch[n].pReq = pReq;
+				pBatch[n].iSwaption = s;
+				n++;
+			}
+
+		nBatch = n;
+		iBatchNext = 0;
+		nBatchLeft = nSrvThreads;
+		uBatchGen++;
+		pthread_cond_broadcast(&srvBatch);
+		while (nBatchLeft > 0)
+			pthread_cond_wait(&srvDone, &srvLock);
+
+		for (pReq = pReqs; pReq; pReq = pReq->pNext)
+			pReq->bDone = 1;
+		pthread_cond_broadcast(&srvDone);
+	}
+
+	// requests that never made it into a batch are answered with failures
+	for (pReq = pQueueHead; pReq; pReq = pReq->pNext) {
+		for (s = 0; s < pReq->nSwaptions; s++)
+			pReq->pSwaptions[s].Id = -1;
+		pReq->bDone = 1;
+	}
+	pQueueHead = pQueueTail = NULL;
+	pthread_cond_broadcast(&srvDone);
+	pthread_mutex_unlock(&srvLock);
+	free(pBatch);
+	return NULL;
+}
+
+// reads one request; returns its swaption count, -1 on EOF without a request
+// and -2 on "shutdown". A line too long for the buffer is read to its end and
+// priced as malformed, so every line still gets its answer.
+static int read_request(FILE *fp, request *pReq, int *pbEof)
+{
+	char szLine[256], szRest[256];
+	parm *p;
+	int n = 0, nField, bLong;
+
+	pReq->pSwaptions = NULL;
+	pReq->nDropped = 0;
+	*pbEof = 0;
+	for (;;) {
+		if (!fgets(szLine, sizeof(szLine), fp)) {
+			*pbEof = 1;
+			break;
+		}
+		bLong = !strchr(szLine, '\n');
+		if (bLong) {
+			szRest[0] = '\0';
+			while (!strchr(szRest, '\n') && fgets(szRest, sizeof(szRest), fp))
+				;
+		}
+		if (szLine[0] == '\n' || (szLine[0] == '\r' && szLine[1] == '\n'))
+			break;
+		if (!bLong && !strncmp(szLine, "shutdown", 8)) {
+			free(pReq->pSwaptions);
+			return -2;
+		}
+		if (n == MAX_REQUEST_SWAPTIONS) {
+			pReq->nDropped++;
+			continue;
+		}
+		if (n % 64 == 0)
+			pReq->pSwaptions = (parm *)realloc(pReq->pSwaptions, sizeof(parm) * (n + 64));
+		p = &pReq->pSwaptions[n];
+		// defaults are those of the benchmark book
+		p->dMaturity = 1;
+		p->dTenor = 2.0;
+		p->dPaymentInterval = 1.0;
+		p->dCompounding = 0;
+		nField = sscanf(szLine, "%lf %lf %lf %lf %lf", &p->dStrike, &p->dMaturity, &p->dTenor,
+				&p->dPaymentInterval, &p->dCompounding);
+		p->Id = (!bLong && nField >= 1 && p->dMaturity >= 0 && p->dTenor > 0 && p->dPaymentInterval > 0 &&
+				p->dMaturity + p->dTenor <= dSrvYears) ? n : -1;
+		n++;
+	}
+	pReq->nSwaptions = n;
+	return (n == 0 && *pbEof) ? -1 : n;
+}
+
+static void *srv_connection(void *arg)
+{
+	int fd = (int)(long)arg;
+	FILE *in = fdopen(fd, "r");
+	FILE *out = fdopen(dup(fd), "w");
+	request req;
+	int n, s, bEof = 0;
+
+	while (!bEof && !srv_stopping()) {
+		n = read_request(in, &req, &bEof);
+		if (n == -2) {
+			srv_stop(0);
+			break;
+		}
+		if (n < 0)
+			break;
+
+		req.pdPrice = (FTYPE *)malloc(sizeof(FTYPE) * 2 * (n > 0 ? n : 1));
+		req.bDone = 0;
+		req.pNext = NULL;
+
+		pthread_mutex_lock(&srvLock);
+		if (pQueueTail)
+			pQueueTail->pNext = &req;
+		else
+			pQueueHead = &req;
+		pQueueTail = &req;
+		pthread_cond_signal(&srvQueued);
+		while (!req.bDone)
+			pthread_cond_wait(&srvDone, &srvLock);
+		pthread_mutex_unlock(&srvLock);
+
+		for (s = 0; s < n; s++) {
+			if (req.pSwaptions[s].Id < 0 || req.pdPrice[2*s] < 0)
+				fprintf(out, "nan nan\n");
+			else
+				fprintf(out, "%.10lf %.10lf\n", req.pdPrice[2*s], req.pdPrice[2*s + 1]);
+		}
+		for (s = 0; s < req.nDropped; s++)
+			fprintf(out, "nan nan\n");
+		fprintf(out, "\n");
+		fflush(out);
+
+		free(req.pdPrice);
+		free(req.pSwaptions);
+	}
+
+	fclose(out);
+	fclose(in);
+	return NULL;
+}
+
+int HJM_Serve(const char *pszSocket,	//Path of the Unix domain socket to listen on
+		int nThreads,					//Size of the worker pool
+		int iN, int iFactors, FTYPE dYears, FTYPE *pdYield, FTYPE **ppdFactors,	//HJM curve and factors
+		long lTrials,					//Simulations per swaption
+		int iWindowUs)					//Batching window in microseconds
+{
+	//This function serves pricing requests until SIGINT/SIGTERM or a
+	//"shutdown" request. Returns 1 on a clean shutdown.
+
+	struct sockaddr_un addr;
+	struct pollfd pfd;
+	pthread_t *workers, batcher, conn;
+	pthread_attr_t detached;
+	int fdListen, fd, t, bBatcher;
+
+	iSrvN = iN;
+	iSrvFactors = iFactors;
+	dSrvYears = dYears;
+	pdSrvYield = pdYield;
+	ppdSrvFactors = ppdFactors;
+	lSrvTrials = lTrials;
+	iSrvWindowUs = iWindowUs;
+
+	fdListen = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fdListen < 0 || strlen(pszSocket) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Error: cannot create socket %s\n", pszSocket);
+		return 0;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, pszSocket);
+	unlink(pszSocket);
+	if (bind(fdListen, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fdListen, 64) != 0) {
+		fprintf(stderr, "Error: cannot listen on %s: %s\n", pszSocket, strerror(errno));
+		close(fdListen);
+		return 0;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, srv_stop);
+	signal(SIGTERM, srv_stop);
+
+	// a batch waits for the workers that started; without any, or without
+	// the batcher, requests would wait forever
+	workers = (pthread_t *)malloc(sizeof(pthread_t) * nThreads);
+	nSrvThreads = 0;
+	for (t = 0; t < nThreads; t++)
+		if (pthread_create(&workers[nSrvThreads], NULL, srv_worker, NULL) == 0)
+			nSrvThreads++;
+	bBatcher = nSrvThreads > 0 && pthread_create(&batcher, NULL, srv_batcher, NULL) == 0;
+	if (!bBatcher) {
+		fprintf(stderr, "Error: cannot start the %s\n", nSrvThreads > 0 ? "batcher thread" : "worker threads");
+		close(fdListen);
+		unlink(pszSocket);
+		srv_stop(0);
+		pthread_mutex_lock(&srvLock);
+		pthread_cond_broadcast(&srvBatch);
+		pthread_mutex_unlock(&srvLock);
+		for (t = 0; t < nSrvThreads; t++)
+			pthread_join(workers[t], NULL);
+		free(workers);
+		return 0;
+	}
+	if (nSrvThreads < nThreads)
+		fprintf(stderr, "Warning: started %d of %d worker threads\n", nSrvThreads, nThreads);
+
+	pthread_attr_init(&detached);
+	pthread_attr_setdetachstate(&detached, PTHREAD_CREATE_DETACHED);
+
+	printf("Serving on %s with %d worker(s), %ld simulations per swaption\n", pszSocket, nSrvThreads, lTrials);
+	fflush(stdout);
+
+	pfd.fd = fdListen;
+	pfd.events = POLLIN;
+	while (!srv_stopping()) {
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+		fd = accept(fdListen, NULL, NULL);
+		if (fd < 0)
+			continue;
+		if (pthread_create(&conn, &detached, srv_connection, (void *)(long)fd) != 0)
+			close(fd);
+	}
+
+	close(fdListen);
+	unlink(pszSocket);
+
+	pthread_mutex_lock(&srvLock);
+	srv_stop(0);
+	pthread_cond_broadcast(&srvBatch);
+	pthread_cond_broadcast(&srvQueued);
+	pthread_cond_broadcast(&srvDone);
+	pthread_mutex_unlock(&srvLock);
+
+	pthread_join(batcher, NULL);
+	for (t = 0; t < nSrvThreads; t++)
+		pthread_join(workers[t], NULL);
+	free(workers);
+	pthread_attr_destroy(&detached);
+
+	return 1;
+}
@@ -0,0 +1,33 @@
+#ifndef __HJM_TBB__
+#define __HJM_TBB__
+
+// TBB headers for HAVE_TBB builds (version=tbb and version=all), for both
+// classic TBB (task_scheduler_init, tbb::filter) and oneTBB 2021+
+// (global_control, tbb::filter_mode).
+
+#include "HJM_type.h"
+
+#ifdef HAVE_TBB
+
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_arena.h"
+#include "tbb/cache_aligned_allocator.h"
+
+#if __has_include("tbb/task_scheduler_init.h")
+#include "tbb/task_scheduler_init.h"
+#include "tbb/pipeline.h"
+#define HJM_TBB_INIT(n) tbb::task_scheduler_init __tbb_init(n)
+#define HJM_TBB_SERIAL tbb::filter::serial_in_order
+#define HJM_TBB_PARALLEL tbb::filter::parallel
+#else
+#include "tbb/global_control.h"
+#include "tbb/parallel_pipeline.h"
+#define HJM_TBB_INIT(n) tbb::global_control __tbb_init(tbb::global_control::max_allowed_parallelism, n)
+#define HJM_TBB_SERIAL tbb::filter_mode::serial_in_order
+#define HJM_TBB_PARALLEL tbb::filter_mode::parallel
+#endif
+
+#endif // HAVE_TBB
+
+#endif //__HJM_TBB__
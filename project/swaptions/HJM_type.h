@@ -6,8 +6,15 @@
 #error BASELINE and ENABLE_SSE4 are mutually exclusive
 #endif
 
+// version=tbb links the TBB engine and pipeline into libhjm as well
+#if defined(TBB_VERSION) && !defined(HAVE_TBB)
+#define HAVE_TBB
+#endif
+
 #define FTYPE double
+#ifndef BLOCK_SIZE
 #define BLOCK_SIZE 16 // Blocking to allow better caching
+#endif
 
 #define RANDSEEDVAL 100
 #define DEFAULT_NUM_TRIALS  102400
@@ -28,6 +35,49 @@ typedef struct
   FTYPE *pdYield;
   FTYPE **ppdFactors;
 } parm;
+
+// Worker pinning policies (-affinity)
+#define AFFINITY_NONE    0
+#define AFFINITY_COMPACT 1  // fill the cores of one NUMA node before the next
+#define AFFINITY_SCATTER 2  // spread consecutive workers over the NUMA nodes
+
+// One bump-and-reval scenario, applied on top of a swaption's own curve and vols
+typedef struct
+{
+  char szName[32];
+  int iBucket;        // pdYield bucket to shift, -1 shifts the whole curve
+  FTYPE dShift;       // yield shift (absolute, 1bp = 0.0001)
+  FTYPE dVolScale;    // multiplier on all factor volatilities (1.0 = unchanged)
+} scen;
+
+// Neumaier-compensated sum, see HJM_accum.h; the value is dSum + dComp
+typedef struct
+{
+  FTYPE dSum;
+  FTYPE dComp;
+} ksum;
+
+// Pricing order of one swaption (-jobs, HJM_schedule.cpp); times are from
+// the start of pricing
+typedef struct
+{
+  int iPriority;      // higher runs first
+  long lDeadlineUs;   // to be priced by, 0 for none
+  long lReleaseUs;    // not started before
+} swaption_job;
+
+// Progress of one swaption, as saved by -ckpt and restored by -resume.
+// The pricing worker publishes it after every block; uSeq is odd while an
+// update is in flight so the checkpoint writer can take a consistent copy.
+typedef struct
+{
+  unsigned uSeq;
+  int iDone;          // all lTrials simulated, sums are final
+  long lTrialsDone;   // trials accumulated so far (a multiple of BLOCK_SIZE)
+  long lRndSeed;      // RanUnif seed for the next block
+  ksum sum;           // sum of discounted payoffs
+  ksum sumSquare;     // sum of squared discounted payoffs
+} swaption_state;
  
 
 
@@ -1,76 +1,170 @@
+// Inverse cumulative normal, selected at build time with -DICDF_ALG=n
+// (0 Moro, 1 Acklam, 2 AS241; see icdf.h). Both the central and the tail
+// branch are evaluated and the result is picked with a ternary, so the
+// work-items of a wavefront never diverge.
+#ifndef ICDF_ALG
+#define ICDF_ALG 0
+#endif
+
+#if ICDF_ALG == 1
+// Acklam (2003)
+FTYPE icdf(FTYPE u)
+{
+	FTYPE q = u - 0.5;
+	FTYPE r = q * q;
+	FTYPE zc = (((((-3.969683028665376e+01*r + 2.209460984245205e+02)*r - 2.759285104469687e+02)*r
+				+ 1.383577518672690e+02)*r - 3.066479806614716e+01)*r + 2.506628277459239e+00) * q /
+		(((((-5.447609879822406e+01*r + 1.615858368580409e+02)*r - 1.556989798598866e+02)*r
+				+ 6.680131188771972e+01)*r - 1.328068155288572e+01)*r + 1.0);
+	FTYPE p = q > 0.0 ? 1.0 - u : u;
+	FTYPE z = sqrt(-2.0 * log(p));
+	z = (((((-7.784894002430293e-03*z - 3.223964580411365e-01)*z - 2.400758277161838e+00)*z
+				- 2.549732539343734e+00)*z + 4.374664141464968e+00)*z + 2.938163982698783e+00) /
+		((((7.784695709041462e-03*z + 3.224671290700398e-01)*z + 2.445134137142996e+00)*z
+				+ 3.754408661907416e+00)*z + 1.0);
+	z = q > 0.0 ? -z : z;
+	return (u >= 0.02425 && u <= 1.0 - 0.02425) ? zc : z;
+}
+#elif ICDF_ALG == 2
+// Wichura (1988), AS241 PPND16
+FTYPE icdf(FTYPE u)
+{
+	FTYPE q = u - 0.5;
+	FTYPE r = 0.180625 - q * q;
+	FTYPE zc = q * (((((((2.5090809287301226727e+3*r + 3.3430575583588128105e+4)*r
+				+ 6.7265770927008700853e+4)*r + 4.5921953931549871457e+4)*r
+				+ 1.3731693765509461125e+4)*r + 1.9715909503065514427e+3)*r
+				+ 1.3314166789178437745e+2)*r + 3.3871328727963666080e0) /
+		(((((((5.2264952788528545610e+3*r + 2.8729085735721942674e+4)*r
+				+ 3.9307895800092710610e+4)*r + 2.1213794301586595867e+4)*r
+				+ 5.3941960214247511077e+3)*r + 6.8718700749205790830e+2)*r
+				+ 4.2313330701600911252e+1)*r + 1.0);
+	FTYPE p = q > 0.0 ? 1.0 - u : u;
+	FTYPE s = sqrt(-log(p));
+	FTYPE s1 = s - 1.6;
+	FTYPE zm = (((((((7.74545014278341407640e-4*s1 + 2.27238449892691845833e-2)*s1
+				+ 2.41780725177450611770e-1)*s1 + 1.27045825245236838258e0)*s1
+				+ 3.64784832476320460504e0)*s1 + 5.76949722146069140550e0)*s1
+				+ 4.63033784615654529590e0)*s1 + 1.42343711074968357734e0) /
+		(((((((1.05075007164441684324e-9*s1 + 5.47593808499534494600e-4)*s1
+				+ 1.51986665636164571966e-2)*s1 + 1.48103976427480074590e-1)*s1
+				+ 6.89767334985100004550e-1)*s1 + 1.67638483018380384940e0)*s1
+				+ 2.05319162663775882187e0)*s1 + 1.0);
+	FTYPE s2 = s - 5.0;
+	FTYPE zf = (((((((2.01033439929228813265e-7*s2 + 2.71155556874348757815e-5)*s2
+				+ 1.24266094738807843860e-3)*s2 + 2.65321895265761230930e-2)*s2
+				+ 2.96560571828504891230e-1)*s2 + 1.78482653991729133580e0)*s2
+				+ 5.46378491116411436990e0)*s2 + 6.65790464350110377720e0) /
+		(((((((2.04426310338993978564e-15*s2 + 1.42151175831644588870e-7)*s2
+				+ 1.84631831751005468180e-5)*s2 + 7.86869131145613259100e-4)*s2
+				+ 1.48753612908506148525e-2)*s2 + 1.36929880922735805310e-1)*s2
+				+ 5.99832206555887937690e-1)*s2 + 1.0);
+	FTYPE z = s <= 5.0 ? zm : zf;
+	z = q < 0.0 ? -z : z;
+	return (q <= 0.425 && q >= -0.425) ? zc : z;
+}
+#else
+// Moro (1995), as CumNormalInv()
+FTYPE icdf(FTYPE u)
+{
+	FTYPE x = u - 0.5;
+	FTYPE r = x * x;
+	FTYPE zc = x * (((-25.44106049637 * r + 41.39119773534) * r - 18.61500062529) * r + 2.50662823884) /
+		((((3.13082909833 * r - 21.06224101826) * r + 23.08336743743) * r - 8.47351093090) * r + 1.0);
+	FTYPE t = x > 0.0 ? 1.0 - u : u;
+	t = log(-log(t));
+	t = 0.3374754822726147 + t * (0.9761690190917186 + t *
+		(0.1607979714918209 + t * (0.0276438810333863 + t *
+		(0.0038405729373609 + t * (0.0003951896511919 + t *
+		(0.0000321767881768 + t * (0.0000002888167364 + t * 0.0000003960315187)))))));
+	t = x < 0.0 ? -t : t;
+	return fabs(x) < 0.42 ? zc : t;
+}
+#endif
+
+// Uniform generator, selected at build time with -DRNG_ALG=n (0 Park-Miller
+// on lRndSeed + i, 1 Philox4x32-10; see rng.h). Both give every path the
+// draws rng_uniform() makes for it in stream 0 (rng_stream), whatever the
+// OpenCL block size: the shocks are shared by all swaptions here, where the
+// CPU versions give Philox a stream per swaption. RNG_BLOCK is the CPU
+// BLOCK_SIZE, which fixes Philox's keys.
+#ifndef RNG_ALG
+#define RNG_ALG 0
+#endif
+#ifndef RNG_BLOCK
+#define RNG_BLOCK 16
+#endif
+
+#if RNG_ALG == 1
+uint4 philox4x32(uint4 c, uint k0, uint k1)
+{
+	for (int r = 0; r < 10; r++) {
+		uint hi0 = mul_hi(0xD2511F53U, c.x), lo0 = 0xD2511F53U * c.x;
+		uint hi1 = mul_hi(0xCD9E8D57U, c.z), lo1 = 0xCD9E8D57U * c.z;
+		c = (uint4)(hi1 ^ c.y ^ k0, lo1, hi0 ^ c.w ^ k1, lo0);
+		k0 += 0x9E3779B9U;
+		k1 += 0xBB67AE85U;
+	}
+	return c;
+}
+#endif
+
 __kernel void swaption_RanGen(
 		int globalWorkSize,
 		int dev_i,
 		long lRndSeed,
 		__global FTYPE *pdZ,
 		__global unsigned int *ran_wi_sti,
-		__global unsigned int *ran_wi_edi)
+		__global unsigned int *ran_wi_edi,
+		long lZBase,		// index of pdZ[0] among the shocks of the run
+		int iN,
+		int iFactors)
 {
 	const int global_id = get_global_id(0);
 
-	FTYPE a[4] = {
-		2.50662823884,
-		-18.61500062529,
-		41.39119773534,
-		-25.44106049637
-	};
-
-	FTYPE b[4] = {
-		-8.47351093090,
-		23.08336743743,
-		-21.06224101826,
-		3.13082909833
-	};
-
-	FTYPE c[9] = {
-		0.3374754822726147,
-		0.9761690190917186,
-		0.1607979714918209,
-		0.0276438810333863,
-		0.0038405729373609,
-		0.0003951896511919,
-		0.0000321767881768,
-		0.0000002888167364,
-		0.0000003960315187
-	};
-
 	unsigned int i;
+	long n;
 	long s = lRndSeed;
+	FTYPE u;
+#if RNG_ALG == 1
+	uint4 w;
+	uint x;
+	long lPath, lKey;
+	int j, l, p;
+#else
 	long ix, k1;
-	FTYPE x, r, u;
+#endif
 	
 	// Get start & end indices of pdZ
 	unsigned int stIndex = ran_wi_sti[globalWorkSize * dev_i + global_id];
 	unsigned int edIndex = ran_wi_edi[globalWorkSize * dev_i + global_id];
 
 	for (i = stIndex; i <= edIndex; i++) {
+		n = lZBase + i;
 
+#if RNG_ALG == 1
+		// shock n is (path, row j, factor l); as rng_uniform, the key is the
+		// seed the path's block starts from and the counter (p/4, l, 0, 0)
+		// for draw p = (j-1)*RNG_BLOCK + b of the factor's row
+		l = n % iFactors;
+		j = (n / iFactors) % (iN-1) + 1;
+		lPath = n / ((long)iFactors * (iN-1));
+		lKey = s + lPath / RNG_BLOCK * RNG_BLOCK * (iN-1) * iFactors;
+		p = (j-1) * RNG_BLOCK + (int)(lPath % RNG_BLOCK);
+		w = philox4x32((uint4)((uint)(p >> 2), (uint)l, 0, 0), (uint)lKey, (uint)((ulong)lKey >> 32));
+		x = (p & 3) == 0 ? w.x : (p & 3) == 1 ? w.y : (p & 3) == 2 ? w.z : w.w;
+		u = ((FTYPE)x + 0.5) * (1.0 / 4294967296.0);
+#else
 		// RanUnif
-		ix = s + (long)i;
+		ix = s + n;
 		ix *= 1513517L;
 		ix %= 2147483647L;
 		k1 = ix/127773L;
 		ix = 16807L*( ix - k1*127773L ) - k1 * 2836L;
 		if (ix < 0) ix = ix + 2147483647L;
 		u = (ix * 4.656612875e-10);
+#endif
 
-		// CumNormalInv
-		x = u - 0.5;
-		if (fabs(x) < 0.42) {
-			r = x * x;
-			r = x * (((a[3] * r + a[2]) * r + a[1]) * r + a[0]) /
-				((((b[3] * r + b[2]) * r + b[1]) * r + b[0]) * r + 1.0);
-		}
-		else {
-			r = u;
-			if (x > 0.0) r = 1.0 - u;
-			r = log(-log(r));
-			r = c[0] + r * (c[1] + r *
-				(c[2] + r * (c[3] + r *
-				(c[4] + r * (c[5] + r * (c[6] + r * (c[7] + r * c[8])))))));
-			if (x < 0.0) r = -r;
-		}
-
-		pdZ[i] = r;
+		pdZ[i] = icdf(u);
 	}
 }
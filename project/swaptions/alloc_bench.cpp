@@ -0,0 +1,146 @@
+//alloc_bench.cpp
+//TLB behaviour of the nr_routines allocation backend (nr_alloc) for each page
+//kind: small pages, transparent huge pages and hugetlb pages.
+//
+//Allocates a buffer the size of a large pdZ, touches it, then walks it in a
+//random cyclic order of cache lines, one line per page visited, so that
+//nearly every access needs a new translation. Reports ns per access, dTLB
+//load misses per access (perf_event; "n/a" if the counter is not available,
+//see /proc/sys/kernel/perf_event_paranoid) and how much of the buffer the
+//kernel actually backed with huge pages (AnonHugePages/Private_Hugetlb in
+///proc/self/smaps_rollup).
+//
+//  ./alloc_bench [-m MB] [-n accesses]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "nr_routines.h"
+
+#define PAGE 4096
+#define LINE 64
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int tlb_open()
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// kB of huge pages (transparent and hugetlb) mapped by this process
+static long huge_kb()
+{
+	FILE *fp = fopen("/proc/self/smaps_rollup", "r");
+	char szLine[256];
+	long lKb, lTotal = 0;
+
+	if (!fp)
+		return -1;
+	while (fgets(szLine, sizeof(szLine), fp))
+		if (sscanf(szLine, "AnonHugePages: %ld", &lKb) == 1 || sscanf(szLine, "Private_Hugetlb: %ld", &lKb) == 1)
+			lTotal += lKb;
+	fclose(fp);
+	return lTotal;
+}
+
+int main(int argc, char *argv[])
+{
+	long lMb = 1024, lAccesses = 1L << 24;
+	long nPages, i, j, k, lMiss;
+	long long llCount;
+	double t0, dt;
+	int p, fd;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-m") && i+1 < argc) lMb = atol(argv[++i]);
+		else if (!strcmp(argv[i], "-n") && i+1 < argc) lAccesses = atol(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-m MB] [-n accesses]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (lMb < 4 || lAccesses < 1) {
+		fprintf(stderr, "Error: need -m >= 4 and -n >= 1\n");
+		return 1;
+	}
+	nPages = lMb * (1L << 20) / PAGE;
+
+	// a random cycle through the pages, at a random line of each
+	long *plOrder = (long *)malloc(sizeof(long) * nPages);
+	srand(1);
+	for (i = 0; i < nPages; i++)
+		plOrder[i] = i;
+	for (i = nPages-1; i > 0; i--) {
+		j = ((long)rand() * RAND_MAX + rand()) % (i+1);
+		k = plOrder[i]; plOrder[i] = plOrder[j]; plOrder[j] = k;
+	}
+
+	fd = tlb_open();
+	printf("buffer %ld MB, %ld accesses\n", lMb, lAccesses);
+	printf("%-8s %12s %16s %12s\n", "pages", "ns/access", "dTLB miss/access", "huge MB");
+	for (p = 0; p < NR_NPAGES; p++) {
+		size_t nBytes = (size_t)nPages * PAGE;
+		long lHuge0 = huge_kb();
+
+		nr_select_pages(p);
+		char *pBuf = (char *)nr_alloc(nBytes);
+		if (!pBuf) {
+			printf("%-8s cannot allocate\n", nr_pages_name[p]);
+			continue;
+		}
+		for (i = 0; i < nPages; i++) {
+			long lNext = plOrder[(i+1) % nPages];
+			*(long *)(pBuf + plOrder[i]*PAGE + (plOrder[i] % (PAGE/LINE))*LINE) =
+				lNext*PAGE + (lNext % (PAGE/LINE))*LINE;
+		}
+		long lHuge = huge_kb() - lHuge0;
+
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+		long lOfs = plOrder[0]*PAGE + (plOrder[0] % (PAGE/LINE))*LINE;
+		t0 = now();
+		for (i = 0; i < lAccesses; i++)
+			lOfs = *(volatile long *)(pBuf + lOfs);
+		dt = now() - t0;
+		lMiss = -1;
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(fd, &llCount, sizeof(llCount)) == sizeof(llCount))
+				lMiss = (long)llCount;
+		}
+
+		if (lMiss >= 0)
+			printf("%-8s %12.2f %16.3f %12.0f\n", nr_pages_name[p], dt / lAccesses * 1e9,
+					(double)lMiss / lAccesses, lHuge / 1024.0);
+		else
+			printf("%-8s %12.2f %16s %12.0f\n", nr_pages_name[p], dt / lAccesses * 1e9, "n/a", lHuge / 1024.0);
+		nr_free(pBuf, nBytes);
+	}
+	if (fd >= 0)
+		close(fd);
+	free(plOrder);
+	return 0;
+}
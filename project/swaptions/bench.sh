@@ -0,0 +1,44 @@
+#!/bin/bash
+# Builds one swaptions binary per (version, BLOCK_SIZE) and sweeps them with
+# swaptions_bench. Runs locally; no thorq needed.
+#
+#   VERSIONS="seq pthreads tbb cpu mpi" BLOCKSIZES="8 16 32" ./bench.sh -ns 16,128 -sm 10000 -nt 1,2,4 -o bench.json
+#
+# Any arguments are passed to swaptions_bench (e.g. -baseline old.json).
+# To check the prices of every build against the stored golden ones as well:
+#
+#   VERSIONS="seq pthreads tbb cpu" BLOCKSIZES="8 16 32" ./bench.sh -ns 4,16 -sm 100000 -nt 1,4 -golden golden.txt
+#
+# golden.txt was written with -ns 4,16 -sm 1000000 -write_golden from two -bin
+# entries of the serial build, one of them with "-rng philox" on its command.
+# mpi binaries are launched through "$MPIRUN" (default: mpirun -np 4).
+# PROF=1 (or PROF=perf) builds instrumented binaries so per-phase timings are reported.
+
+VERSIONS=${VERSIONS:-"seq pthreads"}
+BLOCKSIZES=${BLOCKSIZES:-"16"}
+MPIRUN=${MPIRUN:-"mpirun -np 4"}
+BINDIR=bench_bin
+
+mkdir -p $BINDIR
+BINS=()
+for v in $VERSIONS; do
+	for bs in $BLOCKSIZES; do
+		make clean > /dev/null
+		if ! make version=$v blocksize=$bs ${PROF:+prof=$PROF} > /dev/null 2>&1; then
+			echo "Skipping version=$v blocksize=$bs (build failed)" >&2
+			continue
+		fi
+		cp swaptions $BINDIR/swaptions_${v}_b${bs}
+		label=${v}_b${bs}
+		[ "$v" = "seq" ] && label=serial_b${bs}
+		if [ "$v" = "mpi" ]; then
+			BINS+=(-bin "$label=$MPIRUN ./$BINDIR/swaptions_${v}_b${bs}")
+		else
+			BINS+=(-bin "$label=./$BINDIR/swaptions_${v}_b${bs}")
+		fi
+	done
+done
+make clean > /dev/null
+
+make swaptions_bench > /dev/null 2>&1 || exit 1
+./swaptions_bench "${BINS[@]}" "$@"
@@ -68,3 +68,90 @@ void icdf_baseline(const int N, FTYPE *in, FTYPE *out){
   return;
 }
 
+
+/**********************************************************************/
+// Batched inverse normal (see icdf.h)
+
+#include "icdf_kernels.h"
+
+const char *icdf_alg_name[ICDF_NALGS] = { "moro", "acklam", "as241" };
+const char *icdf_isa_name[ICDF_NISAS] = { "scalar", "avx2", "avx512" };
+
+// set by icdf_avx2.cpp / icdf_avx512.cpp when built for that instruction set
+extern const int icdf_avx2_built;
+extern const int icdf_avx512_built;
+
+static int iIcdfAlg = ICDF_MORO;
+static int iIcdfIsa = ICDF_SCALAR;
+
+void icdf_scalar(int iAlg, const int N, const FTYPE *in, FTYPE *out)
+{
+  icdf_dispatch<FTYPE>(iAlg, N, in, out);
+}
+
+int icdf_isa_supported(int iIsa)
+{
+  switch (iIsa) {
+    case ICDF_SCALAR: return 1;
+#if defined(__x86_64__) || defined(__i386__)
+    case ICDF_AVX2:   return icdf_avx2_built && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case ICDF_AVX512: return icdf_avx512_built && __builtin_cpu_supports("avx512f");
+#endif
+  }
+  return 0;
+}
+
+int icdf_select(int iAlg, int iIsa)
+{
+  iIcdfAlg = iAlg;
+  if (iIsa == ICDF_AUTO) {
+    for (iIsa = ICDF_NISAS-1; iIsa > ICDF_SCALAR; iIsa--)
+      if (icdf_isa_supported(iIsa))
+        break;
+  } else if (!icdf_isa_supported(iIsa)) {
+    iIsa = ICDF_SCALAR;
+  }
+  iIcdfIsa = iIsa;
+  return iIsa;
+}
+
+int icdf_selected_isa()
+{
+  return iIcdfIsa;
+}
+
+int icdf_parse_alg(const char *szAlg)
+{
+  for (int a = 0; a < ICDF_NALGS; a++)
+    if (!strcmp(szAlg, icdf_alg_name[a]))
+      return a;
+  return -1;
+}
+
+int icdf_parse_isa(const char *szIsa)
+{
+  if (!strcmp(szIsa, "auto"))
+    return ICDF_AUTO;
+  for (int i = 0; i < ICDF_NISAS; i++)
+    if (!strcmp(szIsa, icdf_isa_name[i]))
+      return i;
+  return -2;
+}
+
+void icdf(const int N, const FTYPE *in, FTYPE *out)
+{
+  switch (iIcdfIsa) {
+    case ICDF_AVX2:   icdf_avx2(iIcdfAlg, N, in, out); break;
+    case ICDF_AVX512: icdf_avx512(iIcdfAlg, N, in, out); break;
+    default:          icdf_scalar(iIcdfAlg, N, in, out); break;
+  }
+}
+
+FTYPE icdf_one(FTYPE u)
+{
+  switch (iIcdfAlg) {
+    case ICDF_ACKLAM: return icdf_acklam(u);
+    case ICDF_AS241:  return icdf_as241(u);
+    default:          return icdf_moro(u);
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef __ICDF__
+#define __ICDF__
+
+#include "HJM_type.h"
+
+// Inverse cumulative normal, batched.
+//
+// Three approximations share one branch-free formulation: every lane
+// evaluates the central and the tail rational functions and the result is
+// picked with a masked blend, so the same kernel runs on scalar, AVX2,
+// AVX-512 and OpenCL (RanGen.cl) lanes without divergence.
+//
+//   ICDF_MORO    Moro (1995), the swaptions default; the scalar kernel is
+//                bit-identical to CumNormalInv()
+//   ICDF_ACKLAM  Acklam (2003), as in icdf_baseline()
+//   ICDF_AS241   Wichura (1988) PPND16, accurate to double precision
+//
+// The vector kernels use their own log() and may fuse multiply-adds, so they
+// can differ from the scalar kernel in the last bits (see icdf_bench).
+
+enum { ICDF_MORO, ICDF_ACKLAM, ICDF_AS241, ICDF_NALGS };
+enum { ICDF_SCALAR, ICDF_AVX2, ICDF_AVX512, ICDF_NISAS, ICDF_AUTO = -1 };
+
+extern const char *icdf_alg_name[ICDF_NALGS];
+extern const char *icdf_isa_name[ICDF_NISAS];
+
+// Selects the algorithm and instruction set used by icdf()/icdf_one().
+// ICDF_AUTO picks the widest instruction set this CPU supports. Returns the
+// instruction set actually selected.
+int icdf_select(int iAlg, int iIsa);
+int icdf_selected_isa();	// also picks the HJM path evolution kernel
+int icdf_parse_alg(const char *szAlg);	// -1 if unknown
+int icdf_parse_isa(const char *szIsa);	// -2 if unknown, ICDF_AUTO for "auto"
+int icdf_isa_supported(int iIsa);
+
+// out[i] = Phi^-1(in[i]) for 0 < in[i] < 1; in and out may alias
+void icdf(const int N, const FTYPE *in, FTYPE *out);
+FTYPE icdf_one(FTYPE u);
+
+// Individual kernels (icdf.cpp, icdf_avx2.cpp, icdf_avx512.cpp)
+void icdf_scalar(int iAlg, const int N, const FTYPE *in, FTYPE *out);
+void icdf_avx2(int iAlg, const int N, const FTYPE *in, FTYPE *out);
+void icdf_avx512(int iAlg, const int N, const FTYPE *in, FTYPE *out);
+
+#endif //__ICDF__
@@ -0,0 +1,28 @@
+//icdf_avx2.cpp
+//AVX2 build of the inverse-normal kernels in icdf_kernels.h. The Makefile
+//compiles this file with the AVX2 flags; icdf() only calls it when the CPU
+//supports them.
+
+#include "icdf.h"
+
+#ifdef __AVX2__
+
+#include "icdf_kernels.h"
+
+extern const int icdf_avx2_built = 1;
+
+void icdf_avx2(int iAlg, const int N, const FTYPE *in, FTYPE *out)
+{
+	icdf_dispatch<v4df>(iAlg, N, in, out);
+}
+
+#else
+
+extern const int icdf_avx2_built = 0;
+
+void icdf_avx2(int iAlg, const int N, const FTYPE *in, FTYPE *out)
+{
+	icdf_scalar(iAlg, N, in, out);
+}
+
+#endif
@@ -0,0 +1,28 @@
+//icdf_avx512.cpp
+//AVX512 build of the inverse-normal kernels in icdf_kernels.h. The Makefile
+//compiles this file with the AVX512 flags; icdf() only calls it when the CPU
+//supports them.
+
+#include "icdf.h"
+
+#ifdef __AVX512F__
+
+#include "icdf_kernels.h"
+
+extern const int icdf_avx512_built = 1;
+
+void icdf_avx512(int iAlg, const int N, const FTYPE *in, FTYPE *out)
+{
+	icdf_dispatch<v8df>(iAlg, N, in, out);
+}
+
+#else
+
+extern const int icdf_avx512_built = 0;
+
+void icdf_avx512(int iAlg, const int N, const FTYPE *in, FTYPE *out)
+{
+	icdf_scalar(iAlg, N, in, out);
+}
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef __ICDF_KERNELS__
+#define __ICDF_KERNELS__
+
+// Branch-free inverse-normal kernels, written once for any lane type V:
+// FTYPE for the scalar kernels and GCC vector types (v4df, v8df) for the
+// SIMD ones. Comparisons yield lane masks and "mask ? a : b" is a blend.
+// Included by icdf.cpp, icdf_avx2.cpp and icdf_avx512.cpp, each compiled
+// for its own instruction set.
+
+#include <string.h>
+#include <math.h>
+#include "icdf.h"
+
+static inline FTYPE icdf_log(FTYPE x) { return log(x); }
+static inline FTYPE icdf_sqrt(FTYPE x) { return sqrt(x); }
+
+// log() for positive, normal lanes (fdlibm's algorithm, < 1 ulp)
+template <class V, class I>
+static inline V icdf_vlog(V x)
+{
+	const FTYPE ln2_hi = 6.93147180369123816490e-01, ln2_lo = 1.90821492927058770002e-10;
+	const FTYPE Lg1 = 6.666666666666735130e-01, Lg2 = 3.999999999940941908e-01,
+		Lg3 = 2.857142874366239149e-01, Lg4 = 2.222219843214978396e-01,
+		Lg5 = 1.818357216161805012e-01, Lg6 = 1.531383769920937332e-01,
+		Lg7 = 1.479819860511658591e-01;
+
+	// x = 2^k * m with m in [sqrt(2)/2, sqrt(2))
+	I hx = (I)x + ((long long)(0x3ff00000 - 0x3fe6a09e) << 32);
+	I k = hx >> 52;
+	V m = (V)((hx & 0x000fffffffffffffLL) + (0x3fe6a09eLL << 32));
+	V dk = (V)(k | 0x4330000000000000LL) - (4503599627370496.0 + 1023.0);
+
+	V f = m - 1.0;
+	V hfsq = 0.5*f*f;
+	V s = f/(2.0 + f);
+	V z = s*s;
+	V w = z*z;
+	V R = z*(Lg1 + w*(Lg3 + w*(Lg5 + w*Lg7))) + w*(Lg2 + w*(Lg4 + w*Lg6));
+	return s*(hfsq + R) + dk*ln2_lo - hfsq + f + dk*ln2_hi;
+}
+
+#ifdef __AVX2__
+#include <immintrin.h>
+typedef double v4df __attribute__((vector_size(32)));
+typedef long long v4di __attribute__((vector_size(32)));
+static inline v4df icdf_log(v4df x) { return icdf_vlog<v4df, v4di>(x); }
+static inline v4df icdf_sqrt(v4df x) { return _mm256_sqrt_pd(x); }
+#endif
+
+#ifdef __AVX512F__
+typedef double v8df __attribute__((vector_size(64)));
+typedef long long v8di __attribute__((vector_size(64)));
+static inline v8df icdf_log(v8df x) { return icdf_vlog<v8df, v8di>(x); }
+// the maskz form: GCC 12 flags the merge source of _mm512_sqrt_pd as uninitialized
+static inline v8df icdf_sqrt(v8df x) { return _mm512_maskz_sqrt_pd((__mmask8)-1, x); }
+#endif
+
+/**********************************************************************/
+// Moro, B., 1995, "The Full Monte," RISK (February), 57-58.
+// Same coefficients and evaluation order as CumNormalInv().
+template <class V>
+static inline V icdf_moro_central(V x)
+{
+	const FTYPE a0 = 2.50662823884, a1 = -18.61500062529, a2 = 41.39119773534, a3 = -25.44106049637;
+	const FTYPE b0 = -8.47351093090, b1 = 23.08336743743, b2 = -21.06224101826, b3 = 3.13082909833;
+
+	V r = x * x;
+	return x * (((a3*r + a2) * r + a1) * r + a0)/
+		((((b3 * r+ b2) * r + b1) * r + b0) * r + 1.0);
+}
+
+template <class V>
+static inline V icdf_moro_tail(V u, V x)
+{
+	const FTYPE c0 = 0.3374754822726147, c1 = 0.9761690190917186, c2 = 0.1607979714918209,
+		c3 = 0.0276438810333863, c4 = 0.0038405729373609, c5 = 0.0003951896511919,
+		c6 = 0.0000321767881768, c7 = 0.0000002888167364, c8 = 0.0000003960315187;
+
+	V t = x > 0.0 ? 1.0 - u : u;
+	t = icdf_log(-icdf_log(t));
+	t = c0 + t * (c1 + t *
+			(c2 + t * (c3 + t *
+			(c4 + t * (c5 + t * (c6 + t * (c7 + t*c8)))))));
+	return x < 0.0 ? -t : t;
+}
+
+template <class V>
+static inline V icdf_moro(V u)
+{
+	V x = u - 0.5;
+	return ((x < 0.42) & (x > -0.42)) ? icdf_moro_central(x) : icdf_moro_tail(u, x);
+}
+
+// Acklam, P. J., 2003, "An algorithm for computing the inverse normal
+// cumulative distribution function". Same coefficients as icdf_baseline().
+template <class V>
+static inline V icdf_acklam_central(V q)
+{
+	const FTYPE a1 = -3.969683028665376e+01, a2 = 2.209460984245205e+02, a3 = -2.759285104469687e+02,
+		a4 = 1.383577518672690e+02, a5 = -3.066479806614716e+01, a6 = 2.506628277459239e+00;
+	const FTYPE b1 = -5.447609879822406e+01, b2 = 1.615858368580409e+02, b3 = -1.556989798598866e+02,
+		b4 = 6.680131188771972e+01, b5 = -1.328068155288572e+01;
+
+	V r = q*q;
+	return (((((a1*r+a2)*r+a3)*r+a4)*r+a5)*r+a6)*q / (((((b1*r+b2)*r+b3)*r+b4)*r+b5)*r+1.0);
+}
+
+template <class V>
+static inline V icdf_acklam_tail(V u, V q)
+{
+	const FTYPE c1 = -7.784894002430293e-03, c2 = -3.223964580411365e-01, c3 = -2.400758277161838e+00,
+		c4 = -2.549732539343734e+00, c5 = 4.374664141464968e+00, c6 = 2.938163982698783e+00;
+	const FTYPE d1 = 7.784695709041462e-03, d2 = 3.224671290700398e-01, d3 = 2.445134137142996e+00,
+		d4 = 3.754408661907416e+00;
+
+	V p = q > 0.0 ? 1.0 - u : u;
+	V z = icdf_sqrt(-2.0*icdf_log(p));
+	z = (((((c1*z+c2)*z+c3)*z+c4)*z+c5)*z+c6) / ((((d1*z+d2)*z+d3)*z+d4)*z+1.0);
+	return q > 0.0 ? -z : z;
+}
+
+template <class V>
+static inline V icdf_acklam(V u)
+{
+	const FTYPE u_low = 0.02425, u_high = 1.0 - 0.02425;
+	V q = u - 0.5;
+	return ((u >= u_low) & (u <= u_high)) ? icdf_acklam_central(q) : icdf_acklam_tail(u, q);
+}
+
+// Wichura, M. J., 1988, "Algorithm AS 241: The percentage points of the
+// normal distribution," Applied Statistics 37, 477-484 (PPND16).
+template <class V>
+static inline V icdf_as241_central(V q)
+{
+	const FTYPE a0 = 3.3871328727963666080e0, a1 = 1.3314166789178437745e+2,
+		a2 = 1.9715909503065514427e+3, a3 = 1.3731693765509461125e+4,
+		a4 = 4.5921953931549871457e+4, a5 = 6.7265770927008700853e+4,
+		a6 = 3.3430575583588128105e+4, a7 = 2.5090809287301226727e+3;
+	const FTYPE b1 = 4.2313330701600911252e+1, b2 = 6.8718700749205790830e+2,
+		b3 = 5.3941960214247511077e+3, b4 = 2.1213794301586595867e+4,
+		b5 = 3.9307895800092710610e+4, b6 = 2.8729085735721942674e+4,
+		b7 = 5.2264952788528545610e+3;
+
+	V r = 0.180625 - q*q;
+	return q * (((((((a7*r+a6)*r+a5)*r+a4)*r+a3)*r+a2)*r+a1)*r+a0) /
+		(((((((b7*r+b6)*r+b5)*r+b4)*r+b3)*r+b2)*r+b1)*r+1.0);
+}
+
+template <class V>
+static inline V icdf_as241_tail(V u, V q)
+{
+	const FTYPE c0 = 1.42343711074968357734e0, c1 = 4.63033784615654529590e0,
+		c2 = 5.76949722146069140550e0, c3 = 3.64784832476320460504e0,
+		c4 = 1.27045825245236838258e0, c5 = 2.41780725177450611770e-1,
+		c6 = 2.27238449892691845833e-2, c7 = 7.74545014278341407640e-4;
+	const FTYPE d1 = 2.05319162663775882187e0, d2 = 1.67638483018380384940e0,
+		d3 = 6.89767334985100004550e-1, d4 = 1.48103976427480074590e-1,
+		d5 = 1.51986665636164571966e-2, d6 = 5.47593808499534494600e-4,
+		d7 = 1.05075007164441684324e-9;
+	const FTYPE e0 = 6.65790464350110377720e0, e1 = 5.46378491116411436990e0,
+		e2 = 1.78482653991729133580e0, e3 = 2.96560571828504891230e-1,
+		e4 = 2.65321895265761230930e-2, e5 = 1.24266094738807843860e-3,
+		e6 = 2.71155556874348757815e-5, e7 = 2.01033439929228813265e-7;
+	const FTYPE f1 = 5.99832206555887937690e-1, f2 = 1.36929880922735805310e-1,
+		f3 = 1.48753612908506148525e-2, f4 = 7.86869131145613259100e-4,
+		f5 = 1.84631831751005468180e-5, f6 = 1.42151175831644588870e-7,
+		f7 = 2.04426310338993978564e-15;
+
+	V p = q > 0.0 ? 1.0 - u : u;
+	V s = icdf_sqrt(-icdf_log(p));
+	V s1 = s - 1.6;
+	V zm = (((((((c7*s1+c6)*s1+c5)*s1+c4)*s1+c3)*s1+c2)*s1+c1)*s1+c0) /
+		(((((((d7*s1+d6)*s1+d5)*s1+d4)*s1+d3)*s1+d2)*s1+d1)*s1+1.0);
+	V s2 = s - 5.0;
+	V zf = (((((((e7*s2+e6)*s2+e5)*s2+e4)*s2+e3)*s2+e2)*s2+e1)*s2+e0) /
+		(((((((f7*s2+f6)*s2+f5)*s2+f4)*s2+f3)*s2+f2)*s2+f1)*s2+1.0);
+	V zt = s <= 5.0 ? zm : zf;
+	return q < 0.0 ? -zt : zt;
+}
+
+template <class V>
+static inline V icdf_as241(V u)
+{
+	V q = u - 0.5;
+	return ((q <= 0.425) & (q >= -0.425)) ? icdf_as241_central(q) : icdf_as241_tail(u, q);
+}
+
+// Scalar lanes branch instead: the arithmetic (and so the result) is the
+// same, but only one side is evaluated
+template <>
+inline FTYPE icdf_moro<FTYPE>(FTYPE u)
+{
+	FTYPE x = u - 0.5;
+	if (x < 0.42 && x > -0.42)
+		return icdf_moro_central(x);
+	return icdf_moro_tail(u, x);
+}
+
+template <>
+inline FTYPE icdf_acklam<FTYPE>(FTYPE u)
+{
+	FTYPE q = u - 0.5;
+	if (u >= 0.02425 && u <= 1.0 - 0.02425)
+		return icdf_acklam_central(q);
+	return icdf_acklam_tail(u, q);
+}
+
+template <>
+inline FTYPE icdf_as241<FTYPE>(FTYPE u)
+{
+	FTYPE q = u - 0.5;
+	if (q <= 0.425 && q >= -0.425)
+		return icdf_as241_central(q);
+	return icdf_as241_tail(u, q);
+}
+
+/**********************************************************************/
+// Applies kernel K to in[0..N-1], W = lanes per V; the last partial vector
+// is padded with 0.5
+template <class V, V (*K)(V)>
+static inline void icdf_loop(const int N, const FTYPE *in, FTYPE *out)
+{
+	const int W = sizeof(V)/sizeof(FTYPE);
+	FTYPE buf[W];
+	V u;
+	int i, k;
+
+	for (i = 0; i + W <= N; i += W) {
+		memcpy(&u, in + i, sizeof(V));
+		u = K(u);
+		memcpy(out + i, &u, sizeof(V));
+	}
+	if (i < N) {
+		for (k = 0; k < W; k++)
+			buf[k] = i + k < N ? in[i + k] : 0.5;
+		memcpy(&u, buf, sizeof(V));
+		u = K(u);
+		memcpy(buf, &u, sizeof(V));
+		for (k = 0; i + k < N; k++)
+			out[i + k] = buf[k];
+	}
+}
+
+template <class V>
+static inline void icdf_dispatch(int iAlg, const int N, const FTYPE *in, FTYPE *out)
+{
+	switch (iAlg) {
+		case ICDF_ACKLAM: icdf_loop<V, icdf_acklam<V> >(N, in, out); break;
+		case ICDF_AS241:  icdf_loop<V, icdf_as241<V> >(N, in, out); break;
+		default:          icdf_loop<V, icdf_moro<V> >(N, in, out); break;
+	}
+}
+
+#endif //__ICDF_KERNELS__
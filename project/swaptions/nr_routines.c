@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 
 #include "nr_routines.h"
 #include "HJM_type.h"
@@ -94,6 +96,162 @@ void gaussj(FTYPE **a, int n, FTYPE **b, int m)
 #undef SWAP
 #undef NRANSI
 
+void tred2(FTYPE **a, int n, FTYPE d[], FTYPE e[])
+{
+	// modifications:  float -> FTYPE
+	// Householder reduction of the symmetric a[1..n][1..n] to tridiagonal
+	// form: diagonal in d, off-diagonal in e[2..n]; a is replaced by the
+	// orthogonal transformation, as tqli expects it
+
+	int l,k,j,i;
+	FTYPE scale,hh,h,g,f;
+
+	for (i=n;i>=2;i--) {
+		l=i-1;
+		h=scale=0.0;
+		if (l > 1) {
+			for (k=1;k<=l;k++)
+				scale += fabs(a[i][k]);
+			if (scale == 0.0)
+				e[i]=a[i][l];
+			else {
+				for (k=1;k<=l;k++) {
+					a[i][k] /= scale;
+					h += a[i][k]*a[i][k];
+				}
+				f=a[i][l];
+				g=(f >= 0.0 ? -sqrt(h) : sqrt(h));
+				e[i]=scale*g;
+				h -= f*g;
+				a[i][l]=f-g;
+				f=0.0;
+				for (j=1;j<=l;j++) {
+					a[j][i]=a[i][j]/h;
+					g=0.0;
+					for (k=1;k<=j;k++)
+						g += a[j][k]*a[i][k];
+					for (k=j+1;k<=l;k++)
+						g += a[k][j]*a[i][k];
+					e[j]=g/h;
+					f += e[j]*a[i][j];
+				}
+				hh=f/(h+h);
+				for (j=1;j<=l;j++) {
+					f=a[i][j];
+					e[j]=g=e[j]-hh*f;
+					for (k=1;k<=j;k++)
+						a[j][k] -= (f*e[k]+g*a[i][k]);
+				}
+			}
+		} else
+			e[i]=a[i][l];
+		d[i]=h;
+	}
+	d[1]=0.0;
+	e[1]=0.0;
+	for (i=1;i<=n;i++) {
+		l=i-1;
+		if (d[i]) {
+			for (j=1;j<=l;j++) {
+				g=0.0;
+				for (k=1;k<=l;k++)
+					g += a[i][k]*a[k][j];
+				for (k=1;k<=l;k++)
+					a[k][j] -= g*a[k][i];
+			}
+		}
+		d[i]=a[i][i];
+		a[i][i]=1.0;
+		for (j=1;j<=l;j++) a[j][i]=a[i][j]=0.0;
+	}
+}
+
+#define SIGN(a,b) ((b) >= 0.0 ? fabs(a) : -fabs(a))
+
+int tqli(FTYPE d[], FTYPE e[], int n, FTYPE **z)
+{
+	// modifications:  float -> FTYPE
+	// nrerror removed, pythag replaced by hypot
+	// routine returns int instead of void, where
+	//    1 means success, and 0 failure (more than 30 iterations)
+	// eigenvalues of the tridiagonal d, e (from tred2) in d[1..n],
+	// eigenvectors in the columns of z, which holds the tred2 output on entry
+
+	int m,l,iter,i,k;
+	FTYPE s,r,p,g,f,dd,c,b;
+
+	for (i=2;i<=n;i++) e[i-1]=e[i];
+	e[n]=0.0;
+	for (l=1;l<=n;l++) {
+		iter=0;
+		do {
+			for (m=l;m<=n-1;m++) {
+				dd=fabs(d[m])+fabs(d[m+1]);
+				if ((FTYPE)(fabs(e[m])+dd) == dd) break;
+			}
+			if (m != l) {
+				if (iter++ == 30) return(0);
+				g=(d[l+1]-d[l])/(2.0*e[l]);
+				r=hypot(g,1.0);
+				g=d[m]-d[l]+e[l]/(g+SIGN(r,g));
+				s=c=1.0;
+				p=0.0;
+				for (i=m-1;i>=l;i--) {
+					f=s*e[i];
+					b=c*e[i];
+					e[i+1]=(r=hypot(f,g));
+					if (r == 0.0) {
+						d[i+1] -= p;
+						e[m]=0.0;
+						break;
+					}
+					s=f/r;
+					c=g/r;
+					g=d[i+1]-p;
+					r=(d[i]-g)*s+2.0*c*b;
+					d[i+1]=g+(p=s*r);
+					g=c*r-b;
+					for (k=1;k<=n;k++) {
+						f=z[k][i+1];
+						z[k][i+1]=s*z[k][i]+c*f;
+						z[k][i]=c*z[k][i]-s*f;
+					}
+				}
+				if (r == 0.0 && i >= l) continue;
+				d[l] -= p;
+				e[l]=g;
+				e[m]=0.0;
+			}
+		} while (m != l);
+	}
+	return(1);
+}
+#undef SIGN
+
+void eigsrt(FTYPE d[], FTYPE **v, int n)
+{
+	// sorts the eigenvalues of tqli into descending order, and the
+	// eigenvector columns of v with them
+
+	int k,j,i;
+	FTYPE p;
+
+	for (i=1;i<n;i++) {
+		p=d[k=i];
+		for (j=i+1;j<=n;j++)
+			if (d[j] >= p) p=d[k=j];
+		if (k != i) {
+			d[k]=d[i];
+			d[i]=p;
+			for (j=1;j<=n;j++) {
+				p=v[j][i];
+				v[j][i]=v[j][k];
+				v[j][k]=p;
+			}
+		}
+	}
+}
+
 
 /**********************************************************************/
 void nrerror( char error_text[] )
@@ -106,34 +264,113 @@ void nrerror( char error_text[] )
 
 } // end of nrerror
 
+/**********************************************************************/
+// Allocation backend: blocks start on a cache line, and blocks of at least a
+// huge page are mapped on their own, rounded up to whole huge pages, so that
+// they can be backed by huge pages (nr_select_pages)
+
+const char *nr_pages_name[NR_NPAGES] = { "small", "thp", "hugetlb" };
+
+static int iNrPages = NR_PAGES_SMALL;
+
+void nr_select_pages(int iPages)
+{
+	iNrPages = iPages;
+}
+
+int nr_parse_pages(const char *szPages)
+{
+	for (int p = 0; p < NR_NPAGES; p++)
+		if (!strcmp(szPages, nr_pages_name[p]))
+			return p;
+	return -1;
+}
+
+static size_t nr_mapped_size(size_t nBytes)
+{
+	return (nBytes + NR_HUGE_PAGE - 1) / NR_HUGE_PAGE * NR_HUGE_PAGE;
+}
+
+void *nr_alloc(size_t nBytes)
+{
+	void *p = NULL;
+
+	if (nBytes < NR_HUGE_PAGE) {
+		if (posix_memalign(&p, NR_ALIGN, nBytes ? nBytes : NR_ALIGN) != 0)
+			return NULL;
+		return p;
+	}
+
+	nBytes = nr_mapped_size(nBytes);
+#ifdef MAP_HUGETLB
+	if (iNrPages == NR_PAGES_HUGETLB) {
+		p = mmap(NULL, nBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED)
+			return p;
+		// no huge pages reserved (vm.nr_hugepages): transparent ones instead
+		static int bWarned = 0;
+		if (!__atomic_exchange_n(&bWarned, 1, __ATOMIC_RELAXED))
+			fprintf(stderr, "Warning: no hugetlb pages for %zu bytes, using transparent huge pages\n", nBytes);
+	}
+#endif
+	p = mmap(NULL, nBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+#ifdef MADV_HUGEPAGE
+	if (iNrPages != NR_PAGES_SMALL)
+		madvise(p, nBytes, MADV_HUGEPAGE);
+#endif
+	return p;
+}
+
+void nr_free(void *p, size_t nBytes)
+{
+	if (!p)
+		return;
+	if (nBytes < NR_HUGE_PAGE)
+		free(p);
+	else
+		munmap(p, nr_mapped_size(nBytes));
+}
+
+// Elements per row of a dmatrix with ncol columns: rows are padded to whole
+// cache lines so that each one starts on a line
+static long nr_row_stride(long ncol)
+{
+	const long nLine = NR_ALIGN / sizeof(FTYPE);
+
+	return (ncol + nLine - 1) / nLine * nLine;
+}
+
 /**********************************************************************/
 int *ivector(long nl, long nh)
-/* allocate an int vector with subscript range v[nl..nh] */
+/* allocate an int vector with subscript range v[nl..nh], v[nl] on a cache line */
 {
 	int *v;
 
-	v=(int *)malloc((size_t) ((nh-nl+2)*sizeof(int)));
+	v=(int *)nr_alloc((size_t) ((nh-nl+1)*sizeof(int)));
 	if (!v) nrerror("allocation failure in ivector()");
-	return v-nl+1;
+	return v-nl;
 }
 
 /**********************************************************************/
 void free_ivector(int *v, long nl, long nh)
 /* free an int vector allocated with ivector() */
 {
-	free((char *) (v+nl-1));
+	nr_free(v+nl, (size_t) ((nh-nl+1)*sizeof(int)));
 }
 
 /**********************************************************************/
 FTYPE *dvector( long nl, long nh )
 {
-  // allocate a FTYPE vector with subscript range v[nl..nh]
+  // allocate a FTYPE vector with subscript range v[nl..nh], v[nl] on a
+  // cache line
 
 	FTYPE *v;
 
-	v=(FTYPE *)malloc((size_t) ((nh-nl+2)*sizeof(FTYPE)));
+	v=(FTYPE *)nr_alloc((size_t) ((nh-nl+1)*sizeof(FTYPE)));
 	if (!v) nrerror("allocation failure in dvector()");
-	return v-nl+1;
+	return v-nl;
 
 } // end of dvector
 
@@ -142,31 +379,30 @@ void free_dvector( FTYPE *v, long nl, long nh )
 {
   // free a FTYPE vector allocated with dvector()
 
-	free((char*) (v+nl-1));
+	nr_free(v+nl, (size_t) ((nh-nl+1)*sizeof(FTYPE)));
 
 } // end of free_dvector
 
 /**********************************************************************/
 FTYPE **dmatrix( long nrl, long nrh, long ncl, long nch )
 {
-  // allocate a FTYPE matrix with subscript range m[nrl..nrh][ncl..nch]
+  // allocate a FTYPE matrix with subscript range m[nrl..nrh][ncl..nch];
+  // every m[i][ncl] is on a cache line, the rows are not contiguous
 
-	long i, nrow=nrh-nrl+1,ncol=nch-ncl+1;
+	long i, nrow=nrh-nrl+1,ncol=nch-ncl+1,nstride=nr_row_stride(ncol);
 	FTYPE **m;
 
   // allocate pointers to rows
-	m=(FTYPE **) malloc((size_t)((nrow+1)*sizeof(FTYPE*)));
+	m=(FTYPE **) malloc((size_t)(nrow*sizeof(FTYPE*)));
 	if (!m) nrerror("allocation failure 1 in dmatrix()");
-	m += 1;
 	m -= nrl;
 
   // allocate rows and set pointers to them
-	m[nrl]=(FTYPE *) malloc((size_t)((nrow*ncol+1)*sizeof(FTYPE)));
+	m[nrl]=(FTYPE *) nr_alloc((size_t)(nrow*nstride*sizeof(FTYPE)));
 	if (!m[nrl]) nrerror("allocation failure 2 in dmatrix()");
-	m[nrl] += 1;
 	m[nrl] -= ncl;
 
-	for(i=nrl+1;i<=nrh;i++) m[i]=m[i-1]+ncol;
+	for(i=nrl+1;i<=nrh;i++) m[i]=m[i-1]+nstride;
 
   // return pointer to array of pointers to rows
 	return m;
@@ -178,8 +414,8 @@ void free_dmatrix( FTYPE **m, long nrl, long nrh, long ncl, long nch )
 {
   // free a FTYPE matrix allocated by dmatrix()
 
-	free((char*) (m[nrl]+ncl-1));
-	free((char*) (m+nrl-1));
+	nr_free(m[nrl]+ncl, (size_t)((nrh-nrl+1)*nr_row_stride(nch-ncl+1)*sizeof(FTYPE)));
+	free((char*) (m+nrl));
 
 } // end of free_dmatrix
 
@@ -1,8 +1,27 @@
+#include <stddef.h>
 #include "HJM_type.h"
 
 int      choldc(FTYPE **a, int n);
 void     gaussj(FTYPE **a, int n, FTYPE **b, int m);
+void     tred2(FTYPE **a, int n, FTYPE d[], FTYPE e[]);
+int      tqli(FTYPE d[], FTYPE e[], int n, FTYPE **z);
+void     eigsrt(FTYPE d[], FTYPE **v, int n);
 void     nrerror( char error_text[] );
+
+// Allocation backend of the vectors and matrices below: NR_ALIGN-aligned
+// blocks, and blocks of NR_HUGE_PAGE or more mapped on their own and backed
+// by small pages, transparent huge pages (madvise) or hugetlb pages (falling
+// back to transparent ones if none are reserved). The page kind is process
+// wide (nr_select_pages).
+#define NR_ALIGN 64
+#define NR_HUGE_PAGE (2UL << 20)
+enum { NR_PAGES_SMALL, NR_PAGES_THP, NR_PAGES_HUGETLB, NR_NPAGES };
+extern const char *nr_pages_name[NR_NPAGES];
+void     nr_select_pages(int iPages);
+int      nr_parse_pages(const char *szPages);	// -1 if unknown
+void    *nr_alloc(size_t nBytes);		// NULL on failure
+void     nr_free(void *p, size_t nBytes);	// nBytes as allocated
+
 int      *ivector(long nl, long nh);
 void     free_ivector(int *v, long nl, long nh);
 FTYPE   *dvector( long nl, long nh );
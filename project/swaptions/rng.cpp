@@ -0,0 +1,137 @@
+//rng.cpp
+//Uniform generators behind rng_uniform() (see rng.h).
+
+#include <string.h>
+
+#include "HJM.h"
+#include "rng.h"
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+#define PHILOX_LANES 8		// counters evaluated side by side in philox_fill
+
+const char *rng_name[RNG_NGENS] = { "parkmiller", "philox" };
+
+static int iRng = RNG_PARKMILLER;
+
+void rng_select(int iNewRng)
+{
+	iRng = iNewRng;
+}
+
+int rng_selected()
+{
+	return iRng;
+}
+
+int rng_parse(const char *szRng)
+{
+	for (int r = 0; r < RNG_NGENS; r++)
+		if (!strcmp(szRng, rng_name[r]))
+			return r;
+	return -1;
+}
+
+long rng_stream(long lSeed, int iStream)
+{
+	if (iRng == RNG_PHILOX)
+		return lSeed + ((long)iStream << 40);
+	return lSeed;
+}
+
+long rng_skip(long lSeed, long nBlocks, int iN, int iFactors, int BLOCKSIZE)
+{
+	return lSeed + nBlocks*BLOCKSIZE*(iN-1)*iFactors;
+}
+
+static inline void philox_round(unsigned &c0, unsigned &c1, unsigned &c2, unsigned &c3, unsigned k0, unsigned k1)
+{
+	unsigned long long p0 = (unsigned long long)PHILOX_M0 * c0;
+	unsigned long long p1 = (unsigned long long)PHILOX_M1 * c2;
+	unsigned n0 = (unsigned)(p1 >> 32) ^ c1 ^ k0;
+	unsigned n2 = (unsigned)(p0 >> 32) ^ c3 ^ k1;
+
+	c1 = (unsigned)p1;
+	c3 = (unsigned)p0;
+	c0 = n0;
+	c2 = n2;
+}
+
+void philox4x32(const unsigned ctr[4], const unsigned key[2], unsigned out[4])
+{
+	unsigned c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+	unsigned k0 = key[0], k1 = key[1];
+
+	for (int r = 0; r < 10; r++) {
+		philox_round(c0, c1, c2, c3, k0, k1);
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+// 32 random bits to (0,1), never 0 or 1 so the inverse normal stays finite
+static inline FTYPE philox_unif(unsigned x)
+{
+	return ((FTYPE)x + 0.5) * (1.0 / 4294967296.0);
+}
+
+// out[0..N-1] from counters (q, ctr1, 0, 0), q = 0, 1, ..., four draws each.
+// The lanes are independent so the compiler can keep PHILOX_LANES counters
+// in SIMD registers.
+static void philox_fill(const unsigned key[2], unsigned ctr1, int N, FTYPE *out)
+{
+	unsigned c0[PHILOX_LANES], c1[PHILOX_LANES], c2[PHILOX_LANES], c3[PHILOX_LANES];
+	unsigned o[4];
+	int q, k, r, nQuads = N / 4;
+
+	for (q = 0; q + PHILOX_LANES <= nQuads; q += PHILOX_LANES) {
+		unsigned k0 = key[0], k1 = key[1];
+		for (k = 0; k < PHILOX_LANES; k++) {
+			c0[k] = q + k; c1[k] = ctr1; c2[k] = 0; c3[k] = 0;
+		}
+		for (r = 0; r < 10; r++) {
+			for (k = 0; k < PHILOX_LANES; k++)
+				philox_round(c0[k], c1[k], c2[k], c3[k], k0, k1);
+			k0 += PHILOX_W0;
+			k1 += PHILOX_W1;
+		}
+		for (k = 0; k < PHILOX_LANES; k++) {
+			out[4*(q+k)]   = philox_unif(c0[k]);
+			out[4*(q+k)+1] = philox_unif(c1[k]);
+			out[4*(q+k)+2] = philox_unif(c2[k]);
+			out[4*(q+k)+3] = philox_unif(c3[k]);
+		}
+	}
+	for (; 4*q < N; q++) {
+		unsigned ctr[4] = { (unsigned)q, ctr1, 0, 0 };
+		philox4x32(ctr, key, o);
+		for (k = 0; k < 4 && 4*q + k < N; k++)
+			out[4*q + k] = philox_unif(o[k]);
+	}
+}
+
+void rng_uniform(FTYPE **randZ, int iN, int iFactors, long *lRndSeed, int BLOCKSIZE)
+{
+	int b, j, l;
+
+	if (iRng == RNG_PHILOX) {
+		// the block's seed is its key; rows 1..iN-1 of a factor are contiguous
+		unsigned key[2] = { (unsigned)*lRndSeed, (unsigned)((unsigned long)*lRndSeed >> 32) };
+		for (l = 0; l <= iFactors-1; ++l)
+			philox_fill(key, l, BLOCKSIZE*(iN-1), randZ[l] + BLOCKSIZE);
+		*lRndSeed += (long)BLOCKSIZE*(iN-1)*iFactors;
+		return;
+	}
+
+	for(b=0; b<BLOCKSIZE; b++){
+		for (j=1;j<=iN-1;++j){
+			for (l=0;l<=iFactors-1;++l){
+				//compute random number in exact same sequence
+				randZ[l][BLOCKSIZE*j + b] = RanUnif(lRndSeed);  /* 10% of the total executition time */
+			}
+		}
+	}
+}
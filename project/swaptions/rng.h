@@ -0,0 +1,45 @@
+#ifndef __RNG__
+#define __RNG__
+
+#include "HJM_type.h"
+
+// Uniform random numbers for the simulation, one block of shocks at a time.
+//
+//   RNG_PARKMILLER  RanUnif() on seed, seed+1, ...: the PARSEC default. Draws
+//                   for adjacent seeds are correlated and the period is 2^31.
+//   RNG_PHILOX      Philox4x32-10 (Salmon et al., SC'11), counter based: the
+//                   block seed is the key and (draw, factor) the counter, so
+//                   every draw is a pure function of its position and any
+//                   parallel decomposition gives the same numbers.
+//
+// Both generators advance the seed by the number of draws in a block, so the
+// seed published in swaption_state (checkpoints) means the same for both.
+//
+// The OpenCL versions (RanGen.cl) draw the same numbers path by path, but
+// share one set of shocks between all swaptions: every swaption gets stream
+// 0, so with Philox only swaption 0 matches the CPU versions.
+
+enum { RNG_PARKMILLER, RNG_PHILOX, RNG_NGENS };
+
+extern const char *rng_name[RNG_NGENS];
+
+void rng_select(int iRng);
+int rng_selected();
+int rng_parse(const char *szRng);	// -1 if unknown
+
+// Seed of stream iStream (e.g. the swaption index). Park-Miller keeps the
+// single PARSEC seed for every stream; Philox puts the stream in the upper
+// key bits, leaving 2^40 draws per stream.
+long rng_stream(long lSeed, int iStream);
+
+// Seed nBlocks blocks after lSeed: both generators advance the seed by the
+// draws of a block, so a worker can start anywhere in a stream
+long rng_skip(long lSeed, long nBlocks, int iN, int iFactors, int BLOCKSIZE);
+
+// randZ[l][BLOCKSIZE*j + b] for j = 1..iN-1, b = 0..BLOCKSIZE-1, l = 0..iFactors-1
+void rng_uniform(FTYPE **randZ, int iN, int iFactors, long *lRndSeed, int BLOCKSIZE);
+
+// One Philox4x32-10 call: 4 independent 32-bit outputs per (counter, key)
+void philox4x32(const unsigned ctr[4], const unsigned key[2], unsigned out[4]);
+
+#endif //__RNG__
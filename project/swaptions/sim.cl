@@ -1,5 +1,16 @@
+// One work-item prices the blocks iter_wi_sti..iter_wi_edi of a swaption,
+// path by path, with the two-row window of HJM_Swaption_Payoffs_Rolling.
+//
+// The scratch rows are interleaved by work-item, element e of row r of this
+// work-item at g_pdRows[(r*iN + e)*get_global_size(0) + global_id], so the
+// work-items of a wavefront read and write consecutive addresses. The curve,
+// the drifts, the factor loadings and the swap payments are the same for
+// every work-item and live in constant memory. Discount factors are running
+// products in registers.
+#define ROW(r, e) g_pdRows[((r) * iN + (e)) * nItems + global_id]
+
 __kernel void swaption_sim(
-		__global FTYPE *g_ppdHJMPath,
+		__global FTYPE *g_pdRows,
 		int iN,
 		int iFactors,
 		FTYPE dYears,
@@ -9,38 +20,26 @@ __kernel void swaption_sim(
 		int iSwapVectorLength,
 		int iSwapStartTimeIndex,
 		FTYPE dSwapVectorYears,
-		__global FTYPE *pdForward,
-		__global FTYPE *pdTotalDrift,
-		__global FTYPE *ppdFactors,
+		__constant FTYPE *pdForward,
+		__constant FTYPE *pdTotalDrift,
+		__constant FTYPE *ppdFactors,
 		__global FTYPE *g_pdZ,
-		__global FTYPE *g_pdDiscountingRatePath,
-		__global FTYPE *g_pdPayoffDiscountFactors,
-		__global FTYPE *g_pdexpRes,
-		__global FTYPE *g_pdSwapRatePath,
-		__global FTYPE *g_pdSwapDiscountFactors,
-		__global FTYPE *pdSwapPayoffs,
+		__constant FTYPE *pdSwapPayoffs,
 		__global FTYPE *g_dSumSimSwaptionPrice,
 		__global FTYPE *g_dSumSquareSimSwaptionPrice,
 		__global unsigned int *iter_wi_sti,
 		__global unsigned int *iter_wi_edi)
 {
 	const int global_id = get_global_id(0);
+	const int nItems = get_global_size(0);
 
-	// Calculate device global memory address allocated to this work item
-	__global FTYPE *ppdHJMPath = g_ppdHJMPath + iN * iN * BLOCKSIZE * global_id;
 	__global FTYPE *pdZ;
-	__global FTYPE *pdDiscountingRatePath = g_pdDiscountingRatePath + iN * BLOCKSIZE * global_id;
-	__global FTYPE *pdPayoffDiscountFactors = g_pdPayoffDiscountFactors + iN * BLOCKSIZE * global_id;
-	__global FTYPE *pdexpRes = g_pdexpRes + (iN-1) * BLOCKSIZE * global_id;
-	__global FTYPE *pdSwapRatePath = g_pdSwapRatePath + iSwapVectorLength * BLOCKSIZE * global_id;
-	__global FTYPE *pdSwapDiscountFactors = g_pdSwapDiscountFactors + iSwapVectorLength * BLOCKSIZE * global_id;
-	
+
 	// Simulation loops
-	int my_iter_index = 0;
-	int i, j, k, l, ii;
+	int i, j, l, ii;
+	int b, r, p;
 
 	FTYPE dTotalShock;
-	int b;
 
 	int n_iN = iSwapVectorLength;
 	FTYPE n_ddelt = (FTYPE) ((FTYPE)dSwapVectorYears / n_iN);
@@ -48,27 +47,27 @@ __kernel void swaption_sim(
 	FTYPE dSwaptionPayoff;
 	FTYPE dDiscSwaptionPayoff;
 	FTYPE dFixedLegValue;
+	FTYPE dPayoffDiscountFactor;
+	FTYPE dSwapDiscountFactor;
 
 	FTYPE dSumSimSwaptionPrice = 0.0;
 	FTYPE dSumSquareSimSwaptionPrice = 0.0;
 
 	for (ii = iter_wi_sti[global_id]; ii <= iter_wi_edi[global_id]; ii++) {
-		
-		// Rest of HJM_SimPath_Forward_Blocking
-		for (b = 0; b < BLOCKSIZE; b++) {
-			for (j = 0; j <= iN-1; j++) {
-				ppdHJMPath[BLOCKSIZE * j + b] = pdForward[j];
-
-				for (i = 1; i <= iN-1; i++) {
-					ppdHJMPath[iN * BLOCKSIZE * i + BLOCKSIZE * j + b] = 0;
-				}
-			}
-		}
-		
 		pdZ = g_pdZ + iFactors * (iN-1) * BLOCKSIZE * ii;
 
 		for (b = 0; b < BLOCKSIZE; b++) {
-			for (j = 1; j <= iN-1; j++) {
+			// Rest of HJM_SimPath_Forward_Blocking, up to swaption maturity;
+			// the payoff discount factor takes the short rate of each row
+			for (j = 0; j <= iN-1; j++)
+				ROW(0, j) = pdForward[j];
+			dPayoffDiscountFactor = 1.0;
+
+			for (j = 1; j <= iSwapStartTimeIndex; j++) {
+				p = (j-1) & 1;
+				r = j & 1;
+				dPayoffDiscountFactor *= exp(-ROW(p, 0)*ddelt);
+
 				for (l = 0; l <= iN-(j+1); l++) {
 					dTotalShock = 0;
 
@@ -76,63 +75,21 @@ __kernel void swaption_sim(
 						dTotalShock += ppdFactors[(iN-1) * i + l] * pdZ[(iN-1)*iFactors*b + iFactors*(j-1) + i];
 					}
 
-					ppdHJMPath[iN * BLOCKSIZE * j + BLOCKSIZE * l + b] = ppdHJMPath[iN * BLOCKSIZE * (j-1) + BLOCKSIZE * (l+1) + b] + pdTotalDrift[l] * ddelt + sqrt_ddelt * dTotalShock;
+					ROW(r, l) = ROW(p, l+1) + pdTotalDrift[l] * ddelt + sqrt_ddelt * dTotalShock;
 				}
 			}
-		}
-
-		// Compute discount factor vector
-		for (i = 0; i <= iN-1; i++) {
-			for (b = 0; b <= BLOCKSIZE-1; b++) {
-				pdDiscountingRatePath[BLOCKSIZE*i + b] = ppdHJMPath[iN * BLOCKSIZE * i + b];
-			}
-		}
-
-		// Discount_Factors_Blocking
-		for (j = 0; j <= (iN-1)*BLOCKSIZE-1; j++) pdexpRes[j] = -pdDiscountingRatePath[j]*ddelt;
-		for (j = 0; j <= (iN-1)*BLOCKSIZE-1; j++) pdexpRes[j] = exp(pdexpRes[j]);
-
-		for (i = 0; i < iN*BLOCKSIZE; i++)
-			pdPayoffDiscountFactors[i] = 1.0;
 
-		for (i = 1; i <= iN-1; i++) {
-			for (b = 0; b < BLOCKSIZE; b++) {
-				for (j = 0; j <= i-1; j++) {
-					pdPayoffDiscountFactors[i*BLOCKSIZE + b] *= pdexpRes[j*BLOCKSIZE + b];
-				}
-			}
-		}
-
-		// Compute discount factors along the swap path
-		for (i = 0; i <= iSwapVectorLength-1; i++) {
-			for (b = 0; b < BLOCKSIZE; b++) {
-				pdSwapRatePath[i * BLOCKSIZE + b] = ppdHJMPath[iN * BLOCKSIZE * iSwapStartTimeIndex + i * BLOCKSIZE + b];
-			}
-		}
-
-		// Discount_Factors_Blocking
-		for (j = 0; j <= (n_iN-1)*BLOCKSIZE-1; j++) pdexpRes[j] = -pdSwapRatePath[j]*n_ddelt;
-		for (j = 0; j <= (n_iN-1)*BLOCKSIZE-1; j++) pdexpRes[j] = exp(pdexpRes[j]);
-
-		for (i = 0; i < n_iN*BLOCKSIZE; i++)
-			pdSwapDiscountFactors[i] = 1.0;
-
-		for (i = 1; i <= n_iN-1; i++) {
-			for (b = 0; b < BLOCKSIZE; b++) {
-				for (j = 0; j <= i-1; j++) {
-					pdSwapDiscountFactors[i*BLOCKSIZE + b] *= pdexpRes[j*BLOCKSIZE + b];
-				}
-			}
-		}
-
-		// Simulation
-		for (b = 0; b < BLOCKSIZE; b++) {
+			// Swap discount factors along the forward curve at maturity
+			r = iSwapStartTimeIndex & 1;
+			dSwapDiscountFactor = 1.0;
 			dFixedLegValue = 0.0;
 			for (i = 0; i <= iSwapVectorLength-1; i++) {
-				dFixedLegValue += pdSwapPayoffs[i]*pdSwapDiscountFactors[i*BLOCKSIZE + b];
+				if (i > 0)
+					dSwapDiscountFactor *= exp(-ROW(r, i-1)*n_ddelt);
+				dFixedLegValue += pdSwapPayoffs[i]*dSwapDiscountFactor;
 			}
 			dSwaptionPayoff = ((dFixedLegValue - 1.0) > 0) ? (dFixedLegValue - 1.0) : 0;
-			dDiscSwaptionPayoff = dSwaptionPayoff*pdPayoffDiscountFactors[iSwapStartTimeIndex*BLOCKSIZE + b];
+			dDiscSwaptionPayoff = dSwaptionPayoff*dPayoffDiscountFactor;
 
 			// Accumulate
 			dSumSimSwaptionPrice += dDiscSwaptionPayoff;
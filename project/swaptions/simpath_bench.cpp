@@ -0,0 +1,118 @@
+//simpath_bench.cpp
+//Throughput of the HJM path evolution (HJM_SimPath_Forward_Blocking_Z) for
+//the scalar loop and the lane-parallel AVX2/AVX-512 kernels.
+//
+//Reports paths/s for one block of BLOCKSIZE paths evolved repeatedly from
+//fixed shocks, and the largest difference from the scalar loop (the SIMD
+//kernels fuse multiply-adds, so they may differ in the last bits).
+//
+//  ./simpath_bench [-n steps] [-f factors] [-b blocksize] [-t seconds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "HJM.h"
+#include "nr_routines.h"
+#include "icdf.h"
+#include "rng.h"
+
+static int iN = 11;
+static int iFactors = 3;
+static int nBlock = BLOCK_SIZE;
+static double dMinTime = 0.2;
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+	FTYPE dYears = 5.5;
+	FTYPE **ppdFactors, **pdZ, **randZ, **ppdPath, **ppdRef;
+	FTYPE *pdForward, *pdDrift;
+	FTYPE dDiff, dScalar = 0.0, dRate;
+	long lSeed = RANDSEEDVAL, lReps;
+	double t0, dt;
+	int i, j, s;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-n") && i+1 < argc) iN = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-f") && i+1 < argc) iFactors = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-b") && i+1 < argc) nBlock = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-t") && i+1 < argc) dMinTime = atof(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-n steps] [-f factors] [-b blocksize] [-t seconds]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (iN < 2 || iFactors < 1 || nBlock < 1) {
+		fprintf(stderr, "Error: need -n >= 2, -f >= 1 and -b >= 1\n");
+		return 1;
+	}
+
+	// flat 10% curve, decaying factor volatilities, small drifts
+	ppdFactors = dmatrix(0, iFactors-1, 0, iN-2);
+	for (i = 0; i < iFactors; i++)
+		for (j = 0; j <= iN-2; j++)
+			ppdFactors[i][j] = 0.01 * exp(-0.1 * (i + 1) * j) / (i + 1);
+	pdForward = dvector(0, iN-1);
+	pdDrift = dvector(0, iN-2);
+	for (j = 0; j < iN; j++)
+		pdForward[j] = 0.1;
+	for (j = 0; j <= iN-2; j++)
+		pdDrift[j] = 1e-5 * j;
+
+	pdZ = dmatrix(0, iFactors-1, 0, iN*nBlock-1);
+	randZ = dmatrix(0, iFactors-1, 0, iN*nBlock-1);
+	ppdPath = dmatrix(0, iN-1, 0, iN*nBlock-1);
+	ppdRef = dmatrix(0, iN-1, 0, iN*nBlock-1);
+	HJM_Z_Blocking(pdZ, randZ, iN, iFactors, &lSeed, nBlock);
+
+	printf("iN %d, factors %d, BLOCKSIZE %d\n", iN, iFactors, nBlock);
+	printf("%-7s %14s %10s %14s\n", "isa", "paths/s", "speedup", "max abs diff");
+	for (s = 0; s < ICDF_NISAS; s++) {
+		if (!icdf_isa_supported(s))
+			continue;
+		icdf_select(ICDF_MORO, s);
+
+		HJM_SimPath_Forward_Blocking_Z(ppdPath, iN, iFactors, dYears, pdForward, pdDrift, ppdFactors, pdZ, nBlock);
+		lReps = 0;
+		t0 = now();
+		do {
+			for (i = 0; i < 256; i++)
+				HJM_SimPath_Forward_Blocking_Z(ppdPath, iN, iFactors, dYears, pdForward, pdDrift, ppdFactors, pdZ, nBlock);
+			lReps += 256;
+			dt = now() - t0;
+		} while (dt < dMinTime);
+		dRate = lReps * nBlock / dt;
+
+		if (s == ICDF_SCALAR) {
+			dScalar = dRate;
+			for (i = 0; i < iN; i++)
+				memcpy(ppdRef[i], ppdPath[i], sizeof(FTYPE) * iN * nBlock);
+		}
+		dDiff = 0.0;
+		for (i = 0; i < iN; i++)
+			for (j = 0; j < iN * nBlock; j++)
+				if (fabs(ppdPath[i][j] - ppdRef[i][j]) > dDiff)
+					dDiff = fabs(ppdPath[i][j] - ppdRef[i][j]);
+
+		// a kernel that cannot take this BLOCKSIZE falls back to the next narrower one
+		printf("%-7s %14.0f %9.2fx %14.3e\n", icdf_isa_name[s], dRate, dRate / dScalar, dDiff);
+	}
+
+	free_dmatrix(ppdFactors, 0, iFactors-1, 0, iN-2);
+	free_dvector(pdForward, 0, iN-1);
+	free_dvector(pdDrift, 0, iN-2);
+	free_dmatrix(pdZ, 0, iFactors-1, 0, iN*nBlock-1);
+	free_dmatrix(randZ, 0, iFactors-1, 0, iN*nBlock-1);
+	free_dmatrix(ppdPath, 0, iN-1, 0, iN*nBlock-1);
+	free_dmatrix(ppdRef, 0, iN-1, 0, iN*nBlock-1);
+	return 0;
+}
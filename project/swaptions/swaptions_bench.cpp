@@ -0,0 +1,618 @@
+//swaptions_bench.cpp
+//Benchmark harness for the swaptions binaries. Runs locally (no thorq).
+//
+//Every binary given with -bin is run over the cross product of the -ns, -sm
+//and -nt lists, -reps times each, and the wall time of every run is measured.
+//The median/p95 wall time, paths/sec and per-phase timings are written as JSON,
+//one result object per line. Per-phase timings are collected from the
+//"Phase <name>: <seconds>" lines a binary prints (and from "Time spent:" of
+//DEBUG builds, reported as phase "roi").
+//
+//With -vs, every configuration is also run with the given extra arguments
+//(e.g. -vs "-affinity compact") and the speedup over the plain run is reported.
+//
+//With -baseline, results are compared against an earlier JSON file and any
+//configuration whose median got slower by more than -threshold is flagged;
+//the exit code is then 2 (1 if the baseline cannot be read).
+//
+//With -golden, the prices every binary prints are checked against golden
+//prices of the same book (-ns) and generator (-rng) from a file written
+//earlier with -write_golden. The backends draw different random numbers
+//(rng_stream per swaption in the CPU versions, one shared stream in the
+//OpenCL ones; -icdf and the paths of a run change them too), so a price is
+//checked statistically: it fails if it is more than -z combined standard
+//errors, sqrt(se^2 + se_golden^2), away from the golden price (a swaption
+//priced with no variance must match exactly, a NaN never does). The default
+//z = 5 leaves a false alarm probability of 6e-7 per price, about 1e-3 over a
+//suite of a thousand prices. Prices that agree to the printed digits are
+//counted as identical. Any mismatch makes the exit code 3.
+//
+//The generators are checked against golden prices of their own: Park-Miller
+//draws on consecutive seeds lie on a lattice, and its prices are off those of
+//Philox by many standard errors at 10^6 paths.
+//
+//Binaries for the different versions and BLOCK_SIZEs are built by bench.sh.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+
+#define MAX_BINS 64
+#define MAX_LIST 32
+#define MAX_REPS 1000
+#define MAX_PHASES 16
+#define MAX_RESULTS 4096
+#define MAX_PRICES 4096		// swaptions of a run checked against the golden prices
+
+typedef struct
+{
+	char szLabel[64];		// e.g. pthreads_b16
+	char szCmd[512];		// command line prefix, e.g. ./bench_bin/swaptions_pthreads_b16
+	int bThreads;			// does the binary accept -nt > 1 ? (probe_threads)
+} bench_bin;
+
+typedef struct
+{
+	char szLabel[64];
+	int ns, sm, nt;
+	int iReps;
+	int bOk;
+	double dMedian, dP95, dMin;
+	double dPathsPerSec;
+	double dVsMedian;			// median with the -vs arguments, 0 if not run
+	int nPhases;
+	char szPhase[MAX_PHASES][32];
+	double dPhase[MAX_PHASES];	// median per phase
+	int nPrices;				// prices of the first repetition, -golden/-write_golden
+	double *pdPrice;			// price, stderr pairs
+	int iRng;					// generator of the run, see rng.h
+	int iGolden;				// GOLDEN_*
+	double dMaxZ;
+	int nIdentical;
+} bench_result;
+
+enum { GOLDEN_NONE, GOLDEN_OK, GOLDEN_MISMATCH };
+static const char *szGoldenStatus[] = { "none", "ok", "mismatch" };
+
+// A golden price: swaption id of the book of ns swaptions, priced with iRng
+typedef struct
+{
+	int iRng, ns, id;
+	double dPrice, dStdErr;
+} golden_price;
+
+static const char *szRngName[] = { "parkmiller", "philox" };	// rng.h
+
+static bench_bin bins[MAX_BINS];
+static int nBins = 0;
+static bench_result results[MAX_RESULTS];
+static int nResults = 0;
+static golden_price *golden = NULL;
+static int nGolden = 0;
+static int bPrices = 0;			// collect the prices of the runs
+static double dMaxZ = 5.0;
+
+static void usage()
+{
+	fprintf(stderr," usage: swaptions_bench -bin label=command [-bin ...]\n"
+			"\t-ns [list of number of swaptions, e.g. 16,128]\n"
+			"\t-sm [list of number of simulations]\n"
+			"\t-nt [list of number of threads]\n"
+			"\t-reps [repetitions per configuration]\n"
+			"\t-args [extra arguments passed to every run]\n"
+			"\t-vs [arguments of a variant run to compare against, e.g. \"-affinity compact\"]\n"
+			"\t-o [JSON output file, default stdout]\n"
+			"\t-baseline [JSON file of an earlier run]\n"
+			"\t-threshold [allowed slowdown vs baseline, default 0.10]\n"
+			"\t-golden [golden price file to check every run against]\n"
+			"\t-z [allowed deviation from the golden prices in standard errors, default 5]\n"
+			"\t-write_golden [file for the prices of the runs with the largest -sm per -ns and -rng]\n");
+	exit(1);
+}
+
+static int parse_list(char *str, int *list)
+{
+	int n = 0;
+	char *tok = strtok(str, ",");
+	while (tok && n < MAX_LIST) {
+		list[n++] = atoi(tok);
+		tok = strtok(NULL, ",");
+	}
+	return n;
+}
+
+static double timespec_to_sec(struct timespec *t)
+{
+	return t->tv_sec + t->tv_nsec * 1e-9;
+}
+
+// nearest-rank percentile of a sorted array
+static double percentile(double *sorted, int n, double p)
+{
+	int k = (int)ceil(p * n) - 1;
+	if (k < 0) k = 0;
+	if (k > n-1) k = n-1;
+	return sorted[k];
+}
+
+// Runs one configuration once. Returns 1 on success and fills the wall time
+// and any phase timings the binary printed, and with pdPrice the price and
+// stderr of every swaption.
+static int run_once(const char *szCmd, double *pdWall,
+		int *pnPhases, char szPhase[][32], double *pdPhase, double *pdPrice = NULL, int *pnPrices = NULL)
+{
+	FILE *fp;
+	char szLine[512];
+	char szName[32];
+	double dSec, dPrice, dStdErr;
+	long lSec, lNsec;
+	int i, iStatus, id;
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	fp = popen(szCmd, "r");
+	if (!fp)
+		return 0;
+
+	*pnPhases = 0;
+	if (pnPrices)
+		*pnPrices = 0;
+	while (fgets(szLine, sizeof(szLine), fp)) {
+		if (pdPrice && sscanf(szLine, "Swaption%d: [SwaptionPrice: %lf StdError: %lf]", &id, &dPrice, &dStdErr) == 3) {
+			if (id >= 0 && id < MAX_PRICES) {
+				pdPrice[2*id] = dPrice;
+				pdPrice[2*id + 1] = dStdErr;
+				if (id >= *pnPrices)
+					*pnPrices = id + 1;
+			}
+			continue;
+		}
+		if (sscanf(szLine, "Phase %31[^:]: %lf", szName, &dSec) == 2) {
+		} else if (sscanf(szLine, "Time spent: %ld.%ld", &lSec, &lNsec) == 2) {
+			strcpy(szName, "roi");
+			dSec = lSec + lNsec * 1e-9;
+		} else {
+			continue;
+		}
+		for (i = 0; i < *pnPhases; i++)
+			if (!strcmp(szPhase[i], szName))
+				break;
+		if (i == *pnPhases) {
+			if (*pnPhases == MAX_PHASES)
+				continue;
+			strcpy(szPhase[i], szName);
+			pdPhase[i] = 0.0;
+			(*pnPhases)++;
+		}
+		pdPhase[i] += dSec;
+	}
+	iStatus = pclose(fp);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	*pdWall = timespec_to_sec(&end) - timespec_to_sec(&start);
+	return WIFEXITED(iStatus) && WEXITSTATUS(iStatus) == 0;
+}
+
+static double median_wall(const char *szCmd, int iReps)
+{
+	double pdWall[MAX_REPS];
+	int nPhases;
+	char szPhase[MAX_PHASES][32];
+	double pdPhase[MAX_PHASES];
+
+	for (int r = 0; r < iReps; r++)
+		if (!run_once(szCmd, &pdWall[r], &nPhases, szPhase, pdPhase)) {
+			fprintf(stderr, "Error: run failed: %s\n", szCmd);
+			return 0.0;
+		}
+	std::sort(pdWall, pdWall + iReps);
+	return percentile(pdWall, iReps, 0.5);
+}
+
+// The generator of a run from its command line
+static int run_rng(const char *szCmd)
+{
+	return strstr(szCmd, "-rng philox") ? 1 : 0;
+}
+
+// Golden price file: "rng ns id price stderr" per line, '#' comments
+static int read_golden(const char *szFile)
+{
+	FILE *fp = fopen(szFile, "r");
+	char szLine[256], szRng[32];
+	golden_price g;
+	int nAlloc = 0;
+
+	if (!fp) {
+		fprintf(stderr, "Error: cannot open golden prices %s\n", szFile);
+		return 0;
+	}
+	while (fgets(szLine, sizeof(szLine), fp)) {
+		if (szLine[0] == '#' || sscanf(szLine, "%31s %d %d %lf %lf", szRng, &g.ns, &g.id, &g.dPrice, &g.dStdErr) != 5)
+			continue;
+		for (g.iRng = 1; g.iRng >= 0 && strcmp(szRng, szRngName[g.iRng]); g.iRng--)
+			;
+		if (g.iRng < 0) {
+			fprintf(stderr, "Error: unknown generator %s in %s\n", szRng, szFile);
+			fclose(fp);
+			return 0;
+		}
+		if (nGolden == nAlloc) {
+			nAlloc = nAlloc ? 2*nAlloc : 256;
+			golden = (golden_price *)realloc(golden, sizeof(golden_price) * nAlloc);
+		}
+		golden[nGolden++] = g;
+	}
+	fclose(fp);
+	if (nGolden == 0) {
+		fprintf(stderr, "Error: no golden prices in %s\n", szFile);
+		return 0;
+	}
+	return 1;
+}
+
+static const golden_price *find_golden(int iRng, int ns, int id)
+{
+	for (int g = 0; g < nGolden; g++)
+		if (golden[g].iRng == iRng && golden[g].ns == ns && golden[g].id == id)
+			return &golden[g];
+	return NULL;
+}
+
+// Checks the prices of res against the golden ones of its book
+static void check_golden(bench_result *res)
+{
+	const golden_price *g;
+	int i, nChecked = 0;
+	double dZ, dSe;
+
+	res->iGolden = GOLDEN_OK;
+	res->dMaxZ = 0.0;
+	res->nIdentical = 0;
+	for (i = 0; i < res->ns; i++) {
+		g = find_golden(res->iRng, res->ns, i);
+		if (!g)
+			continue;
+		nChecked++;
+		double dPrice = res->pdPrice[2*i], dStdErr = res->pdPrice[2*i + 1];
+		if (i >= res->nPrices) {
+			fprintf(stderr, "MISMATCH %-20s ns=%-6d sm=%-9d nt=%-3d Swaption%d not printed\n",
+					res->szLabel, res->ns, res->sm, res->nt, i);
+			res->iGolden = GOLDEN_MISMATCH;
+			continue;
+		}
+		if (fabs(dPrice - g->dPrice) < 5e-11)
+			res->nIdentical++;
+		dSe = sqrt(dStdErr*dStdErr + g->dStdErr*g->dStdErr);
+		if (dSe > 0.0)
+			dZ = fabs(dPrice - g->dPrice) / dSe;
+		else
+			dZ = fabs(dPrice - g->dPrice) < 5e-11 ? 0.0 : HUGE_VAL;
+		if (dZ != dZ)
+			dZ = HUGE_VAL;
+		if (dZ > res->dMaxZ)
+			res->dMaxZ = dZ;
+		if (dZ > dMaxZ) {
+			fprintf(stderr, "MISMATCH %-20s ns=%-6d sm=%-9d nt=%-3d Swaption%d %.10f +- %.10f, golden %.10f +- %.10f (z %.1f)\n",
+					res->szLabel, res->ns, res->sm, res->nt, i, dPrice, dStdErr, g->dPrice, g->dStdErr, dZ);
+			res->iGolden = GOLDEN_MISMATCH;
+		}
+	}
+	if (nChecked == 0) {
+		res->iGolden = GOLDEN_NONE;
+		fprintf(stderr, "%-20s no golden prices for ns=%d -rng %s\n", "", res->ns, szRngName[res->iRng]);
+		return;
+	}
+	fprintf(stderr, "%-20s golden: %d prices %s, max |z| %.2f, %d identical\n", "", nChecked,
+			res->iGolden == GOLDEN_OK ? "ok" : "MISMATCH", res->dMaxZ, res->nIdentical);
+}
+
+// Per generator and ns the prices of the run with the most paths, the
+// earliest of equals
+static int write_golden(const char *szFile)
+{
+	FILE *fp = fopen(szFile, "w");
+	int i, j, k, nWritten = 0;
+
+	if (!fp) {
+		fprintf(stderr, "Error: cannot write %s\n", szFile);
+		return 0;
+	}
+	fprintf(fp, "# golden swaption prices, written by swaptions_bench -write_golden\n");
+	fprintf(fp, "# rng ns id price stderr\n");
+	for (i = 0; i < nResults; i++) {
+		bench_result *res = &results[i];
+		if (!res->bOk || res->nPrices != res->ns)
+			continue;
+		for (j = 0; j < nResults; j++)
+			if (j != i && results[j].bOk && results[j].iRng == res->iRng && results[j].ns == res->ns &&
+					results[j].nPrices == results[j].ns &&
+					(results[j].sm > res->sm || (results[j].sm == res->sm && j < i)))
+				break;
+		if (j < nResults)
+			continue;
+		fprintf(fp, "# %s -sm %d\n", res->szLabel, res->sm);
+		for (k = 0; k < res->ns; k++)
+			fprintf(fp, "%s %d %d %.10f %.10f\n", szRngName[res->iRng], res->ns, k, res->pdPrice[2*k], res->pdPrice[2*k + 1]);
+		fprintf(stderr, "Golden prices of ns=%d -rng %s from %s sm=%d written to %s\n", res->ns,
+				szRngName[res->iRng], res->szLabel, res->sm, szFile);
+		nWritten++;
+	}
+	fclose(fp);
+	return nWritten > 0;
+}
+
+static void bench_config(bench_bin *bin, int ns, int sm, int nt, int iReps, const char *szArgs, const char *szVsArgs)
+{
+	char szCmd[1024];
+	double pdWall[MAX_REPS];
+	double ppdPhase[MAX_PHASES][MAX_REPS];
+	int nPhases;
+	char szPhase[MAX_PHASES][32];
+	double pdPhase[MAX_PHASES];
+	int r, p;
+	bench_result *res = &results[nResults++];
+
+	// the prices are on stderr
+	snprintf(szCmd, sizeof(szCmd), "%s -ns %d -sm %d -nt %d %s %s", bin->szCmd, ns, sm, nt, szArgs,
+			bPrices ? "2>&1" : "2>/dev/null");
+
+	strcpy(res->szLabel, bin->szLabel);
+	res->ns = ns;
+	res->sm = sm;
+	res->nt = nt;
+	res->iReps = iReps;
+	res->bOk = 1;
+	res->nPhases = 0;
+	res->dVsMedian = 0.0;
+	res->nPrices = 0;
+	res->pdPrice = bPrices ? (double *)malloc(sizeof(double) * 2 * MAX_PRICES) : NULL;
+	res->iRng = run_rng(szCmd);
+	res->iGolden = GOLDEN_NONE;
+
+	for (r = 0; r < iReps; r++) {
+		if (!run_once(szCmd, &pdWall[r], &nPhases, szPhase, pdPhase,
+					r == 0 ? res->pdPrice : NULL, &res->nPrices)) {
+			fprintf(stderr, "Error: run failed: %s\n", szCmd);
+			res->bOk = 0;
+			return;
+		}
+		// phases are matched by name against the first repetition
+		if (r == 0) {
+			res->nPhases = nPhases;
+			for (p = 0; p < nPhases; p++)
+				strcpy(res->szPhase[p], szPhase[p]);
+		}
+		for (p = 0; p < res->nPhases; p++) {
+			ppdPhase[p][r] = 0.0;
+			for (int q = 0; q < nPhases; q++)
+				if (!strcmp(res->szPhase[p], szPhase[q]))
+					ppdPhase[p][r] = pdPhase[q];
+		}
+	}
+
+	std::sort(pdWall, pdWall + iReps);
+	res->dMin = pdWall[0];
+	res->dMedian = percentile(pdWall, iReps, 0.5);
+	res->dP95 = percentile(pdWall, iReps, 0.95);
+	res->dPathsPerSec = (double)ns * (double)sm / res->dMedian;
+	for (p = 0; p < res->nPhases; p++) {
+		std::sort(ppdPhase[p], ppdPhase[p] + iReps);
+		res->dPhase[p] = percentile(ppdPhase[p], iReps, 0.5);
+	}
+
+	fprintf(stderr, "%-20s ns=%-6d sm=%-9d nt=%-3d median %.4fs p95 %.4fs %.3e paths/s\n",
+			res->szLabel, ns, sm, nt, res->dMedian, res->dP95, res->dPathsPerSec);
+	if (golden)
+		check_golden(res);
+
+	if (szVsArgs) {
+		snprintf(szCmd, sizeof(szCmd), "%s -ns %d -sm %d -nt %d %s %s 2>/dev/null", bin->szCmd, ns, sm, nt, szArgs, szVsArgs);
+		res->dVsMedian = median_wall(szCmd, iReps);
+		if (res->dVsMedian > 0.0)
+			fprintf(stderr, "%-20s %s: median %.4fs, speedup %.3fx\n", "", szVsArgs, res->dVsMedian, res->dMedian / res->dVsMedian);
+	}
+}
+
+static void write_json(FILE *fp)
+{
+	int i, p;
+	char szHost[128] = "unknown";
+	time_t now = time(NULL);
+	char szDate[64];
+
+	gethostname(szHost, sizeof(szHost));
+	strftime(szDate, sizeof(szDate), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+	fprintf(fp, "{\"host\": \"%s\", \"date\": \"%s\", \"results\": [\n", szHost, szDate);
+	for (i = 0; i < nResults; i++) {
+		bench_result *res = &results[i];
+		fprintf(fp, "{\"backend\": \"%s\", \"ns\": %d, \"sm\": %d, \"nt\": %d, \"reps\": %d, \"status\": \"%s\"",
+				res->szLabel, res->ns, res->sm, res->nt, res->iReps, res->bOk ? "ok" : "error");
+		if (res->bOk) {
+			fprintf(fp, ", \"median_s\": %.6f, \"p95_s\": %.6f, \"min_s\": %.6f, \"paths_per_s\": %.1f, \"phases\": {",
+					res->dMedian, res->dP95, res->dMin, res->dPathsPerSec);
+			for (p = 0; p < res->nPhases; p++)
+				fprintf(fp, "%s\"%s\": %.6f", p ? ", " : "", res->szPhase[p], res->dPhase[p]);
+			fprintf(fp, "}");
+			if (res->dVsMedian > 0.0)
+				fprintf(fp, ", \"vs_median_s\": %.6f, \"speedup\": %.4f", res->dVsMedian, res->dMedian / res->dVsMedian);
+			if (res->iGolden != GOLDEN_NONE) {
+				fprintf(fp, ", \"golden\": \"%s\", \"identical\": %d", szGoldenStatus[res->iGolden], res->nIdentical);
+				if (isinf(res->dMaxZ))
+					fprintf(fp, ", \"max_z\": null");
+				else
+					fprintf(fp, ", \"max_z\": %.3f", res->dMaxZ);
+			}
+		}
+		fprintf(fp, "}%s\n", i < nResults-1 ? "," : "");
+	}
+	fprintf(fp, "]}\n");
+}
+
+// Reads the "backend"/"ns"/"sm"/"nt"/"median_s" fields back from a file
+// written by write_json (one result per line) and flags regressions.
+static int compare_baseline(const char *szFile, double dThreshold)
+{
+	FILE *fp;
+	char szLine[2048];
+	char szLabel[64];
+	int ns, sm, nt, i;
+	double dMedian;
+	char *pc;
+	int nRegressions = 0, nCompared = 0;
+
+	fp = fopen(szFile, "r");
+	if (!fp) {
+		fprintf(stderr, "Error: cannot open baseline %s\n", szFile);
+		return -1;
+	}
+
+	while (fgets(szLine, sizeof(szLine), fp)) {
+		if (sscanf(szLine, "{\"backend\": \"%63[^\"]\", \"ns\": %d, \"sm\": %d, \"nt\": %d,", szLabel, &ns, &sm, &nt) != 4)
+			continue;
+		pc = strstr(szLine, "\"median_s\": ");
+		if (!pc || sscanf(pc, "\"median_s\": %lf", &dMedian) != 1)
+			continue;
+
+		for (i = 0; i < nResults; i++) {
+			bench_result *res = &results[i];
+			if (!res->bOk || strcmp(res->szLabel, szLabel) || res->ns != ns || res->sm != sm || res->nt != nt)
+				continue;
+			nCompared++;
+			if (res->dMedian > dMedian * (1.0 + dThreshold)) {
+				fprintf(stderr, "REGRESSION %-20s ns=%-6d sm=%-9d nt=%-3d median %.4fs -> %.4fs (%+.1f%%)\n",
+						szLabel, ns, sm, nt, dMedian, res->dMedian, 100.0 * (res->dMedian / dMedian - 1.0));
+				nRegressions++;
+			}
+		}
+	}
+	fclose(fp);
+
+	fprintf(stderr, "Baseline: %d configurations compared, %d regressions above %.1f%%\n",
+			nCompared, nRegressions, 100.0 * dThreshold);
+	return nRegressions;
+}
+
+// Does the binary run its workers on -nt threads? -ckpt keeps a run off the
+// engine, where the serial, OpenCL and MPI versions reject -nt 2 and the
+// pthreads, tbb and all versions take it.
+static int probe_threads(const char *szCmd)
+{
+	char szCkpt[64] = "/tmp/swaptions_bench_XXXXXX";
+	char szProbe[1024];
+	int fd, iStatus;
+
+	fd = mkstemp(szCkpt);
+	if (fd < 0)
+		return 0;
+	close(fd);
+	snprintf(szProbe, sizeof(szProbe), "%s -ns 2 -sm 16 -nt 2 -ckpt %s >/dev/null 2>&1", szCmd, szCkpt);
+	iStatus = system(szProbe);
+	unlink(szCkpt);
+	strcat(szCkpt, ".tmp");
+	unlink(szCkpt);
+	return iStatus != -1 && WIFEXITED(iStatus) && WEXITSTATUS(iStatus) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int ns_list[MAX_LIST] = {16}, n_ns = 1;
+	int sm_list[MAX_LIST] = {10000}, n_sm = 1;
+	int nt_list[MAX_LIST] = {1}, n_nt = 1;
+	int iReps = 5;
+	const char *szArgs = "";
+	const char *szVsArgs = NULL;
+	const char *szOut = NULL;
+	const char *szBaseline = NULL;
+	const char *szGolden = NULL;
+	const char *szWriteGolden = NULL;
+	double dThreshold = 0.10;
+	int b, i, j, k;
+	char *pc;
+
+	for (j = 1; j < argc; j++) {
+		if (j == argc-1) usage();
+		if (!strcmp("-bin", argv[j])) {
+			pc = strchr(argv[++j], '=');
+			if (!pc || nBins == MAX_BINS) usage();
+			*pc = '\0';
+			strncpy(bins[nBins].szLabel, argv[j], sizeof(bins[nBins].szLabel)-1);
+			strncpy(bins[nBins].szCmd, pc+1, sizeof(bins[nBins].szCmd)-1);
+			bins[nBins].bThreads = probe_threads(bins[nBins].szCmd);
+			nBins++;
+		}
+		else if (!strcmp("-ns", argv[j])) {n_ns = parse_list(argv[++j], ns_list);}
+		else if (!strcmp("-sm", argv[j])) {n_sm = parse_list(argv[++j], sm_list);}
+		else if (!strcmp("-nt", argv[j])) {n_nt = parse_list(argv[++j], nt_list);}
+		else if (!strcmp("-reps", argv[j])) {iReps = atoi(argv[++j]);}
+		else if (!strcmp("-args", argv[j])) {szArgs = argv[++j];}
+		else if (!strcmp("-vs", argv[j])) {szVsArgs = argv[++j];}
+		else if (!strcmp("-o", argv[j])) {szOut = argv[++j];}
+		else if (!strcmp("-baseline", argv[j])) {szBaseline = argv[++j];}
+		else if (!strcmp("-threshold", argv[j])) {dThreshold = atof(argv[++j]);}
+		else if (!strcmp("-golden", argv[j])) {szGolden = argv[++j];}
+		else if (!strcmp("-z", argv[j])) {dMaxZ = atof(argv[++j]);}
+		else if (!strcmp("-write_golden", argv[j])) {szWriteGolden = argv[++j];}
+		else usage();
+	}
+	if (nBins == 0 || iReps < 1 || iReps > MAX_REPS || dMaxZ <= 0.0)
+		usage();
+	if (szGolden && !read_golden(szGolden))
+		return 1;
+	bPrices = szGolden || szWriteGolden;
+
+	for (b = 0; b < nBins; b++)
+		for (i = 0; i < n_ns; i++)
+			for (j = 0; j < n_sm; j++)
+				for (k = 0; k < n_nt; k++) {
+					if (!bins[b].bThreads && nt_list[k] != 1)
+						continue;
+					if (nResults == MAX_RESULTS)
+						break;
+					bench_config(&bins[b], ns_list[i], sm_list[j], nt_list[k], iReps, szArgs, szVsArgs);
+				}
+
+	if (szOut) {
+		FILE *fp = fopen(szOut, "w");
+		if (!fp) {
+			fprintf(stderr, "Error: cannot write %s\n", szOut);
+			return 1;
+		}
+		write_json(fp);
+		fclose(fp);
+	} else {
+		write_json(stdout);
+	}
+
+	if (szWriteGolden && !write_golden(szWriteGolden))
+		return 1;
+
+	int nMismatches = 0;
+	for (i = 0; i < nResults; i++)
+		if (results[i].iGolden == GOLDEN_MISMATCH)
+			nMismatches++;
+	if (szGolden)
+		fprintf(stderr, "Golden: %d of %d runs off the golden prices by more than %.1f standard errors\n",
+				nMismatches, nResults, dMaxZ);
+
+	for (i = 0; i < nResults; i++)
+		free(results[i].pdPrice);
+
+	if (szBaseline) {
+		int nRegressions = compare_baseline(szBaseline, dThreshold);
+		if (nRegressions < 0)
+			return 1;
+		if (nRegressions > 0)
+			return 2;
+	}
+	if (nMismatches > 0)
+		return 3;
+
+	return 0;
+}